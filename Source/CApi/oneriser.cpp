@@ -0,0 +1,185 @@
+// C API wrapper around RiserProcessor (see oneriser.h)
+// Only juce_core and juce_audio_basics are needed, so none of the plugin or GUI code is linked
+#include <new>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "oneriser.h"
+#include "../Components/RiserProcessor.h"
+
+// Passes a C allocator's callbacks on as a memory resource
+class CallbackResource : public std::pmr::memory_resource {
+ public:
+    explicit CallbackResource(const oneriser_allocator& callbacks) : allocator(callbacks) {}
+
+    const oneriser_allocator allocator;
+
+ private:
+    void* do_allocate(size_t numBytes, size_t alignment) override {
+        void* memory = allocator.allocate(allocator.context, numBytes, alignment);
+
+        if (memory == nullptr)
+            throw std::bad_alloc();
+
+        return memory;
+    }
+
+    void do_deallocate(void* memory, size_t numBytes, size_t alignment) override {
+        allocator.deallocate(allocator.context, memory, numBytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+struct oneriser {
+    explicit oneriser(const oneriser_allocator* customAllocator = nullptr)
+     : callbacks(customAllocator != nullptr ? *customAllocator : oneriser_allocator {}),
+       resource(customAllocator != nullptr ? &callbacks : std::pmr::get_default_resource()),
+       left(resource), right(resource) {
+        processor.setMemoryResource(resource);
+    }
+
+    CallbackResource callbacks;
+    std::pmr::memory_resource* resource;
+
+    RiserProcessor processor;
+
+    // scratch channels for deinterleaving, maxBlockSize long
+    std::pmr::vector<float> left, right;
+    int maxBlockSize = 0;
+    bool prepared = false;
+};
+
+int oneriser_get_api_version(void) {
+    return ONERISER_API_VERSION;
+}
+
+oneriser* oneriser_create(void) {
+    // (nothing may throw across the C boundary, and the constructor can throw as well as new)
+    try {
+        return new oneriser();
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+oneriser* oneriser_create_with_allocator(const oneriser_allocator* allocator) {
+    if (allocator == nullptr || allocator->allocate == nullptr || allocator->deallocate == nullptr)
+        return nullptr;
+
+    void* memory = allocator->allocate(allocator->context, sizeof(oneriser), alignof(oneriser));
+
+    if (memory == nullptr)
+        return nullptr;
+
+    try {
+        return new (memory) oneriser(allocator);
+    }
+    catch (...) {
+        allocator->deallocate(allocator->context, memory, sizeof(oneriser), alignof(oneriser));
+        return nullptr;
+    }
+}
+
+void oneriser_destroy(oneriser* riser) {
+    if (riser == nullptr) return;
+
+    if (riser->resource != &riser->callbacks) {
+        delete riser;
+        return;
+    }
+
+    const auto allocator = riser->callbacks.allocator;
+    riser->~oneriser();
+    allocator.deallocate(allocator.context, riser, sizeof(oneriser), alignof(oneriser));
+}
+
+oneriser_result oneriser_prepare(oneriser* riser, double sampleRate, int maxBlockSize) {
+    if (riser == nullptr || sampleRate < 1.0 || maxBlockSize <= 0)
+        return ONERISER_ERROR_INVALID_ARGUMENT;
+
+    riser->prepared = false;
+
+    try {
+        riser->left.assign(size_t(maxBlockSize), 0.0f);
+        riser->right.assign(size_t(maxBlockSize), 0.0f);
+        riser->processor.prepare(uint(sampleRate + 0.5), maxBlockSize);
+    }
+    catch (const std::bad_alloc&) {
+        return ONERISER_ERROR_OUT_OF_MEMORY;
+    }
+
+    riser->maxBlockSize = maxBlockSize;
+    riser->prepared = true;
+    return ONERISER_OK;
+}
+
+oneriser_result oneriser_set_amounts(oneriser* riser, float master, float flanger, float filter, float reverb) {
+    if (riser == nullptr)
+        return ONERISER_ERROR_INVALID_ARGUMENT;
+
+    riser->processor.setParameters(flanger, filter, reverb, master);
+    return ONERISER_OK;
+}
+
+oneriser_result oneriser_process_planar(oneriser* riser, float* left, float* right, int numFrames) {
+    if (riser == nullptr || left == nullptr || right == nullptr || numFrames < 0)
+        return ONERISER_ERROR_INVALID_ARGUMENT;
+
+    if (!riser->prepared)
+        return ONERISER_ERROR_NOT_PREPARED;
+
+    riser->processor.process(left, right, numFrames);
+    return ONERISER_OK;
+}
+
+oneriser_result oneriser_process_interleaved(oneriser* riser, float* data, int numFrames, int numChannels) {
+    if (riser == nullptr || data == nullptr || numFrames < 0 || numChannels <= 0)
+        return ONERISER_ERROR_INVALID_ARGUMENT;
+
+    if (!riser->prepared)
+        return ONERISER_ERROR_NOT_PREPARED;
+
+    float* l = riser->left.data();
+    float* r = riser->right.data();
+
+    // deinterleaved through the scratch channels, up to a maximum block at a time
+    for (int start = 0; start < numFrames; start += riser->maxBlockSize) {
+        const int n = jmin(riser->maxBlockSize, numFrames - start);
+        float* frames = data + size_t(start) * size_t(numChannels);
+
+        for (int i = 0; i < n; i++) {
+            l[i] = frames[i * numChannels];
+            r[i] = numChannels > 1 ? frames[i * numChannels + 1] : l[i];
+        }
+
+        riser->processor.process(l, r, n);
+
+        // (mono takes the average of the two sides, as the flanger and reverb are stereo)
+        for (int i = 0; i < n; i++) {
+            if (numChannels > 1) {
+                frames[i * numChannels] = l[i];
+                frames[i * numChannels + 1] = r[i];
+            }
+            else {
+                frames[i] = 0.5f * (l[i] + r[i]);
+            }
+        }
+    }
+
+    return ONERISER_OK;
+}
+
+oneriser_result oneriser_reset(oneriser* riser) {
+    if (riser == nullptr)
+        return ONERISER_ERROR_INVALID_ARGUMENT;
+
+    riser->processor.reset();
+    return ONERISER_OK;
+}
+
+double oneriser_get_tail_seconds(const oneriser* riser) {
+    return riser != nullptr ? riser->processor.getTailLengthSeconds() : 0.0;
+}
@@ -0,0 +1,102 @@
+/*
+ * ~ OneRiser C API ~
+ * The riser DSP as a plain C library, for embedding it without hosting a plugin.
+ *
+ * A handle is created, prepared for a sample rate and maximum block size (which is where
+ * all allocation happens), then processed in place a block at a time. Everything after
+ * oneriser_prepare() — setting the amounts, processing, resetting and the tail query — is
+ * real-time safe: it doesn't allocate, lock or make system calls.
+ *
+ * Handles aren't thread-safe: use each one from a single thread at a time (different
+ * handles can be used from different threads freely).
+ *
+ * The ABI is stable within a major version: functions are only ever added, and the handle
+ * is opaque, so check oneriser_get_api_version() against ONERISER_API_VERSION if needed.
+ *
+ * Memory normally comes from the C++ heap, but a host can pass its own allocator to
+ * oneriser_create_with_allocator() instead (e.g. to place every instance in one arena).
+*/
+
+#ifndef ONERISER_H
+#define ONERISER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+ #if defined(ONERISER_BUILDING)
+  #define ONERISER_API __declspec(dllexport)
+ #else
+  #define ONERISER_API __declspec(dllimport)
+ #endif
+#else
+ #define ONERISER_API __attribute__((visibility("default")))
+#endif
+
+#define ONERISER_API_VERSION 2 /* 2 added oneriser_create_with_allocator() */
+
+typedef struct oneriser oneriser;
+
+typedef enum oneriser_result {
+    ONERISER_OK = 0,
+    ONERISER_ERROR_INVALID_ARGUMENT = -1,
+    ONERISER_ERROR_NOT_PREPARED = -2,
+    ONERISER_ERROR_OUT_OF_MEMORY = -3
+} oneriser_result;
+
+/* Returns ONERISER_API_VERSION as the library was built */
+ONERISER_API int oneriser_get_api_version(void);
+
+/* Creates a processor, returns NULL if it couldn't be allocated */
+ONERISER_API oneriser* oneriser_create(void);
+
+/* Allocation callbacks — allocate() returns NULL on failure, and memory must be aligned to at
+ * least the alignment asked for (at most 64 bytes) */
+typedef struct oneriser_allocator {
+    void* (*allocate)(void* context, size_t numBytes, size_t alignment);
+    void (*deallocate)(void* context, void* memory, size_t numBytes, size_t alignment);
+    void* context;
+} oneriser_allocator;
+
+/* Creates a processor whose memory all comes from an allocator, returns NULL if it couldn't be
+ * allocated — the processor itself is one allocation, and oneriser_prepare() makes one more for
+ * all of its buffers (plus the scratch channels for interleaved processing)
+ * - the callbacks are copied, but the context must outlive the processor */
+ONERISER_API oneriser* oneriser_create_with_allocator(const oneriser_allocator* allocator);
+
+/* Destroys a processor (NULL is ignored) */
+ONERISER_API void oneriser_destroy(oneriser* riser);
+
+/* Allocates everything for playback — must be called before processing, and again
+ * if the sample rate or maximum block size changes (not on the audio thread) */
+ONERISER_API oneriser_result oneriser_prepare(oneriser* riser, double sampleRate, int maxBlockSize);
+
+/* Sets the amounts, each 0 - 1 (clamped) — master scales the other three */
+ONERISER_API oneriser_result oneriser_set_amounts(oneriser* riser, float master, float flanger,
+                                                  float filter, float reverb);
+
+/* Processes a stereo block in place, as separate channel buffers
+ * - any number of frames is accepted, whatever the maximum block size */
+ONERISER_API oneriser_result oneriser_process_planar(oneriser* riser, float* left, float* right, int numFrames);
+
+/* Processes an interleaved block in place
+ * - mono is processed as both channels and written back as their average, and any channels
+ *   past the first two are left as they are
+ * - any number of frames is accepted, whatever the maximum block size */
+ONERISER_API oneriser_result oneriser_process_interleaved(oneriser* riser, float* data, int numFrames,
+                                                          int numChannels);
+
+/* Clears all internal state (delay lines, filters), e.g. when playback restarts */
+ONERISER_API oneriser_result oneriser_reset(oneriser* riser);
+
+/* How long the output rings on after the input stops, in seconds, at the current amounts */
+ONERISER_API double oneriser_get_tail_seconds(const oneriser* riser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ONERISER_H */
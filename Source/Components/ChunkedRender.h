@@ -0,0 +1,235 @@
+#pragma once
+#include <atomic>
+#include <numeric>
+#include <thread>
+#include "RiserProcessor.h"
+
+/*
+ * ~ Chunked rendering ~
+ * Offline rendering of one long stereo signal across several threads.
+ *
+ * The signal is split into chunks, each rendered by its own RiserProcessor. A chunk starts
+ * a pre-roll before its first sample, long enough for the state the flanger and reverb have
+ * built up from earlier audio to decay below the error bound (from the tail length at these
+ * amounts), and its pre-roll output is thrown away.
+ *
+ * Each chunk also renders a little past its end, which is compared with the next chunk's
+ * start: the earlier chunk has been running far longer, so the difference measures how far
+ * the next chunk's start is from a sequential render. Any chunk over the bound is rendered
+ * again with twice the pre-roll.
+ *
+ * Every chunk processes the same block grid as a sequential render (renderSequential()), so
+ * the reverb's decimation and the LFO line up, and the only difference is the truncated history.
+*/
+
+class ChunkedRenderer {
+ public:
+    struct Options {
+        uint sampleRate = 48000;
+        float masterAmount = 1.0f, flangerAmount = 0.7f, filterAmount = 1.0f, reverbAmount = 0.65f;
+        RiserProcessor::Modulation modulation;
+        double bpm = 120.0;             // for synced modulation
+        bool reverbMultirate = false;
+        RiserProcessor::Order order = RiserProcessor::Order::standard;
+
+        int numThreads = 0;             // 0 uses every core
+        double chunkSeconds = 30.0;     // longest chunk (they're shorter if that spreads better)
+        double maxSeamErrorDb = -100.0; // bound on each chunk's difference from a sequential render
+        int maxAttempts = 4;            // per chunk, doubling the pre-roll each time
+    };
+
+    struct Report {
+        int numChunks = 0, numRerendered = 0;
+        double prerollSeconds = 0.0, worstSeamErrorDb = -400.0;
+        bool withinBound = true;
+    };
+
+    // all chunk boundaries and pre-rolls are multiples of this (and of the reverb's decimation)
+    static constexpr int blockSize = 512;
+
+    // Render input into output (which mustn't overlap it) in chunks, in parallel
+    static Report render(const float* inL, const float* inR, float* outL, float* outR,
+                         int64 numSamples, const Options& options) {
+        Report report;
+        if (numSamples <= 0) return report;
+
+        const int numThreads = options.numThreads > 0 ? options.numThreads
+                                                      : jmax(1, int(std::thread::hardware_concurrency()));
+
+        const int64 preroll = getPrerollSamples(options);
+        const int64 chunkLength = roundUpToBlock(jmax(4 * preroll,
+                                                      jmin(int64(options.chunkSeconds * options.sampleRate),
+                                                           numSamples / numThreads)));
+        const int64 overlap = roundUpToBlock(int64(seamSeconds * options.sampleRate));
+
+        vector<Chunk> chunks;
+
+        for (int64 start = 0; start < numSamples; start += chunkLength) {
+            Chunk c;
+            c.start = start;
+            c.end = jmin(numSamples, start + chunkLength);
+            c.preroll = jmin(start, preroll); // (the first chunk has nothing before it)
+            chunks.push_back(c);
+        }
+
+        const Source source { inL, inR, outL, outR, numSamples, overlap };
+        vector<size_t> toRender(chunks.size());
+        std::iota(toRender.begin(), toRender.end(), size_t(0));
+
+        report.numChunks = int(chunks.size());
+        report.prerollSeconds = double(preroll) / options.sampleRate;
+
+        for (int attempt = 0; attempt < options.maxAttempts && !toRender.empty(); attempt++) {
+            renderInParallel(source, chunks, toRender, options, numThreads);
+
+            if (attempt > 0)
+                report.numRerendered += int(toRender.size());
+
+            // check every seam, and re-render the later chunk of any that's over the bound
+            toRender.clear();
+            report.worstSeamErrorDb = -400.0;
+
+            for (size_t k = 1; k < chunks.size(); k++) {
+                const double errorDb = measureSeam(chunks[k - 1], chunks[k], outL, outR);
+                report.worstSeamErrorDb = jmax(report.worstSeamErrorDb, errorDb);
+
+                if (errorDb > options.maxSeamErrorDb) {
+                    chunks[k].preroll = jmin(chunks[k].start, 2 * chunks[k].preroll);
+                    toRender.push_back(k);
+                }
+            }
+        }
+
+        report.withinBound = report.worstSeamErrorDb <= options.maxSeamErrorDb;
+        return report;
+    }
+
+    // Render input into output on this thread, from the start (the reference for render())
+    static void renderSequential(const float* inL, const float* inR, float* outL, float* outR,
+                                 int64 numSamples, const Options& options) {
+        RiserProcessor p;
+        prepareProcessor(p, options, 0);
+
+        for (int64 pos = 0; pos < numSamples; pos += blockSize) {
+            const int n = int(jmin(int64(blockSize), numSamples - pos));
+            std::copy_n(inL + pos, n, outL + pos);
+            std::copy_n(inR + pos, n, outR + pos);
+            p.process(outL + pos, outR + pos, n);
+        }
+    }
+
+    // How far before a chunk its processor starts, for the state to decay below the bound
+    static int64 getPrerollSamples(const Options& options) {
+        RiserProcessor p;
+        configureProcessor(p, options);
+
+        // (the tail is the time to decay 60 dB, and the decay is exponential)
+        const double seconds = jmax(minPrerollSeconds, p.getTailLengthSeconds() * prerollMargin
+                                                       * -options.maxSeamErrorDb / 60.0);
+        return roundUpToBlock(int64(std::ceil(seconds * options.sampleRate)));
+    }
+
+    // Set a processor up for the options and prepare it, with its modulation where it would be at
+    // position — as every chunk's is (also for other renderers, so they match these exactly)
+    // (set up before preparing, so the smoothers start at their targets, as in a sequential render)
+    static void prepareProcessor(RiserProcessor& p, const Options& options, int64 position) {
+        configureProcessor(p, options);
+        p.prepare(options.sampleRate);
+        p.setModulationPosition(position);
+    }
+
+ private:
+    static constexpr double seamSeconds = 0.5, minPrerollSeconds = 0.1, prerollMargin = 1.25;
+
+    struct Chunk {
+        int64 start = 0, end = 0, preroll = 0;
+
+        // what this chunk rendered past its end, for checking the next chunk's start
+        vector<float> seamL, seamR;
+    };
+
+    struct Source {
+        const float* inL, * inR;
+        float* outL, * outR;
+        int64 numSamples, overlap;
+    };
+
+    static int64 roundUpToBlock(int64 numSamples) {
+        return (numSamples + blockSize - 1) / blockSize * blockSize;
+    }
+
+    static void configureProcessor(RiserProcessor& p, const Options& options) {
+        p.setReverbMultirate(options.reverbMultirate);
+        p.setModulation(options.modulation);
+        p.setOrder(options.order);
+        p.setHostTempo(options.bpm);
+        p.setParameters(options.flangerAmount, options.filterAmount, options.reverbAmount, options.masterAmount);
+    }
+
+    static void renderInParallel(const Source& source, vector<Chunk>& chunks, const vector<size_t>& indices,
+                                 const Options& options, int numThreads) {
+        std::atomic<size_t> next { 0 };
+
+        const auto work = [&] {
+            for (size_t i = next++; i < indices.size(); i = next++)
+                renderChunk(source, chunks[indices[i]], options);
+        };
+
+        vector<std::thread> threads;
+
+        for (int t = 1; t < jmin(numThreads, int(indices.size())); t++)
+            threads.emplace_back(work);
+
+        work();
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    static void renderChunk(const Source& source, Chunk& chunk, const Options& options) {
+        const int64 first = chunk.start - chunk.preroll,
+                    last = jmin(source.numSamples, chunk.end + source.overlap);
+
+        RiserProcessor p;
+        prepareProcessor(p, options, first);
+
+        array<float, blockSize> scratchL, scratchR;
+        chunk.seamL.clear();
+        chunk.seamR.clear();
+
+        for (int64 pos = first; pos < last; pos += blockSize) {
+            const int n = int(jmin(int64(blockSize), last - pos));
+
+            // the chunk itself goes straight to the output
+            if (pos >= chunk.start && pos < chunk.end) {
+                std::copy_n(source.inL + pos, n, source.outL + pos);
+                std::copy_n(source.inR + pos, n, source.outR + pos);
+                p.process(source.outL + pos, source.outR + pos, n);
+                continue;
+            }
+
+            // while the pre-roll and seam go to scratch
+            std::copy_n(source.inL + pos, n, scratchL.begin());
+            std::copy_n(source.inR + pos, n, scratchR.begin());
+            p.process(scratchL.data(), scratchR.data(), n);
+
+            if (pos >= chunk.end) {
+                chunk.seamL.insert(chunk.seamL.end(), scratchL.begin(), scratchL.begin() + n);
+                chunk.seamR.insert(chunk.seamR.end(), scratchR.begin(), scratchR.begin() + n);
+            }
+        }
+    }
+
+    // Peak difference (in dBFS) between a chunk's seam and the start of the next chunk
+    static double measureSeam(const Chunk& previous, const Chunk& next, const float* outL, const float* outR) {
+        float peak = 0.0f;
+
+        for (size_t i = 0; i < previous.seamL.size(); i++) {
+            const auto pos = size_t(next.start) + i;
+            peak = jmax(peak, std::abs(previous.seamL[i] - outL[pos]));
+            peak = jmax(peak, std::abs(previous.seamR[i] - outR[pos]));
+        }
+
+        return peak > 0.0f ? 20.0 * std::log10(double(peak)) : -400.0;
+    }
+};
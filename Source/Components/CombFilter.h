@@ -16,15 +16,62 @@ class CombFilter {
     };
 
     void prepare(uint newSampleRate) {
-        // prepare the buffer for playback
+        // prepare the buffer for playback (starts at the last delay time set)
         delay.prepare(newSampleRate, newSampleRate);
-        delay.setDelayTime(0);
+        interpFade.reset(newSampleRate, 0.05);
     }
 
+    // free the buffer, e.g. while the plugin is suspended
+    void release() {
+        delay.release();
+    }
+
+    // set where the buffer's memory comes from (this frees it)
+    void setMemoryResource(std::pmr::memory_resource* resource) {
+        delay.setMemoryResource(resource);
+    }
+
+    // clear the buffer, e.g. before restarting playback
+    void clear() {
+        delay.clear();
+    }
+
+    // the delay line's state, for snapshots (the parameters aren't included)
+    void writeState(OutputStream& stream) const {
+        delay.writeState(stream);
+        interpFade.writeState(stream);
+        state::write(stream, fadeFrom);
+    }
+
+    bool readState(InputStream& stream) {
+        return delay.readState(stream) && interpFade.readState(stream)
+            && state::read(stream, fadeFrom) && (fadeFrom == noInterp || fadeFrom == linearInterp);
+    }
+
+    // the fed back delay line's samples (see RingBuffer::visitState())
+    template <typename Visitor>
+    void visitState(Visitor&& visit) const {
+        delay.visitState(visit);
+    }
+
+    // - a change between the block reads (no or linear interpolation) is faded over, as they read
+    //   the delay a little differently, while any other change is a hard switch
     void setParameters(const Parameters& newParams, const float& freqOffset) {
         Parameters& p = parameters; // just used for shorthand
+        const auto oldInterp = p.interpType;
 
         p = newParams;
+
+        const auto isBlockRead = [](InterpolationType t) { return t == noInterp || t == linearInterp; };
+
+        if (p.interpType != oldInterp && isBlockRead(p.interpType) && isBlockRead(oldInterp)) {
+            fadeFrom = oldInterp;
+
+            // (before prepare(), there's nothing to fade, so this lands straight away)
+            interpFade.setCurrentAndTargetValue(0.0f);
+            interpFade.setTargetValue(1.0f);
+        }
+
         pa::math::setClamp<float>(&p.feedback, 0.0f, 1.0f);
 
         delay.setDelayTime(1.0f / (p.freq + freqOffset), 0.03f);
@@ -37,17 +84,83 @@ class CombFilter {
         float delayed {};
         getDelay(&delayed);
 
-        float feedbackLine = *input + delayed * p.feedback;
+        float feedbackLine = pa::math::flushDenormal(*input + delayed * p.feedback);
         delay.pushToBuffer(&feedbackLine);
 
         return *input + delayed * p.wet;
     }
 
+    // Process a block in place, optionally modulating the delay time
+    // - modulation (if not nullptr) scales each sample's delay time
+    // - cubic interpolation is only available per sample, so it ignores any modulation
+    void process(float* data, int numSamples, const float* modulation = nullptr) {
+        Parameters& p = parameters; // just used for shorthand
+
+        if (p.interpType == cubicInterp) {
+            for (int i = 0; i < numSamples; i++)
+                data[i] = process(data + i);
+
+            return;
+        }
+
+        const auto& kernels = pa::dsp::kernels::get();
+        float delaySamples[blockSize], delayed[blockSize], feedbackLine[blockSize];
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+            float* x = data + start;
+
+            delay.getDelaySamples(delaySamples, n);
+
+            if (modulation != nullptr)
+                kernels.multiply(delaySamples, modulation + start, n);
+
+            // the whole block can be read at once if every read reaches back past the
+            // block, otherwise each read has to wait for the previous sample's push
+            if (*std::min_element(delaySamples, delaySamples + n) >= float(n)) {
+                delay.getBlockFromBuffer(delayed, delaySamples, n, p.interpType);
+                fadeInterpolation(delayed, delaySamples, n);
+                kernels.combMix(x, delayed, feedbackLine, p.feedback, p.wet, n);
+                delay.pushBlockToBuffer(feedbackLine, n);
+            }
+            else {
+                for (int i = 0; i < n; i++) {
+                    delay.getBlockFromBuffer(delayed + i, delaySamples + i, 1, p.interpType);
+                    fadeInterpolation(delayed + i, delaySamples + i, 1);
+
+                    feedbackLine[i] = pa::math::flushDenormal(x[i] + delayed[i] * p.feedback);
+                    delay.pushBlockToBuffer(feedbackLine + i, 1);
+
+                    x[i] = x[i] + delayed[i] * p.wet;
+                }
+            }
+        }
+    }
+
  private:
+    static constexpr int blockSize = 32;
+
     pa::dsp::RingBuffer<float> delay;
 
     Parameters parameters;
 
+    // the fade from the interpolation before the last change, from 0 to 1
+    SmoothValue<float> interpFade { 1.0f };
+    pa::dsp::InterpolationType fadeFrom = noInterp;
+
+    // Through a fade, mixes the delay read the old way into the one read the new way
+    void fadeInterpolation(float* delayed, const float* delaySamples, int numSamples) {
+        if (!interpFade.isSmoothing()) return;
+
+        float previous[blockSize], fade[blockSize];
+
+        delay.getBlockFromBuffer(previous, delaySamples, numSamples, fadeFrom);
+        interpFade.getNextValues(fade, numSamples);
+
+        for (int i = 0; i < numSamples; i++)
+            delayed[i] = previous[i] + fade[i] * (delayed[i] - previous[i]);
+    }
+
     void getDelay(float* input) {
         switch (parameters.interpType) {
             case pa::dsp::noInterp:
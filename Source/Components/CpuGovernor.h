@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include "pa.h"
+
+// Closed-loop CPU budget — measures how long each block takes to process against its deadline
+// (the block's length in real time), and steps a quality level down under sustained load, so an
+// overloaded machine loses a little quality rather than dropping out
+//
+// The load is smoothed over a fraction of a second and has to stay high for a while before a
+// step down, so a single slow block (e.g. the host stalling) doesn't count. Stepping back up
+// needs far more headroom, for far longer, as each level's cost is only known once it's running
+
+namespace pa {
+
+class CpuGovernor {
+ public:
+    // the levels run from 0 (full quality) down to this (see RiserProcessor::setQualityLevel())
+    static constexpr int maxLevel = 2;
+
+    // step down above this much of the deadline, and back up below this much
+    static constexpr double downLoad = 0.7, upLoad = 0.3;
+
+    // how long (in audio time) the load has to stay beyond those before a step
+    static constexpr double downSeconds = 0.5, upSeconds = 4.0;
+
+    // Reset for a sample rate, back at full quality (not on the audio thread)
+    void prepare(double newSampleRate) {
+        sampleRate = jmax(1.0, newSampleRate);
+        level.store(0);
+        smoothedLoad = 0.0;
+        overSeconds = underSeconds = 0.0;
+    }
+
+    // Turn the governor on or off — while off (e.g. rendering offline) it stays at full quality
+    // - it starts out off, so the quality only ever drops when asked to
+    // (audio thread only, it's cheap to call every block)
+    // - returns true if the level changed (back to full quality), like update()
+    bool setEnabled(bool shouldBeEnabled) noexcept {
+        if (shouldBeEnabled == enabled) return false;
+
+        enabled = shouldBeEnabled;
+        smoothedLoad = 0.0;
+        overSeconds = underSeconds = 0.0;
+
+        return level.exchange(0, std::memory_order_relaxed) != 0;
+    }
+
+    bool isEnabled() const noexcept {
+        return enabled;
+    }
+
+    // The quality level to process at (any thread)
+    int getLevel() const noexcept {
+        return level.load(std::memory_order_relaxed);
+    }
+
+    // The smoothed share of the deadline the blocks are taking (audio thread only)
+    double getLoad() const noexcept {
+        return smoothedLoad;
+    }
+
+    // Report how long a block of numSamples took to process, in seconds (audio thread only)
+    // - returns true if the level changed
+    bool update(double processingSeconds, int numSamples) noexcept {
+        if (!enabled || numSamples <= 0) return false;
+
+        const double deadline = double(numSamples) / sampleRate;
+        const double load = processingSeconds / deadline;
+
+        // (smoothed in audio time, so it reacts the same whatever the block size)
+        const double decay = std::exp(-deadline / smoothingSeconds);
+        smoothedLoad = load + decay * (smoothedLoad - load);
+
+        overSeconds = smoothedLoad > downLoad ? overSeconds + deadline : 0.0;
+        underSeconds = smoothedLoad < upLoad ? underSeconds + deadline : 0.0;
+
+        const int current = level.load(std::memory_order_relaxed);
+        int next = current;
+
+        if (overSeconds >= downSeconds && current < maxLevel)
+            next = current + 1;
+        else if (underSeconds >= upSeconds && current > 0)
+            next = current - 1;
+
+        if (next == current) return false;
+
+        // (each step starts the wait over, as the load at the new level has yet to be seen)
+        level.store(next, std::memory_order_relaxed);
+        overSeconds = underSeconds = 0.0;
+        return true;
+    }
+
+ private:
+    static constexpr double smoothingSeconds = 0.2;
+
+    std::atomic<int> level { 0 };
+    bool enabled = false;
+
+    double sampleRate = 44100.0;
+    double smoothedLoad = 0.0, overSeconds = 0.0, underSeconds = 0.0; // (audio thread only)
+};
+
+} // end namespace pa
@@ -1,6 +1,6 @@
 // drawRotarySlider() overloads for custom knob appearances
 #pragma once
-#include "BinaryData.h"
+#include "SharedAssets.h"
 
 class KnobAppearance : public juce::LookAndFeel_V4 {
  public:
@@ -14,26 +14,44 @@ class KnobAppearance : public juce::LookAndFeel_V4 {
                           float rotaryEndAngle, Slider&) override {
         juce::ignoreUnused(x, y, height);
 
+        // frames are rendered at physical resolution, so they stay sharp on hi-dpi displays
+        const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        const int frameWidth = roundToInt(float(width) * scale);
+
+        if (frameWidth <= 0) return;
+
+        // snap to the nearest frame, the steps are finer than a knob drag can resolve
+        const int index = roundToInt(pa::math::clamp(sliderPosProportional, 0.0f, 1.0f) * float(numFrames - 1));
+
+        // a frame is only valid for one knob size, and is shared with every other
+        // knob of the same type and size in the process
+        const SharedAssets::FrameKey key { int(knobType), frameWidth, index };
+        Image frame = assets->findFrame(key);
+
+        // frames are only rendered when needed (again, if they've been evicted since)
+        if (frame.isNull()) {
+            frame = renderFrame(frameWidth, float(index) / float(numFrames - 1), rotaryStartAngle, rotaryEndAngle);
+            assets->addFrame(key, frame);
+        }
+
+        g.drawImageTransformed(frame, AffineTransform::scale(1.0f / scale));
+    }
+
+ private:
+    // this is set to the pixel width of the knob assets
+    static constexpr float largeKnobWidth = 420.0f, smallKnobWidth = 168.0f;
+    static constexpr int numFrames = SharedAssets::numFrames;
+
+    SharedResourcePointer<SharedAssets> assets;
+
+    // Used to draw both knob layers at a given position into a new frame
+    Image renderFrame(int frameWidth, float sliderPosProportional, float rotaryStartAngle, float rotaryEndAngle) {
         // (you could also interpret this enum as a bool directly)
         bool isLarge = knobType == large;
 
-        // load the image files
-        Image knobBase, knobTop;
-
-        switch (knobType) {
-            case small:
-                knobBase = ImageFileFormat::loadFrom
-                    (BinaryData::SmallKnobBase_png, BinaryData::SmallKnobBase_pngSize);
-                knobTop = ImageFileFormat::loadFrom
-                    (BinaryData::SmallKnobTop_png, BinaryData::SmallKnobTop_pngSize);
-                break;
-            case large:
-                knobBase = ImageFileFormat::loadFrom
-                    (BinaryData::LargeKnobBase_png, BinaryData::LargeKnobBase_pngSize);
-                knobTop = ImageFileFormat::loadFrom
-                    (BinaryData::LargeKnobTop_png, BinaryData::LargeKnobTop_pngSize);
-                break;
-        }
+        // the decoded images are shared between all instances
+        const Image knobBase = assets->getImage(isLarge ? SharedAssets::largeKnobBase : SharedAssets::smallKnobBase),
+                    knobTop  = assets->getImage(isLarge ? SharedAssets::largeKnobTop  : SharedAssets::smallKnobTop);
 
         // transform for rotation/scale
         AffineTransform base, top;
@@ -61,16 +79,17 @@ class KnobAppearance : public juce::LookAndFeel_V4 {
         base = base.rotated(baseAngle, pivotPoint, pivotPoint);
         top = top.rotated(topAngle, pivotPoint, pivotPoint);
 
-        const float knobScale = static_cast<float>(width) / knobWidth;
+        const float knobScale = static_cast<float>(frameWidth) / knobWidth;
         base = base.scaled(knobScale);
         top = top.scaled(knobScale);
 
         // draw the images with their transform
-        g.drawImageTransformed(knobBase, base);
-        g.drawImageTransformed(knobTop, top);
-    }
+        Image frame(Image::ARGB, frameWidth, frameWidth, true);
+        Graphics fg(frame);
+        fg.setImageResamplingQuality(Graphics::highResamplingQuality);
+        fg.drawImageTransformed(knobBase, base);
+        fg.drawImageTransformed(knobTop, top);
 
- private:
-    // this is set to the pixel width of the knob assets
-    static constexpr float largeKnobWidth = 420.0f, smallKnobWidth = 168.0f;
-};
\ No newline at end of file
+        return frame;
+    }
+};
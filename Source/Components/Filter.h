@@ -18,14 +18,71 @@ class Filter {
         bool enabled = true;
     };
 
+    // Biquad coefficients, as used by process()
+    struct Coefficients {
+        double a0 = 1.0, a1 = 0.0, a2 = 0.0, b1 = 0.0, b2 = 0.0;
+    };
+
+    // Calculate the coefficients for a set of parameters, without touching any filter
+    // (used by processors that run their own biquads, e.g. RiserBank)
+    static Coefficients calculateCoefficients(const Parameters& p, double sampleRate) {
+        jassert(sampleRate > 0);
+
+        const double k = pa::math::fastTan(M_PI * (p.cutoff / sampleRate));
+        const double k2 = k * k;
+
+        return calculateCoefficients(p.type, k, k2, 1 / (1 + k / p.q + k2), p.q);
+    }
+
+    // (clears the state too, so a filter prepared again starts out like a new one)
     void prepare(const uint& newSampleRate) {
         sampleRate = newSampleRate;
+        reset();
+    }
+
+    // Set the parameters along with their coefficients, calculated elsewhere (e.g. from a table)
+    void setParameters(const Parameters& newParameters, const Coefficients& newCoefficients) {
+        parameters = newParameters;
+
+        co.a0 = newCoefficients.a0;
+        co.a1 = newCoefficients.a1;
+        co.a2 = newCoefficients.a2;
+        co.b1 = newCoefficients.b1;
+        co.b2 = newCoefficients.b2;
+
+        // (so the next plain setParameters() recalculates everything)
+        co.prevCutoff = -1.0;
+        co.prevQ = -1.0;
+    }
+
+    // Clear the filter's state (the coefficients are kept)
+    void reset() {
+        co.dly1 = 0.0;
+        co.dly2 = 0.0;
+    }
+
+    // The filter's state, for snapshots (the coefficients aren't included)
+    void writeState(OutputStream& stream) const {
+        state::write(stream, co.dly1);
+        state::write(stream, co.dly2);
+    }
+
+    bool readState(InputStream& stream) {
+        return state::read(stream, co.dly1) && state::read(stream, co.dly2);
+    }
+
+    // Call visit() with each of the filter's (fed back) state values
+    template <typename Visitor>
+    void visitState(Visitor&& visit) const {
+        visit(co.dly1);
+        visit(co.dly2);
     }
 
     void setParameters(const Parameters& newParameters) {
         parameters = newParameters;
 
-        if (!parameters.enabled) return;
+        // (coefficients can't be calculated until the sample rate is known)
+        if (!parameters.enabled || sampleRate == 0) return;
 
         setCoefficients();
     }
@@ -37,16 +94,42 @@ class Filter {
         if (!p.enabled || input == nullptr) return *input;
 
         double out = *input * co.a0 + co.dly1;
-        co.dly1 = *input * co.a1 + co.dly2 - co.b1 * out;
-        co.dly2 = *input * co.a2 - co.b2 * out;
+        co.dly1 = pa::math::flushDenormal(*input * co.a1 + co.dly2 - co.b1 * out);
+        co.dly2 = pa::math::flushDenormal(*input * co.a2 - co.b2 * out);
         return static_cast<float>(out);
     }
 
+    // Process a block in place (the same as calling process() on every sample)
+    // - the state is flushed every flushInterval samples rather than every sample, which is
+    //   plenty for any pole to not get from denormalThreshold down to denormals in between
+    void process(float* data, int numSamples) {
+        if (!parameters.enabled || data == nullptr) return;
+
+        const auto& kernels = pa::dsp::kernels::get();
+        const double c[] { co.a0, co.a1, co.a2, co.b1, co.b2 };
+        double state[] { co.dly1, co.dly2 };
+
+        for (int start = 0; start < numSamples; start += flushInterval) {
+            kernels.biquad(data + start, jmin(flushInterval, numSamples - start), c, state);
+
+            state[0] = pa::math::flushDenormal(state[0]);
+            state[1] = pa::math::flushDenormal(state[1]);
+        }
+
+        co.dly1 = state[0];
+        co.dly2 = state[1];
+    }
+
  private:
+    static constexpr int flushInterval = 256;
+
     void setCoefficients() {
         Parameters& p = parameters; // just used for shorthand
 
         // only process when relevant parameters have changed
+        // (n depends on k as well as q, so a cutoff change also forces it to update)
+        bool kChanged = false;
+
         if (p.cutoff != co.prevCutoff || sampleRate != co.prevSampleRate) {
             jassert(sampleRate > 0);
 
@@ -55,30 +138,44 @@ class Filter {
 
             co.prevCutoff = p.cutoff;
             co.prevSampleRate = sampleRate;
+            kChanged = true;
         }
-        if (p.q != co.prevQ) {
+        if (p.q != co.prevQ || kChanged) {
             co.n = 1 / (1 + co.k / p.q + co.k2);
 
             co.prevQ = p.q;
         }
 
-        // coefficient calculations
-        switch (p.type) {
+        const auto c = calculateCoefficients(p.type, co.k, co.k2, co.n, p.q);
+        co.a0 = c.a0;
+        co.a1 = c.a1;
+        co.a2 = c.a2;
+        co.b1 = c.b1;
+        co.b2 = c.b2;
+    }
+
+    // coefficient calculations
+    static Coefficients calculateCoefficients(FilterType type, double k, double k2, double n, double q) {
+        Coefficients c;
+
+        switch (type) {
             case lowpass:
-                co.a0 = co.k2 * co.n;
-                co.a1 = 2 * co.a0;
-                co.a2 = co.a0;
-                co.b1 = 2 * (co.k2 - 1) * co.n;
-                co.b2 = (1 - co.k / p.q + co.k2) * co.n;
+                c.a0 = k2 * n;
+                c.a1 = 2 * c.a0;
+                c.a2 = c.a0;
+                c.b1 = 2 * (k2 - 1) * n;
+                c.b2 = (1 - k / q + k2) * n;
                 break;
             case highpass:
-                co.a0 = co.n;
-                co.a1 = -2 * co.a0;
-                co.a2 = co.a0;
-                co.b1 = 2 * (co.k2 - 1) * co.n;
-                co.b2 = (1 - co.k / p.q + co.k2) * co.n;
+                c.a0 = n;
+                c.a1 = -2 * c.a0;
+                c.a2 = c.a0;
+                c.b1 = 2 * (k2 - 1) * n;
+                c.b2 = (1 - k / q + k2) * n;
                 break;
         }
+
+        return c;
     }
 
     Parameters parameters;
@@ -0,0 +1,444 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * ~ Block kernels, with runtime CPU dispatch ~
+ * The hot inner loops of the processors, each written once and compiled for several
+ * instruction sets in the same binary. The best set the CPU supports is picked the
+ * first time get() is called (RiserProcessor::prepare() makes sure that's not on the
+ * audio thread).
+ *
+ * The wider variants also use FMA, so they round slightly differently to the baseline
+ * (around -140 dB) — the null tests (Tests/NullTest.h) bound this for every variant.
+ *
+ * To force a variant (e.g. for testing) either set the ONERISER_ISA environment variable
+ * to "baseline", "avx2" or "avx512" before the plugin is loaded, or call select().
+ * Requests for a set the CPU doesn't support fall back to the best one it does.
+*/
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+ #define PA_KERNEL_DISPATCH 1
+ #include <immintrin.h>
+#else
+ #define PA_KERNEL_DISPATCH 0 // (e.g. arm64 or MSVC, which only get the baseline)
+#endif
+
+namespace pa::dsp::kernels {
+
+enum class Isa {
+    baseline, // SSE2 on x86-64, NEON on arm64
+    avx2,
+    avx512
+};
+
+// Feedback below this is flushed to zero (see pa::math::flushDenormal(), which uses it too)
+static constexpr float denormalThreshold = 1.0e-30f;
+
+// The damped comb bank's width, the reverb's two channels of 8 combs (see dampedCombs())
+static constexpr int dampedCombLanes = 16;
+
+                // Kernel bodies
+namespace impl {
+// Reads from a ring buffer at a (whole sample) delay per output sample, where output
+// sample i is read as if i samples had been pushed since the write index
+inline void readNearest(float* dest, const float* data, const float* delaySamples,
+                        unsigned int writeIndex, unsigned int size, int numSamples) {
+    for (int i = 0; i < numSamples; i++) {
+        // (the delays are always well within int range, and int converts faster than unsigned)
+        unsigned int index = writeIndex + unsigned(i) + size - unsigned(int(delaySamples[i]));
+        index = (index >= size) ? index - size : index;
+        index = (index >= size) ? index - size : index;
+
+        dest[i] = data[index];
+    }
+}
+
+// As above, linearly interpolated towards the next older sample
+inline void readLinear(float* dest, const float* data, const float* delaySamples,
+                       unsigned int writeIndex, unsigned int size, int numSamples) {
+    for (int i = 0; i < numSamples; i++) {
+        const float readOffset = delaySamples[i];
+        const int whole = int(readOffset);
+
+        unsigned int index = writeIndex + unsigned(i) + size - unsigned(whole);
+        index = (index >= size) ? index - size : index;
+        index = (index >= size) ? index - size : index;
+        const unsigned int previous = (index == 0) ? size - 1 : index - 1;
+
+        const float t = readOffset - float(whole);
+        dest[i] = data[index] + t * (data[previous] - data[index]);
+    }
+}
+
+// The comb filter's feedback (flushed before it can become denormal) and output mix
+inline void combMix(float* data, const float* delayed, float* feedbackLine,
+                    float feedback, float wet, int numSamples) {
+    for (int i = 0; i < numSamples; i++) {
+        const float fb = data[i] + delayed[i] * feedback;
+        feedbackLine[i] = (std::abs(fb) < denormalThreshold) ? 0.0f : fb;
+        data[i] = data[i] + delayed[i] * wet;
+    }
+}
+
+// dest *= src
+inline void multiply(float* dest, const float* src, int numSamples) {
+    for (int i = 0; i < numSamples; i++)
+        dest[i] *= src[i];
+}
+
+// The reverb's damped combs side by side, one to each of dampedCombLanes lanes (left's combs, then
+// right's) — each lowpasses its delayed samples (state holds each lane's last value), feeds them
+// back with the input (flushed) and adds them to its channel's output
+// - delayed and feedback hold numSamples rows of dampedCombLanes, unused lanes should be delayed
+//   0 (they then add nothing to the outputs)
+inline void dampedCombs(const float* delayed, float* feedback, float* state, const float* input,
+                        const float* damp, const float* feed, float* outL, float* outR, int numSamples) {
+    constexpr int half = dampedCombLanes / 2;
+    float previous[dampedCombLanes];
+    std::memcpy(previous, state, sizeof(previous));
+
+    for (int i = 0; i < numSamples; i++) {
+        const float* d = delayed + i * dampedCombLanes;
+        float* fb = feedback + i * dampedCombLanes;
+
+        for (int c = 0; c < dampedCombLanes; c++) {
+            const float p = d[c] + damp[i] * (previous[c] - d[c]);
+            previous[c] = (std::abs(p) < denormalThreshold) ? 0.0f : p;
+
+            const float f = input[i] + previous[c] * feed[i];
+            fb[c] = (std::abs(f) < denormalThreshold) ? 0.0f : f;
+        }
+
+        // (summed in comb order, as one at a time would)
+        float sumL = 0.0f, sumR = 0.0f;
+
+        for (int c = 0; c < half; c++) {
+            sumL += d[c];
+            sumR += d[half + c];
+        }
+
+        outL[i] = sumL;
+        outR[i] = sumR;
+    }
+
+    std::memcpy(state, previous, sizeof(previous));
+}
+
+// The reverb's late (undamped) comb: its feedback (flushed) and output, the delayed signal less
+// the input, in place
+inline void lateComb(float* data, const float* delayed, float* feedbackLine, float feedback, int numSamples) {
+    for (int i = 0; i < numSamples; i++) {
+        const float fb = data[i] + delayed[i] * feedback;
+        feedbackLine[i] = (std::abs(fb) < denormalThreshold) ? 0.0f : fb;
+        data[i] = delayed[i] - data[i];
+    }
+}
+
+// Mixes a stereo wet signal into left and right, each wet channel at wet1 to its own side and
+// wet2 to the other, with the dry signal at the dry level (or left as it is, if dry is nullptr)
+inline void stereoMix(float* left, float* right, const float* wetL, const float* wetR,
+                      const float* dry, const float* wet1, const float* wet2, int numSamples) {
+    if (dry == nullptr) {
+        for (int i = 0; i < numSamples; i++) {
+            left[i]  += wet1[i] * wetL[i] + wet2[i] * wetR[i];
+            right[i] += wet1[i] * wetR[i] + wet2[i] * wetL[i];
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < numSamples; i++) {
+        left[i]  = dry[i] * left[i]  + wet1[i] * wetL[i] + wet2[i] * wetR[i];
+        right[i] = dry[i] * right[i] + wet1[i] * wetR[i] + wet2[i] * wetL[i];
+    }
+}
+
+// Direct form II transposed biquad — coefficients are { a0, a1, a2, b1, b2 }, state is { dly1, dly2 }
+inline void biquad(float* data, int numSamples, const double* c, double* state) {
+    double dly1 = state[0], dly2 = state[1];
+
+    for (int i = 0; i < numSamples; i++) {
+        const double in = data[i];
+        const double out = in * c[0] + dly1;
+        dly1 = in * c[1] + dly2 - c[3] * out;
+        dly2 = in * c[2] - c[4] * out;
+        data[i] = static_cast<float>(out);
+    }
+
+    state[0] = dly1;
+    state[1] = dly2;
+}
+
+// Full scale 32 bit integer samples (as file readers give any integer format) to floats
+inline void intToFloat(const int* src, float* dest, int numSamples) {
+    constexpr float scale = 1.0f / 2147483648.0f;
+
+    for (int i = 0; i < numSamples; i++)
+        dest[i] = float(src[i]) * scale;
+}
+
+// Floats to a bit depth below 32 (e.g. 16 or 24), clipped and rounded to nearest, then shifted up to full
+// scale 32 bit integers — so a writer that truncates to the bit depth (as file writers do) keeps them exact
+inline void floatToInt(const float* src, int* dest, int bitDepth, int numSamples) {
+    const float scale = float(1 << (bitDepth - 1)), maxValue = scale - 1.0f;
+    const int shift = 32 - bitDepth;
+
+    for (int i = 0; i < numSamples; i++) {
+        float x = src[i] * scale;
+        x = x < -scale ? -scale : (x > maxValue ? maxValue : x);
+
+        // (rounding away from zero by hand, as it vectorises where std::lround() doesn't)
+        dest[i] = int(x + (x < 0.0f ? -0.5f : 0.5f)) * (1 << shift);
+    }
+}
+} // end namespace impl
+
+                // Variants
+// One copy of every kernel per instruction set (the bodies above are inlined into each)
+// - the delay reads are written out by hand for the wide sets below, as compilers won't
+//   generate gathers for them by default
+#define PA_KERNEL_VARIANT(target)                                                                          \
+    target inline void combMix(float* d, const float* delayed, float* fb, float feedback, float wet, int n) { \
+        impl::combMix(d, delayed, fb, feedback, wet, n); }                                                 \
+    target inline void multiply(float* d, const float* s, int n) { impl::multiply(d, s, n); }              \
+    target inline void dampedCombs(const float* delayed, float* fb, float* state, const float* in,         \
+                                   const float* damp, const float* feed, float* l, float* r, int n) {      \
+        impl::dampedCombs(delayed, fb, state, in, damp, feed, l, r, n); }                                  \
+    target inline void lateComb(float* d, const float* delayed, float* fb, float feedback, int n) {        \
+        impl::lateComb(d, delayed, fb, feedback, n); }                                                     \
+    target inline void stereoMix(float* l, float* r, const float* wl, const float* wr, const float* dry,   \
+                                 const float* w1, const float* w2, int n) {                                \
+        impl::stereoMix(l, r, wl, wr, dry, w1, w2, n); }                                                   \
+    target inline void biquad(float* d, int n, const double* c, double* s) { impl::biquad(d, n, c, s); }   \
+    target inline void intToFloat(const int* s, float* d, int n) { impl::intToFloat(s, d, n); }            \
+    target inline void floatToInt(const float* s, int* d, int b, int n) { impl::floatToInt(s, d, b, n); }
+
+namespace baseline {
+PA_KERNEL_VARIANT()
+using impl::readNearest, impl::readLinear;
+}
+
+#if PA_KERNEL_DISPATCH
+ #define PA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+ #define PA_TARGET_AVX512 __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq")))
+
+namespace avx2 {
+PA_KERNEL_VARIANT(PA_TARGET_AVX2)
+
+// Wraps 8 read indices (less than 3 * size) into the buffer
+PA_TARGET_AVX2 inline __m256i wrap(__m256i index, __m256i size) {
+    const __m256i sizeMinusOne = _mm256_sub_epi32(size, _mm256_set1_epi32(1));
+
+    index = _mm256_sub_epi32(index, _mm256_and_si256(_mm256_cmpgt_epi32(index, sizeMinusOne), size));
+    return _mm256_sub_epi32(index, _mm256_and_si256(_mm256_cmpgt_epi32(index, sizeMinusOne), size));
+}
+
+template <bool interpolate>
+PA_TARGET_AVX2 inline void read(float* dest, const float* data, const float* delaySamples,
+                                unsigned int writeIndex, unsigned int size, int numSamples) {
+    const __m256i sizeV = _mm256_set1_epi32(int(size)),
+                  lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = 0;
+
+    for (; i + 8 <= numSamples; i += 8) {
+        const __m256 readOffset = _mm256_loadu_ps(delaySamples + i);
+        const __m256i whole = _mm256_cvttps_epi32(readOffset);
+        const __m256i first = _mm256_set1_epi32(int(writeIndex + size) + i);
+        const __m256i index = wrap(_mm256_sub_epi32(_mm256_add_epi32(first, lanes), whole), sizeV);
+        const __m256 current = _mm256_i32gather_ps(data, index, 4);
+
+        if constexpr (interpolate) {
+            // (index 0's previous sample is at the end of the buffer)
+            const __m256i atStart = _mm256_cmpeq_epi32(index, _mm256_setzero_si256());
+            const __m256i previous = _mm256_add_epi32(_mm256_sub_epi32(index, _mm256_set1_epi32(1)),
+                                                      _mm256_and_si256(atStart, sizeV));
+            const __m256 t = _mm256_sub_ps(readOffset, _mm256_cvtepi32_ps(whole));
+            const __m256 older = _mm256_i32gather_ps(data, previous, 4);
+
+            _mm256_storeu_ps(dest + i, _mm256_add_ps(current, _mm256_mul_ps(t, _mm256_sub_ps(older, current))));
+        }
+        else {
+            _mm256_storeu_ps(dest + i, current);
+        }
+    }
+
+    if (i < numSamples) {
+        if constexpr (interpolate)
+            impl::readLinear(dest + i, data, delaySamples + i, writeIndex + unsigned(i), size, numSamples - i);
+        else
+            impl::readNearest(dest + i, data, delaySamples + i, writeIndex + unsigned(i), size, numSamples - i);
+    }
+}
+
+PA_TARGET_AVX2 inline void readNearest(float* d, const float* data, const float* delay,
+                                       unsigned int w, unsigned int size, int n) { read<false>(d, data, delay, w, size, n); }
+PA_TARGET_AVX2 inline void readLinear(float* d, const float* data, const float* delay,
+                                      unsigned int w, unsigned int size, int n) { read<true>(d, data, delay, w, size, n); }
+} // end namespace avx2
+
+namespace avx512 {
+PA_KERNEL_VARIANT(PA_TARGET_AVX512)
+
+template <bool interpolate>
+PA_TARGET_AVX512 inline void read(float* dest, const float* data, const float* delaySamples,
+                                  unsigned int writeIndex, unsigned int size, int numSamples) {
+    const __m512i sizeV = _mm512_set1_epi32(int(size)),
+                  lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    // (the masked forms are used with every lane enabled, since the unmasked ones trip
+    // GCC's uninitialised warnings)
+    const __mmask16 all = 0xffff;
+    int i = 0;
+
+    for (; i + 16 <= numSamples; i += 16) {
+        const __m512 readOffset = _mm512_loadu_ps(delaySamples + i);
+        const __m512i whole = _mm512_maskz_cvttps_epi32(all, readOffset);
+        const __m512i first = _mm512_set1_epi32(int(writeIndex + size) + i);
+        __m512i index = _mm512_sub_epi32(_mm512_add_epi32(first, lanes), whole);
+
+        // wrap into the buffer (indices are less than 3 * size)
+        index = _mm512_mask_sub_epi32(index, _mm512_cmpge_epi32_mask(index, sizeV), index, sizeV);
+        index = _mm512_mask_sub_epi32(index, _mm512_cmpge_epi32_mask(index, sizeV), index, sizeV);
+
+        const __m512 current = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), all, index, data, 4);
+
+        if constexpr (interpolate) {
+            const __m512i previous = _mm512_mask_mov_epi32(_mm512_sub_epi32(index, _mm512_set1_epi32(1)),
+                                                           _mm512_cmpeq_epi32_mask(index, _mm512_setzero_si512()),
+                                                           _mm512_sub_epi32(sizeV, _mm512_set1_epi32(1)));
+            const __m512 t = _mm512_sub_ps(readOffset, _mm512_maskz_cvtepi32_ps(all, whole));
+            const __m512 older = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), all, previous, data, 4);
+
+            _mm512_storeu_ps(dest + i, _mm512_add_ps(current, _mm512_mul_ps(t, _mm512_sub_ps(older, current))));
+        }
+        else {
+            _mm512_storeu_ps(dest + i, current);
+        }
+    }
+
+    // (the rest goes through the 8 wide version)
+    if (i < numSamples)
+        avx2::read<interpolate>(dest + i, data, delaySamples + i, writeIndex + unsigned(i), size, numSamples - i);
+}
+
+PA_TARGET_AVX512 inline void readNearest(float* d, const float* data, const float* delay,
+                                         unsigned int w, unsigned int size, int n) { read<false>(d, data, delay, w, size, n); }
+PA_TARGET_AVX512 inline void readLinear(float* d, const float* data, const float* delay,
+                                        unsigned int w, unsigned int size, int n) { read<true>(d, data, delay, w, size, n); }
+} // end namespace avx512
+
+ #undef PA_TARGET_AVX2
+ #undef PA_TARGET_AVX512
+#endif
+
+#undef PA_KERNEL_VARIANT
+
+                // Dispatch
+// The kernels for one instruction set
+struct Table {
+    Isa isa;
+    void (*readNearest)(float*, const float*, const float*, unsigned int, unsigned int, int);
+    void (*readLinear)(float*, const float*, const float*, unsigned int, unsigned int, int);
+    void (*combMix)(float*, const float*, float*, float, float, int);
+    void (*multiply)(float*, const float*, int);
+    void (*biquad)(float*, int, const double*, double*);
+    void (*dampedCombs)(const float*, float*, float*, const float*, const float*, const float*, float*, float*, int);
+    void (*lateComb)(float*, const float*, float*, float, int);
+    void (*stereoMix)(float*, float*, const float*, const float*, const float*, const float*, const float*, int);
+    void (*intToFloat)(const int*, float*, int);
+    void (*floatToInt)(const float*, int*, int, int);
+};
+
+inline const Table& getTable(Isa isa) {
+    static constexpr Table baselineTable { Isa::baseline, baseline::readNearest, baseline::readLinear,
+                                           baseline::combMix, baseline::multiply, baseline::biquad,
+                                           baseline::dampedCombs, baseline::lateComb, baseline::stereoMix,
+                                           baseline::intToFloat, baseline::floatToInt };
+   #if PA_KERNEL_DISPATCH
+    static constexpr Table avx2Table { Isa::avx2, avx2::readNearest, avx2::readLinear,
+                                       avx2::combMix, avx2::multiply, avx2::biquad,
+                                       avx2::dampedCombs, avx2::lateComb, avx2::stereoMix,
+                                       avx2::intToFloat, avx2::floatToInt };
+    static constexpr Table avx512Table { Isa::avx512, avx512::readNearest, avx512::readLinear,
+                                         avx512::combMix, avx512::multiply, avx512::biquad,
+                                         avx512::dampedCombs, avx512::lateComb, avx512::stereoMix,
+                                         avx512::intToFloat, avx512::floatToInt };
+
+    switch (isa) {
+        case Isa::avx512: return avx512Table;
+        case Isa::avx2:   return avx2Table;
+        default:          return baselineTable;
+    }
+   #else
+    (void) isa;
+    return baselineTable;
+   #endif
+}
+
+inline const char* getName(Isa isa) {
+    switch (isa) {
+        case Isa::avx2:   return "avx2";
+        case Isa::avx512: return "avx512";
+        default:          return "baseline";
+    }
+}
+
+// Whether this CPU (and OS) can run an instruction set
+inline bool isSupported(Isa isa) {
+   #if PA_KERNEL_DISPATCH
+    switch (isa) {
+        case Isa::avx512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+                && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+        case Isa::avx2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        default:
+            return true;
+    }
+   #else
+    return isa == Isa::baseline;
+   #endif
+}
+
+// The best supported instruction set, no better than the one asked for
+inline Isa getBestSupported(Isa requested = Isa::avx512) {
+    for (auto isa : { Isa::avx512, Isa::avx2 })
+        if (isa <= requested && isSupported(isa))
+            return isa;
+
+    return Isa::baseline;
+}
+
+namespace detail {
+inline Isa detect() {
+    if (const char* forced = std::getenv("ONERISER_ISA")) {
+        for (auto isa : { Isa::baseline, Isa::avx2, Isa::avx512 })
+            if (std::strcmp(forced, getName(isa)) == 0)
+                return getBestSupported(isa);
+    }
+
+    return getBestSupported();
+}
+
+inline std::atomic<const Table*>& active() {
+    static std::atomic<const Table*> table { &getTable(detect()) };
+    return table;
+}
+} // end namespace detail
+
+// The kernels in use (detected on the first call)
+inline const Table& get() {
+    return *detail::active().load(std::memory_order_relaxed);
+}
+
+// Force an instruction set (limited to what's supported), returns the one actually used
+// - not meant to be called while audio is running
+inline Isa select(Isa isa) {
+    const Isa supported = getBestSupported(isa);
+    detail::active().store(&getTable(supported), std::memory_order_relaxed);
+    return supported;
+}
+
+} // end namespace pa::dsp::kernels
@@ -0,0 +1,92 @@
+#pragma once
+#include "pa.h"
+
+// Sine LFO — a phase accumulator reading a small wavetable, linearly interpolated
+// With 512 points the interpolation error is bounded by (2pi / 512)^2 / 8, about 1.9e-5
+
+namespace pa::dsp {
+
+class LFO {
+ public:
+    static constexpr int tableSize = 512;
+
+    void prepare(const uint& newSampleRate) {
+        sampleRate = jmax(1u, newSampleRate);
+        phase = 0.0;
+        setFrequency(frequency);
+    }
+
+    // Set the rate in Hz (negative values are treated as positive)
+    void setFrequency(double newFrequency) {
+        frequency = std::abs(newFrequency);
+        increment = frequency / double(sampleRate);
+    }
+
+    // Set the phase directly, in cycles (e.g. to lock it to the host's position)
+    void setPhase(double newPhase) {
+        phase = newPhase - std::floor(newPhase);
+    }
+
+    double getPhase() const noexcept {
+        return phase;
+    }
+
+    // Set the phase to where it would be numSamples after prepare(), at the current frequency
+    void setPosition(int64 numSamples) {
+        setPhase(double(numSamples) * increment);
+    }
+
+    void writeState(OutputStream& stream) const {
+        state::write(stream, phase);
+    }
+
+    bool readState(InputStream& stream) {
+        return state::read(stream, phase);
+    }
+
+    // Fill a block of values in [-1, 1] for both channels
+    // - the right channel runs phaseOffset cycles ahead of the left
+    void process(float* left, float* right, int numSamples, float phaseOffset) {
+        const auto& table = getTable();
+        const auto start = float(phase), inc = float(increment);
+        const float offset = phaseOffset - std::floor(phaseOffset);
+
+        for (int i = 0; i < numSamples; i++) {
+            const float p = start + inc * float(i);
+            left[i] = lookup(table, p);
+            right[i] = lookup(table, p + offset);
+        }
+
+        // the accumulator itself is kept in double precision, so it doesn't drift
+        setPhase(phase + increment * numSamples);
+    }
+
+ private:
+    uint sampleRate = 44100;
+    double frequency = 0.0, increment = 0.0, phase = 0.0;
+
+    // One cycle of a sine, with a guard point so the interpolation never has to wrap
+    static const array<float, tableSize + 1>& getTable() {
+        static const auto table = [] {
+            array<float, tableSize + 1> t {};
+
+            for (size_t i = 0; i <= tableSize; i++)
+                t[i] = float(std::sin(2.0 * M_PI * double(i) / double(tableSize)));
+
+            return t;
+        }();
+
+        return table;
+    }
+
+    static float lookup(const array<float, tableSize + 1>& table, float p) {
+        p = (p - std::floor(p)) * float(tableSize);
+
+        const auto index = jmin(int(p), tableSize - 1);
+        const float t = p - float(index);
+
+        return table[size_t(index)] + t * (table[size_t(index) + 1] - table[size_t(index)]);
+    }
+};
+
+} // end namespace pa::dsp
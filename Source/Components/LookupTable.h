@@ -0,0 +1,55 @@
+#pragma once
+#include "pa.h"
+
+// Several functions of one variable (over 0 - 1), sampled into a table and linearly
+// interpolated — for replacing mappings that are expensive to evaluate but smooth
+// - the channels of a point are stored together, so a lookup of all of them only reads
+//   two neighbouring rows
+
+namespace pa::dsp {
+
+template <typename FloatType, size_t numChannels>
+class LookupTable {
+ public:
+    using Values = array<FloatType, numChannels>;
+
+    // Sample fn(x) -> Values at numIntervals + 1 evenly spaced points from 0 to 1 (allocates)
+    template <typename Function>
+    void generate(int newNumIntervals, Function&& fn) {
+        numIntervals = jmax(1, newNumIntervals);
+        table.resize(size_t(numIntervals + 1) * numChannels);
+
+        for (int i = 0; i <= numIntervals; i++) {
+            const Values values = fn(FloatType(i) / FloatType(numIntervals));
+            std::copy(values.begin(), values.end(), table.begin() + std::ptrdiff_t(size_t(i) * numChannels));
+        }
+    }
+
+    // Returns the interpolated values at x (clamped to 0 - 1)
+    Values lookup(FloatType x) const noexcept {
+        jassert(!table.empty());
+
+        const FloatType position = pa::math::clamp<FloatType>(x, 0, 1) * FloatType(numIntervals);
+        const int index = jmin(int(position), numIntervals - 1);
+        const FloatType t = position - FloatType(index);
+
+        const FloatType* a = table.data() + size_t(index) * numChannels;
+        const FloatType* b = a + numChannels;
+        Values values;
+
+        for (size_t ch = 0; ch < numChannels; ch++)
+            values[ch] = a[ch] + t * (b[ch] - a[ch]);
+
+        return values;
+    }
+
+    int getNumIntervals() const noexcept {
+        return numIntervals;
+    }
+
+ private:
+    vector<FloatType> table;
+    int numIntervals = 0;
+};
+
+} // end namespace pa::dsp
@@ -0,0 +1,197 @@
+#pragma once
+#include <semaphore>
+#include "pa.h"
+
+/*
+ * ~ Pipeline ~
+ * Runs a stereo processor on a helper thread, a block behind the audio thread.
+ *
+ * The audio thread fills one of two buffers with the processor's input while reading its
+ * output from the other, which the helper has processed in the meantime. When the input
+ * buffer is full it's handed to the helper, and the two swap. So the helper processes
+ * block N while the audio thread runs everything else for block N + 1, at the cost of
+ * exactly blockSize samples of latency, whatever size the host's blocks are.
+ *
+ * The audio thread only ever waits if the helper hasn't finished its block by the time its
+ * output is needed (and the handoff itself is a semaphore, no locks). The processor must
+ * only be touched by the helper while the pipeline is running, except from the callback
+ * passed to process(), which is called while the helper is idle.
+*/
+
+namespace pa::dsp {
+
+template <typename Processor>
+class Pipeline : private Thread {
+ public:
+    explicit Pipeline(Processor& processorToRun) : Thread("OneRiser pipeline"), processor(processorToRun) {}
+
+    ~Pipeline() override {
+        stop();
+    }
+
+    // Allocate the buffers for a block size, if they aren't already (not while running)
+    void allocate(int newBlockSize) {
+        jassert(!running);
+        blockSize = jmax(1, newBlockSize);
+
+        for (auto& b : buffers) {
+            if (b.left.getSize() != uint(blockSize) || b.left.get() == nullptr) {
+                b.left.allocate(blockSize, true);
+                b.right.allocate(blockSize, true);
+            }
+        }
+    }
+
+    // Stop, and free the buffers
+    void release() {
+        stop();
+
+        for (auto& b : buffers) {
+            b.left.free();
+            b.right.free();
+        }
+    }
+
+    // Set where the buffers' memory comes from (this frees them, like release())
+    void setMemoryResource(std::pmr::memory_resource* resource) {
+        release();
+
+        for (auto& b : buffers) {
+            b.left.setMemoryResource(resource);
+            b.right.setMemoryResource(resource);
+        }
+    }
+
+    // Allocate the buffers (if needed) and start the helper thread (not on the audio thread)
+    // - returns false if the thread couldn't be started, and then the pipeline isn't running
+    bool start(int newBlockSize, uint sampleRate) {
+        stop();
+        allocate(newBlockSize);
+
+        for (auto& b : buffers) {
+            b.left.initialise();
+            b.right.initialise();
+        }
+
+        position = 0;
+        filling = 0;
+        outstanding = false;
+
+        while (work.try_acquire()) {}
+        while (finished.try_acquire()) {}
+
+        running = startRealtimeThread(RealtimeOptions().withApproximateAudioProcessingTime(blockSize, double(sampleRate)));
+        return running;
+    }
+
+    // Stop the helper thread, after it finishes any block it's processing (not on the audio thread)
+    void stop() {
+        if (!running) return;
+
+        signalThreadShouldExit();
+        work.release();
+        stopThread(-1);
+
+        running = false;
+        outstanding = false;
+    }
+
+    bool isRunning() const noexcept {
+        return running;
+    }
+
+    // The delay through the pipeline, in samples
+    int getLatencySamples() const noexcept {
+        return running ? blockSize : 0;
+    }
+
+    // Hand a block to the pipeline, and replace it with the output from blockSize samples ago
+    // - beforeHandoff() is called each time a full buffer is handed over, while the helper is
+    //   idle, e.g. to update the processor's parameters
+    template <typename Callback>
+    void process(float* left, float* right, int numSamples, Callback&& beforeHandoff) {
+        jassert(running);
+
+        for (int start = 0; start < numSamples;) {
+            const int n = jmin(numSamples - start, blockSize - position);
+
+            // the output buffer is the one the helper was given, so it has to be finished first
+            if (position == 0)
+                waitForHelper();
+
+            auto& in = buffers[size_t(filling)];
+            const auto& out = buffers[size_t(1 - filling)];
+
+            float* inL = in.left.get() + position, * inR = in.right.get() + position;
+            const float* outL = out.left.get() + position, * outR = out.right.get() + position;
+
+            for (int i = 0; i < n; i++) {
+                inL[i] = left[start + i];
+                inR[i] = right[start + i];
+                left[start + i] = outL[i];
+                right[start + i] = outR[i];
+            }
+
+            position += n;
+            start += n;
+
+            if (position == blockSize) {
+                beforeHandoff();
+
+                pending = &in;
+                outstanding = true;
+                work.release();
+
+                position = 0;
+                filling = 1 - filling;
+            }
+        }
+    }
+
+    // Wait for the helper, then clear the buffers (so the output is silent for a block),
+    // e.g. when the processor itself is cleared
+    void clear() {
+        waitForHelper();
+        position = 0;
+
+        for (auto& b : buffers) {
+            b.left.initialise();
+            b.right.initialise();
+        }
+    }
+
+ private:
+    struct Buffer {
+        HeapBlock<float> left, right;
+    };
+
+    Processor& processor;
+
+    array<Buffer, 2> buffers;
+    Buffer* pending = nullptr;
+    int blockSize = 0, position = 0, filling = 0;
+    bool running = false, outstanding = false;
+
+    std::binary_semaphore work { 0 }, finished { 0 };
+
+    void waitForHelper() {
+        if (!outstanding) return;
+
+        finished.acquire();
+        outstanding = false;
+    }
+
+    void run() override {
+        while (true) {
+            work.acquire();
+
+            if (threadShouldExit())
+                return;
+
+            processor.process(pending->left.get(), pending->right.get(), blockSize);
+            finished.release();
+        }
+    }
+};
+
+} // end namespace pa::dsp
@@ -0,0 +1,164 @@
+#pragma once
+#include "pa.h"
+
+// Halfband decimation and interpolation by 2, for running processors at a reduced rate
+// Both are polyphase — one branch of the halfband filter is a plain delay, so only the
+// other (numTaps long) is actually filtered. That's computed a block at a time, looping over
+// the outputs in the inner loop so it vectorises without having to reorder any sums.
+
+namespace pa::dsp {
+
+namespace halfband {
+// Taps for the filtered branch (of a 2 * numTaps - 1 tap Kaiser windowed sinc)
+// - about 0.001 dB passband ripple below 0.2 fs, and -89 dB from 0.3 fs
+static constexpr int numTaps = 32;
+
+static const array<float, numTaps>& getTaps() {
+    static const auto taps = [] {
+        // modified bessel function of the first kind, for the window
+        const auto i0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+
+            for (int k = 1; k < 50; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+
+            return sum;
+        };
+
+        constexpr double beta = 9.0, centre = numTaps - 1;
+        array<double, numTaps / 2> side {};
+        double sum = 0.0;
+
+        // the non-zero taps are the odd ones from the centre
+        for (size_t j = 0; j < side.size(); j++) {
+            const double k = 2.0 * double(j) + 1.0;
+            const double window = i0(beta * std::sqrt(1.0 - (k / centre) * (k / centre))) / i0(beta);
+
+            side[j] = window * std::sin(M_PI * k / 2.0) / (M_PI * k);
+            sum += side[j];
+        }
+
+        // normalise for unity gain at DC (the centre tap is 0.5)
+        array<float, numTaps> t {};
+
+        for (size_t j = 0; j < side.size(); j++) {
+            const auto tap = float(side[j] * 0.25 / sum);
+            t[numTaps / 2 + j] = tap;
+            t[numTaps / 2 - 1 - j] = tap;
+        }
+
+        return t;
+    }();
+
+    return taps;
+}
+
+// output[i] = sum of taps[t] * input[i + t]
+static inline void filter(const float* input, float* output, int numSamples) {
+    const auto& taps = getTaps();
+
+    std::fill_n(output, numSamples, 0.0f);
+
+    for (int t = 0; t < numTaps; t++) {
+        const float c = taps[size_t(t)];
+
+        for (int i = 0; i < numSamples; i++)
+            output[i] += c * input[i + t];
+    }
+}
+} // end namespace halfband
+
+class HalfbandDecimator {
+ public:
+    void reset() {
+        odd.fill(0.0f);
+        even.fill(0.0f);
+    }
+
+    void writeState(OutputStream& stream) const {
+        state::writeArray(stream, odd.data(), oddHistory);
+        state::writeArray(stream, even.data(), evenHistory);
+    }
+
+    bool readState(InputStream& stream) {
+        return state::readArray(stream, odd.data(), oddHistory) && state::readArray(stream, even.data(), evenHistory);
+    }
+
+    // Decimate 2 * numOutput samples into numOutput
+    void process(const float* input, float* output, int numOutput) {
+        for (int start = 0; start < numOutput; start += chunkSize) {
+            const int n = jmin(chunkSize, numOutput - start);
+            const float* x = input + 2 * start;
+            float* y = output + start;
+
+            // split the phases, after their histories
+            for (int i = 0; i < n; i++) {
+                even[size_t(evenHistory + i)] = x[2 * i];
+                odd[size_t(oddHistory + i)] = x[2 * i + 1];
+            }
+
+            // the odd phase is filtered, the even phase only delayed (by the centre tap)
+            halfband::filter(odd.data(), y, n);
+
+            for (int i = 0; i < n; i++)
+                y[i] += 0.5f * even[size_t(i)];
+
+            std::copy_n(odd.begin() + n, oddHistory, odd.begin());
+            std::copy_n(even.begin() + n, evenHistory, even.begin());
+        }
+    }
+
+ private:
+    static constexpr int chunkSize = 64,
+                         oddHistory = halfband::numTaps - 1,
+                         evenHistory = halfband::numTaps / 2 - 1;
+
+    array<float, chunkSize + oddHistory> odd {};
+    array<float, chunkSize + evenHistory> even {};
+};
+
+class HalfbandInterpolator {
+ public:
+    void reset() {
+        history.fill(0.0f);
+    }
+
+    void writeState(OutputStream& stream) const {
+        state::writeArray(stream, history.data(), inputHistory);
+    }
+
+    bool readState(InputStream& stream) {
+        return state::readArray(stream, history.data(), inputHistory);
+    }
+
+    // Interpolate numInput samples into 2 * numInput
+    void process(const float* input, float* output, int numInput) {
+        float filtered[chunkSize];
+
+        for (int start = 0; start < numInput; start += chunkSize) {
+            const int n = jmin(chunkSize, numInput - start);
+            float* y = output + 2 * start;
+
+            std::copy_n(input + start, n, history.begin() + inputHistory);
+
+            // the even outputs are filtered, the odd ones are the (delayed) inputs
+            halfband::filter(history.data(), filtered, n);
+
+            for (int i = 0; i < n; i++) {
+                y[2 * i] = 2.0f * filtered[i];
+                y[2 * i + 1] = history[size_t(i + halfband::numTaps / 2)];
+            }
+
+            std::copy_n(history.begin() + n, inputHistory, history.begin());
+        }
+    }
+
+ private:
+    static constexpr int chunkSize = 64, inputHistory = halfband::numTaps - 1;
+
+    array<float, chunkSize + inputHistory> history {};
+};
+
+} // end namespace pa::dsp
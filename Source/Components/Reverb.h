@@ -1,7 +1,14 @@
 #pragma once
 #include "pa.h"
+#include "Resampler.h"
 
 // Stereo reverb processor (simply a collection of comb filters)
+// At high sample rates the combs can optionally run at a decimated rate (see setMultirate()),
+// while the dry signal and the mix stay at the full rate
+// The block methods run the combs a chunk at a time through the block kernels (see Kernels.h),
+// all of a channel's damped combs at once
+// Changing how many combs run (e.g. RiserProcessor's quality levels) fades the combs coming into
+// or going out of use over a moment, rather than switching them
 
 namespace pa::dsp {
 
@@ -14,24 +21,15 @@ class Reverb {
         uint numEarlyCombs = 8, numLateCombs = 4;
     };
 
+    static constexpr uint maxEarlyCombs = 8, maxLateCombs = 4;
+
+    // the combs' rate is halved (up to maxFactor times) as long as it stays at least this
+    static constexpr uint minInternalRate = 44100, maxFactor = 4;
+
     // Constructor, which initialises default filter values
+    // - nothing is allocated until prepare() is called
     Reverb() {
-        // set comb vectors
-        earlyCombs.resize(2);
-        lateCombs.resize(2);
-
-        for (auto& ch : earlyCombs)
-            ch.resize(8);
-        for (auto& ch : lateCombs)
-            ch.resize(4);
-
-        // arbitrary default comb values, in case none are passed
-        earlyCombTimes = { 0.06f, 0.04f, 0.02f, 0.01f, 0.052f, 0.036f, 0.042f, 0.024f };
-        lateCombTimes = { 0.011f, 0.054f, 0.033f, 0.023f };
         setCombs();
-
-        // "initialise"
-        prepare(44100);
     }
 
     // Prepare the reverb for playback
@@ -40,17 +38,55 @@ class Reverb {
         if (newSampleRate != sampleRate && newSampleRate != 0)
             sampleRate = newSampleRate;
 
-        // prepare all filters
+        // pick the rate the combs run at
+        factor = 1;
+
+        while (multirate && factor < maxFactor && sampleRate / (factor * 2) >= minInternalRate)
+            factor *= 2;
+
+        internalRate = sampleRate / factor;
+
+        // the combs' chunks have to be shorter than their shortest delay (see Comb::SetTime()),
+        // with a sample to spare for the delay smoothing's rounding
+        combChunk = jlimit(1, maxCombChunk, int(internalRate / 1000) - 1);
+
+        // prepare all filters (only allocates if the buffer sizes change)
         prepareCombs();
+        clearResampling();
 
         // set all smoothed values
-        dampingSmooth.reset(sampleRate, 0.05);
-        feedbackSmooth.reset(sampleRate, 0.05);
+        dampingSmooth.reset(internalRate, 0.05);
+        feedbackSmooth.reset(internalRate, 0.05);
         drySmooth.reset(sampleRate, 0.05);
         wet1.reset(sampleRate, 0.05);
         wet2.reset(sampleRate, 0.05);
+        preGainSmooth.reset(sampleRate, 0.05);
+        combFade.reset(internalRate, 0.05);
+        sendSmooth.reset(sampleRate, 0.05);
+        return1.reset(sampleRate, 0.05);
+        return2.reset(sampleRate, 0.05);
+    }
+
+    // Frees the reverb's buffers, prepare() must be called again before processing
+    void release() {
+        for (uint ch = 0; ch < 2; ch++) {
+            for (auto& filter : earlyCombs[ch])
+                filter.release();
+
+            for (auto& filter : lateCombs[ch])
+                filter.release();
+        }
+    }
+
+    // Sets where the combs' memory comes from (this frees it, like release())
+    void setMemoryResource(std::pmr::memory_resource* resource) {
+        for (uint ch = 0; ch < 2; ch++) {
+            for (auto& filter : earlyCombs[ch])
+                filter.setMemoryResource(resource);
 
-        clear();
+            for (auto& filter : lateCombs[ch])
+                filter.setMemoryResource(resource);
+        }
     }
 
     // Clears the reverb's buffers
@@ -62,6 +98,23 @@ class Reverb {
             for (auto& filter : lateCombs[ch])
                 filter.clear();
         }
+
+        clearResampling();
+    }
+
+    // Run the combs at a reduced rate when the sample rate allows it (applied on prepare())
+    // - this adds up to maxFactor - 1 samples of delay to the wet signal, plus the filters'
+    void setMultirate(bool shouldBeMultirate) {
+        multirate = shouldBeMultirate;
+    }
+
+    bool isMultirate() const noexcept {
+        return multirate;
+    }
+
+    // The rate the combs are running at
+    uint getInternalRate() const noexcept {
+        return internalRate;
     }
 
     // Sets the reverb's parameters to the argument object, and updates them appropriately
@@ -70,18 +123,28 @@ class Reverb {
         const float oldMix = parameters.mix, oldSpread = parameters.spread,
                     oldDamp = parameters.damping, oldSize = parameters.size;
 
+        const uint oldEarly = parameters.numEarlyCombs, oldLate = parameters.numLateCombs;
+
         // update parameter object
         parameters = newParameters;
+        parameters.numEarlyCombs = jmin(parameters.numEarlyCombs, maxEarlyCombs);
+        parameters.numLateCombs = jmin(parameters.numLateCombs, maxLateCombs);
+
+        if (parameters.numEarlyCombs != oldEarly || parameters.numLateCombs != oldLate)
+            startCombFade(oldEarly, oldLate);
 
         // update mix values, if necessary
         if (parameters.mix != oldMix)
             setMixValues();
 
         // set gain values
-        preGain = 0.1f / float(parameters.numEarlyCombs + parameters.numLateCombs);
+        preGainSmooth.setTargetValue(0.1f / float(parameters.numEarlyCombs + parameters.numLateCombs));
         drySmooth.setTargetValue(dry);
         wet1.setTargetValue(wetGainScale * wet * (1 + parameters.width));
         wet2.setTargetValue(wetGainScale * wet * (1 - parameters.width));
+        sendSmooth.setTargetValue(wet);
+        return1.setTargetValue(wetGainScale * (1 + parameters.width));
+        return2.setTargetValue(wetGainScale * (1 - parameters.width));
 
         // update comb frequencies, if necessary
         if (parameters.spread != oldSpread)
@@ -92,6 +155,15 @@ class Reverb {
             setDamping();
     }
 
+    // Set all comb frequencies at once (only updates the combs once)
+    void setCombTimes(const array<float, maxEarlyCombs>& newEarlyTimes,
+                      const array<float, maxLateCombs>& newLateTimes) {
+        earlyCombTimes = newEarlyTimes;
+        lateCombTimes = newLateTimes;
+
+        setCombs();
+    }
+
     // Set a particular early comb's frequency
     void setEarlyCombTime(const float& newDelayTime, const uint& combIndex) {
         earlyCombTimes[pa::math::clamp<uint>(combIndex, 0, 7)] = newDelayTime;
@@ -106,28 +178,122 @@ class Reverb {
         setCombs();
     }
 
-    // Process a both stereo samples
+    // Write everything the output depends on besides the parameters (for snapshots)
+    void writeState(OutputStream& stream) const {
+        state::write(stream, factor);
+
+        for (const auto* smooth : { &dampingSmooth, &feedbackSmooth, &wet1, &wet2, &drySmooth, &preGainSmooth, &combFade })
+            smooth->writeState(stream);
+
+        state::write(stream, fadeFromEarly);
+        state::write(stream, fadeFromLate);
+
+        for (uint ch = 0; ch < 2; ch++) {
+            for (const auto& comb : earlyCombs[ch])
+                comb.writeState(stream);
+
+            for (const auto& comb : lateCombs[ch])
+                comb.writeState(stream);
+        }
+
+        for (const auto& d : decimators)
+            d.writeState(stream);
+
+        for (const auto& stage : interpolators)
+            for (const auto& i : stage)
+                i.writeState(stream);
+
+        state::write(stream, numPending);
+        state::write(stream, numQueued);
+        state::writeArray(stream, send.data(), size_t(numPending));
+        state::writeArray(stream, wetL.data(), size_t(numQueued));
+        state::writeArray(stream, wetR.data(), size_t(numQueued));
+    }
+
+    // Call visit() with every fed back value, each comb's line and damping (the resamplers
+    // don't feed anything back)
+    template <typename Visitor>
+    void visitState(Visitor&& visit) const {
+        for (uint ch = 0; ch < 2; ch++) {
+            for (const auto& comb : earlyCombs[ch])
+                comb.visitState(visit);
+
+            for (const auto& comb : lateCombs[ch])
+                comb.visitState(visit);
+        }
+    }
+
+    // Read back a state from writeState() — the reverb must be prepared the same way (rate and
+    // multirate) and have the same parameters as when it was written
+    bool readState(InputStream& stream) {
+        uint stateFactor = 0;
+
+        if (!state::read(stream, stateFactor) || stateFactor != factor)
+            return false;
+
+        for (auto* smooth : { &dampingSmooth, &feedbackSmooth, &wet1, &wet2, &drySmooth, &preGainSmooth, &combFade })
+            if (!smooth->readState(stream)) return false;
+
+        if (!state::read(stream, fadeFromEarly) || fadeFromEarly > maxEarlyCombs
+            || !state::read(stream, fadeFromLate) || fadeFromLate > maxLateCombs)
+            return false;
+
+        for (uint ch = 0; ch < 2; ch++) {
+            for (auto& comb : earlyCombs[ch])
+                if (!comb.readState(stream)) return false;
+
+            for (auto& comb : lateCombs[ch])
+                if (!comb.readState(stream)) return false;
+        }
+
+        for (auto& d : decimators)
+            if (!d.readState(stream)) return false;
+
+        for (auto& stage : interpolators)
+            for (auto& i : stage)
+                if (!i.readState(stream)) return false;
+
+        return state::read(stream, numPending) && numPending >= 0 && numPending < int(factor)
+            && state::read(stream, numQueued) && numQueued >= 0 && numQueued < int(factor)
+            && state::readArray(stream, send.data(), size_t(numPending))
+            && state::readArray(stream, wetL.data(), size_t(numQueued))
+            && state::readArray(stream, wetR.data(), size_t(numQueued));
+    }
+
+    // How long the reverb rings on after its input stops (to -60 dB), at the current size
+    double getTailLengthSeconds() const {
+        if (parameters.mix <= 0.0f) return 0.0;
+
+        const auto ringTime = [](double loopTime, double feedback) {
+            return loopTime * std::log(0.001) / std::log(feedback);
+        };
+
+        // (the widest spread, as it lengthens one side's combs)
+        const float spread = maxSpread / 2;
+
+        // the damped combs ring in parallel, so only the longest counts, then the late combs add theirs in series
+        const float longestEarly = *std::max_element(earlyCombTimes.begin(), earlyCombTimes.begin() + parameters.numEarlyCombs);
+        double tail = ringTime(longestEarly + spread, parameters.size * fbScale + fbOffset);
+
+        for (uint i = 0; i < parameters.numLateCombs; i++)
+            tail += ringTime(lateCombTimes[i] + spread, lateFeedback);
+
+        return tail;
+    }
+
+    // Process a both stereo samples (full rate only, otherwise use the block version)
     void process(float* left, float* right) {
         // guard-check for nullptr
         if (left == nullptr || right == nullptr) return;
 
+        jassert(factor == 1);
+
         // create variables
-        const float input = (*left + *right) * preGain;
-        const float damp = dampingSmooth.getNextValue(),
-                    feed = feedbackSmooth.getNextValue();
+        const float input = (*left + *right) * preGainSmooth.getNextValue();
         float outL = 0.0f,
               outR = 0.0f;
 
-        // accumulate damping combs in parallel
-        for (uint j = 0; j < parameters.numEarlyCombs; j++) {
-            outL += earlyCombs[0][j].processEarly(&input, damp, feed);
-            outR += earlyCombs[1][j].processEarly(&input, damp, feed);
-        }
-        // send to non-damping combs in series
-        for (uint j = 0; j < parameters.numLateCombs; j++) {
-            outL = lateCombs[0][j].processLate(&outL);
-            outR = lateCombs[1][j].processLate(&outR);
-        }
+        processCombs(input, outL, outR);
 
         // set gain values and send to output
         const float d = drySmooth.getNextValue();
@@ -138,15 +304,335 @@ class Reverb {
         *right = d * (*right) + w1 * outR + w2 * outL;
     }
 
+                // Send and return
+    // The two halves of process(), for sharing one reverb's combs between several sources (see
+    // ReverbBus.h) — the combs are linear, so each source's wet level can go on its send instead
+    // of the output, and a return over the summed sends gives every source's wet signal at once
+
+    // Scale a block by the dry level in place, and write the mono send (the combs' input, at this
+    // reverb's wet level) — the combs aren't run
+    void processSend(float* left, float* right, float* send, int numSamples) {
+        float d[blockSize], w[blockSize], pre[blockSize];
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+            float* l = left + start, * r = right + start, * s = send + start;
+
+            drySmooth.getNextValues(d, n);
+            sendSmooth.getNextValues(w, n);
+            preGainSmooth.getNextValues(pre, n);
+
+            for (int i = 0; i < n; i++) {
+                s[i] = (l[i] + r[i]) * pre[i] * w[i];
+                l[i] *= d[i];
+                r[i] *= d[i];
+            }
+        }
+    }
+
+    // Run the combs over a block of (summed) sends, adding the wet signal to left and right
+    // - only the size, damping, width and spread apply, the levels come with the sends
+    // - full rate only
+    void processReturn(const float* send, float* left, float* right, int numSamples) {
+        jassert(factor == 1);
+
+        const auto& kernels = pa::dsp::kernels::get();
+        float outL[blockSize], outR[blockSize], r1[blockSize], r2[blockSize];
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+
+            processCombs(send + start, outL, outR, n);
+            return1.getNextValues(r1, n);
+            return2.getNextValues(r2, n);
+
+            kernels.stereoMix(left + start, right + start, outL, outR, nullptr, r1, r2, n);
+        }
+    }
+
+    // Process a block of stereo samples
+    void process(float* left, float* right, int numSamples) {
+        if (left == nullptr || right == nullptr) return;
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+
+            if (factor == 1)
+                processFullRate(left + start, right + start, n);
+            else
+                processDecimated(left + start, right + start, n);
+        }
+    }
+
  private:
-    uint sampleRate = 44100;
-    float preGain = 0.0f, wet = 0.0f, dry = 0.0f;
+    static constexpr int blockSize = 256, maxCombChunk = 32;
+    static constexpr int combLanes = pa::dsp::kernels::dampedCombLanes;
+    static_assert(combLanes == 2 * int(maxEarlyCombs));
+
+    uint sampleRate = 44100, internalRate = 44100, factor = 1;
+    int combChunk = 1;
+    bool multirate = false;
+    float wet = 0.0f, dry = 0.0f;
     static constexpr float wetGainScale = 1.2f;
-    juce::SmoothedValue<float> dampingSmooth, feedbackSmooth, wet1, wet2, drySmooth;
+    static constexpr float fbScale = 0.78f, fbOffset = 0.2f, dampScale = 0.9f,
+                           lateFeedback = 0.5f, maxSpread = 0.01f;
+    SmoothValue<float> dampingSmooth, feedbackSmooth, wet1, wet2, drySmooth;
+    SmoothValue<float> sendSmooth, return1, return2; // (send and return only)
+    SmoothValue<float> preGainSmooth;
     Parameters parameters;
 
+    // the fade from the comb counts before the last change (see startCombFade()), from 0 to 1
+    SmoothValue<float> combFade { 1.0f };
+    uint fadeFromEarly = maxEarlyCombs, fadeFromLate = maxLateCombs;
+
+    // Start fading from the old comb counts to the new ones (cutting short any fade under way)
+    // - the combs coming back into use hold whatever they had when they were dropped, so they're
+    //   cleared first (constant time, see RingBuffer::clear())
+    void startCombFade(uint oldEarly, uint oldLate) {
+        for (uint ch = 0; ch < 2; ch++) {
+            for (uint j = oldEarly; j < parameters.numEarlyCombs; j++)
+                earlyCombs[ch][j].clear();
+
+            for (uint j = oldLate; j < parameters.numLateCombs; j++)
+                lateCombs[ch][j].clear();
+        }
+
+        fadeFromEarly = oldEarly;
+        fadeFromLate = oldLate;
+
+        // (before prepare(), there's nothing to fade, so this lands straight away)
+        combFade.setCurrentAndTargetValue(0.0f);
+        combFade.setTargetValue(1.0f);
+    }
+
+    // A comb's gain through a fade: 1 if it's in use both before and after, otherwise fading in
+    // if it's only in use after, or out if only before
+    static float getFadeGain(float fade, uint index, uint numBefore, uint numAfter) {
+        if (index < numBefore && index < numAfter) return 1.0f;
+
+        return index < numAfter ? fade : 1.0f - fade;
+    }
+
+    // As above, over a chunk of the fade — returns false (and leaves gains alone) if they'd all be 1
+    static bool getFadeGains(float* gains, const float* fade, uint index, uint numBefore, uint numAfter, int numSamples) {
+        if (index < numBefore && index < numAfter) return false;
+
+        for (int i = 0; i < numSamples; i++)
+            gains[i] = getFadeGain(fade[i], index, numBefore, numAfter);
+
+        return true;
+    }
+
+    // Runs one sample through the comb network
+    void processCombs(const float input, float& outL, float& outR) {
+        const float damp = dampingSmooth.getNextValue(),
+                    feed = feedbackSmooth.getNextValue();
+
+        // (through a fade, the combs in use before or after it all run, see getFadeGain())
+        const bool fading = combFade.isSmoothing();
+        const float fade = combFade.getNextValue();
+        const uint numEarly = fading ? jmax(fadeFromEarly, parameters.numEarlyCombs) : parameters.numEarlyCombs,
+                   numLate = fading ? jmax(fadeFromLate, parameters.numLateCombs) : parameters.numLateCombs;
+
+        // accumulate damping combs in parallel
+        for (uint j = 0; j < numEarly; j++) {
+            const float gain = getFadeGain(fade, j, fadeFromEarly, parameters.numEarlyCombs);
+
+            outL += earlyCombs[0][j].processEarly(&input, damp, feed, gain);
+            outR += earlyCombs[1][j].processEarly(&input, damp, feed, gain);
+        }
+        // send to non-damping combs in series (crossfaded with bypassing them, through a fade)
+        for (uint j = 0; j < numLate; j++) {
+            const float gain = getFadeGain(fade, j, fadeFromLate, parameters.numLateCombs);
+            const float lateL = lateCombs[0][j].processLate(&outL),
+                        lateR = lateCombs[1][j].processLate(&outR);
+
+            outL = gain < 1.0f ? outL + gain * (lateL - outL) : lateL;
+            outR = gain < 1.0f ? outR + gain * (lateR - outR) : lateR;
+        }
+    }
+
+    // Runs a block (up to blockSize) through the comb network, the same as a processCombs() per sample
+    void processCombs(const float* input, float* outL, float* outR, int numSamples) {
+        const auto& kernels = pa::dsp::kernels::get();
+
+        // (through a fade, the combs in use before or after it all run, see getFadeGain())
+        const bool fading = combFade.isSmoothing();
+        const uint numEarly = fading ? jmax(fadeFromEarly, parameters.numEarlyCombs) : parameters.numEarlyCombs,
+                   numLate = fading ? jmax(fadeFromLate, parameters.numLateCombs) : parameters.numLateCombs;
+
+        // (the damped combs' lanes are interleaved, combLanes to a sample)
+        float damp[maxCombChunk], feed[maxCombChunk], delayed[maxCombChunk], feedbackLine[maxCombChunk];
+        float early[maxCombChunk * combLanes], earlyFeedback[maxCombChunk * combLanes];
+        float state[combLanes];
+        float fade[maxCombChunk], gain[maxCombChunk], bypass[maxCombChunk];
+
+        for (int start = 0; start < numSamples; start += combChunk) {
+            const int n = jmin(combChunk, numSamples - start);
+            float* l = outL + start, * r = outR + start;
+
+            dampingSmooth.getNextValues(damp, n);
+            feedbackSmooth.getNextValues(feed, n);
+
+            if (fading)
+                combFade.getNextValues(fade, n);
+
+            // damped combs in parallel (the unused ones read as silence)
+            std::fill_n(early, size_t(n * combLanes), 0.0f);
+            std::fill_n(state, size_t(combLanes), 0.0f);
+
+            for (uint ch = 0; ch < 2; ch++) {
+                for (uint j = 0; j < numEarly; j++) {
+                    const size_t lane = ch * maxEarlyCombs + j;
+
+                    earlyCombs[ch][j].read(delayed, n);
+                    state[lane] = earlyCombs[ch][j].getPreviousValue();
+
+                    if (fading && getFadeGains(gain, fade, j, fadeFromEarly, parameters.numEarlyCombs, n))
+                        for (int i = 0; i < n; i++)
+                            delayed[i] *= gain[i];
+
+                    for (int i = 0; i < n; i++)
+                        early[size_t(i * combLanes) + lane] = delayed[i];
+                }
+            }
+
+            kernels.dampedCombs(early, earlyFeedback, state, input + start, damp, feed, l, r, n);
+
+            for (uint ch = 0; ch < 2; ch++) {
+                for (uint j = 0; j < numEarly; j++) {
+                    const size_t lane = ch * maxEarlyCombs + j;
+
+                    for (int i = 0; i < n; i++)
+                        feedbackLine[i] = earlyFeedback[size_t(i * combLanes) + lane];
+
+                    earlyCombs[ch][j].push(feedbackLine, n);
+                    earlyCombs[ch][j].setPreviousValue(state[lane]);
+                }
+            }
+
+            // then the late combs in series (crossfaded with bypassing them, through a fade)
+            for (uint j = 0; j < numLate; j++) {
+                const bool faded = fading && getFadeGains(gain, fade, j, fadeFromLate, parameters.numLateCombs, n);
+
+                for (uint ch = 0; ch < 2; ch++) {
+                    float* x = (ch == 0) ? l : r;
+
+                    if (faded)
+                        std::copy_n(x, n, bypass);
+
+                    lateCombs[ch][j].read(delayed, n);
+                    kernels.lateComb(x, delayed, feedbackLine, lateFeedback, n);
+                    lateCombs[ch][j].push(feedbackLine, n);
+
+                    if (faded)
+                        for (int i = 0; i < n; i++)
+                            x[i] = gain[i] < 1.0f ? bypass[i] + gain[i] * (x[i] - bypass[i]) : x[i];
+                }
+            }
+        }
+    }
+
+    // Block processing with the combs at the full rate
+    void processFullRate(float* left, float* right, int numSamples) {
+        float outL[blockSize], outR[blockSize];
+
+        float pre[blockSize];
+        preGainSmooth.getNextValues(pre, numSamples);
+
+        // (nothing is ever pending at the full rate)
+        for (int i = 0; i < numSamples; i++)
+            send[size_t(i)] = (left[i] + right[i]) * pre[i];
+
+        processCombs(send.data(), outL, outR, numSamples);
+        mix(left, right, outL, outR, numSamples);
+    }
+
+    // Mixes the wet signal in at the full rate
+    void mix(float* left, float* right, const float* outL, const float* outR, int numSamples) {
+        const auto& kernels = pa::dsp::kernels::get();
+        float d[blockSize], w1[blockSize], w2[blockSize];
+
+        drySmooth.getNextValues(d, numSamples);
+        wet1.getNextValues(w1, numSamples);
+        wet2.getNextValues(w2, numSamples);
+
+        kernels.stereoMix(left, right, outL, outR, d, w1, w2, numSamples);
+    }
+
+    // Block processing with the combs at the internal rate
+    // Input is decimated in whole groups of factor samples, with any remainder carried over to the
+    // next block. The wet signal is queued factor - 1 samples ahead, so there's always enough of it
+    void processDecimated(float* left, float* right, int numSamples) {
+        float pre[blockSize];
+        preGainSmooth.getNextValues(pre, numSamples);
+
+        // mono send, after any input left over from the last block
+        for (int i = 0; i < numSamples; i++)
+            send[size_t(numPending + i)] = (left[i] + right[i]) * pre[i];
+
+        const int total = numPending + numSamples,
+                  used = total - total % int(factor);
+        const int numStages = (factor == 4) ? 2 : 1;
+
+        // decimate
+        const float* in = send.data();
+        int num = used;
+
+        for (int s = 0; s < numStages; s++) {
+            num /= 2;
+            decimators[size_t(s)].process(in, down[size_t(s)].data(), num);
+            in = down[size_t(s)].data();
+        }
+
+        // run the combs
+        processCombs(in, coreL.data(), coreR.data(), num);
+
+        // interpolate onto the end of the wet queue
+        const float* srcL = coreL.data(), * srcR = coreR.data();
+
+        for (int s = numStages - 1; s >= 0; s--) {
+            float* dstL = (s == 0) ? wetL.data() + numQueued : upL.data();
+            float* dstR = (s == 0) ? wetR.data() + numQueued : upR.data();
+
+            interpolators[size_t(s)][0].process(srcL, dstL, num);
+            interpolators[size_t(s)][1].process(srcR, dstR, num);
+
+            srcL = dstL;
+            srcR = dstR;
+            num *= 2;
+        }
+
+        // mix at the full rate
+        mix(left, right, wetL.data(), wetR.data(), numSamples);
+
+        // keep what's left over for the next block
+        const int queued = numQueued + used;
+
+        std::copy(send.begin() + used, send.begin() + total, send.begin());
+        std::copy(wetL.begin() + numSamples, wetL.begin() + queued, wetL.begin());
+        std::copy(wetR.begin() + numSamples, wetR.begin() + queued, wetR.begin());
+
+        numPending = total - used;
+        numQueued = queued - numSamples;
+    }
+
+    void clearResampling() {
+        for (auto& d : decimators)
+            d.reset();
+
+        for (auto& stage : interpolators)
+            for (auto& i : stage)
+                i.reset();
+
+        wetL.fill(0.0f);
+        wetR.fill(0.0f);
+        numPending = 0;
+        numQueued = int(factor) - 1;
+    }
+
     void setCombs() {
-        auto spreadAmount = pa::math::clamp<float>(parameters.spread, 0.0f, 0.01f) / 2;
+        auto spreadAmount = pa::math::clamp<float>(parameters.spread, 0.0f, maxSpread) / 2;
 
         for (uint ch = 0; ch < 2; ch++) {
             float spread = (ch == 0) ? spreadAmount : -spreadAmount;
@@ -162,10 +648,10 @@ class Reverb {
     void prepareCombs() {
         for (uint ch = 0; ch < 2; ch++) {
             for (auto& cmb : earlyCombs[ch])
-                cmb.prepare(sampleRate);
+                cmb.prepare(internalRate);
 
             for (auto& cmb : lateCombs[ch])
-                cmb.prepare(sampleRate);
+                cmb.prepare(internalRate);
         }
     }
 
@@ -176,21 +662,40 @@ class Reverb {
     }
 
     void setDamping() {
-        constexpr float fbScale = 0.78f, fbOffset = 0.2f,
-                        dampScale = 0.9f;
-
         dampingSmooth.setTargetValue(parameters.damping * dampScale);
         feedbackSmooth.setTargetValue(parameters.size * fbScale + fbOffset);
     }
 
     class Comb {
      public:
-        Comb() { prepare(44100); }
-
         // prepare the filter's buffer and smoothed values
         void prepare(const uint& newSampleRate) {
             buffer.prepare(0.1f, newSampleRate);
-            clear();
+            previousValue = 0.0f;
+        }
+
+        // free the filter's buffer
+        void release() {
+            buffer.release();
+        }
+
+        void setMemoryResource(std::pmr::memory_resource* resource) {
+            buffer.setMemoryResource(resource);
+        }
+
+        void writeState(OutputStream& stream) const {
+            buffer.writeState(stream);
+            state::write(stream, previousValue);
+        }
+
+        bool readState(InputStream& stream) {
+            return buffer.readState(stream) && state::read(stream, previousValue);
+        }
+
+        template <typename Visitor>
+        void visitState(Visitor&& visit) const {
+            buffer.visitState(visit);
+            visit(previousValue);
         }
 
         // clear the filter's buffer
@@ -199,20 +704,43 @@ class Reverb {
             buffer.clear();
         }
 
+        float getPreviousValue() const noexcept {
+            return previousValue;
+        }
+
+        void setPreviousValue(float value) noexcept {
+            previousValue = value;
+        }
+
+        // read the next numSamples delayed samples, which must be fewer than the delay (see
+        // RingBuffer::getBlockFromBuffer()), before pushing them with push()
+        void read(float* dest, int numSamples) {
+            float delaySamples[maxCombChunk];
+
+            buffer.getDelaySamples(delaySamples, numSamples);
+            buffer.getBlockFromBuffer(dest, delaySamples, numSamples, pa::dsp::noInterp);
+        }
+
+        void push(const float* input, int numSamples) {
+            buffer.pushBlockToBuffer(input, numSamples);
+        }
+
         // set the delay time of the buffer (filter frequency)
+        // - at least 1 ms, which the block processing relies on
         void SetTime(const float& delayTimeInSeconds) {
             buffer.setDelayTime(pa::math::clamp(delayTimeInSeconds, 0.001f, 1.0f));
         }
 
         // process early (damped) reflections
-        float processEarly(const float* const input, const float& damp, const float& feed) {
+        // - gain scales the delayed signal, fed back and all (see getFadeGain())
+        float processEarly(const float* const input, const float& damp, const float& feed, float gain = 1.0f) {
             // get delayed signal
-            float delayLine = buffer.getFromBuffer();
+            float delayLine = buffer.getFromBuffer() * gain;
             // apply low pass (weighted average), used for hf damping:
-            previousValue = delayLine + damp * (previousValue - delayLine);
+            previousValue = pa::math::flushDenormal(delayLine + damp * (previousValue - delayLine));
 
-            // multiply by feed, sum with input
-            float temp = *input + previousValue * feed;
+            // multiply by feed, sum with input (flushed, as it's fed back)
+            float temp = pa::math::flushDenormal(*input + previousValue * feed);
             // add to buffer
             buffer.pushToBuffer(&temp);
 
@@ -225,8 +753,8 @@ class Reverb {
             // get delayed signal
             float delayLine = buffer.getFromBuffer();
 
-            // multiply by fixed feedback, sum with input
-            float temp = *input + delayLine * 0.5f;
+            // multiply by fixed feedback, sum with input (flushed, as it's fed back)
+            float temp = pa::math::flushDenormal(*input + delayLine * lateFeedback);
             // add to buffer
             buffer.pushToBuffer(&temp);
 
@@ -241,8 +769,22 @@ class Reverb {
     };
 
     // combs[channel][instance]
-    vector<vector<Comb>> earlyCombs, lateCombs;
-    vector<float> earlyCombTimes, lateCombTimes;
+    array<array<Comb, maxEarlyCombs>, 2> earlyCombs;
+    array<array<Comb, maxLateCombs>, 2> lateCombs;
+
+    // decimation (and interpolation, per channel) stages, and the buffers between them
+    array<HalfbandDecimator, 2> decimators;
+    array<array<HalfbandInterpolator, 2>, 2> interpolators;
+
+    array<float, blockSize + maxFactor> send {};
+    array<array<float, (blockSize + maxFactor) / 2>, 2> down {};
+    array<float, (blockSize + maxFactor) / 2> coreL {}, coreR {}, upL {}, upR {};
+    array<float, blockSize + 2 * maxFactor> wetL {}, wetR {};
+    int numPending = 0, numQueued = 0;
+
+    // arbitrary default comb values, in case none are passed
+    array<float, maxEarlyCombs> earlyCombTimes { 0.06f, 0.04f, 0.02f, 0.01f, 0.052f, 0.036f, 0.042f, 0.024f };
+    array<float, maxLateCombs> lateCombTimes { 0.011f, 0.054f, 0.033f, 0.023f };
 };
 
 } // end namespace pa::dsp
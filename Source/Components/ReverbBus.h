@@ -0,0 +1,215 @@
+#pragma once
+#include <atomic>
+#include "pa.h"
+#include "Reverb.h"
+
+/*
+ * ~ Reverb bus ~
+ * One reverb shared by several processors in the same process, e.g. every OneRiser instance
+ * in a session, so a build-up across ten tracks runs one reverb rather than ten.
+ *
+ * Each processor joins the bus and gets a slot, then every block posts its mono send (the
+ * combs' input, already at its own wet level, see Reverb::processSend()) to its slot's FIFO.
+ * The processor in the lowest slot is the return: it also sums every slot's send, in slot
+ * order, runs the reverb over the sum and adds the result to its own output. The others
+ * only play their dry signal.
+ *
+ * Each FIFO starts out holding a block of silence, so the return always reads the sends from
+ * a block ago, whatever order the host runs the instances in and on whichever threads — the
+ * sum is the same every time, for a block's pre-delay on the shared reverb. Posting and
+ * reading are lock-free.
+ *
+ * So before each read a FIFO holds between that block and a block more (depending on whether
+ * its owner has posted yet). If it falls outside that, as when an owner stops processing for a
+ * while (e.g. it's bypassed) or the return does, the return resyncs it to the block it started
+ * with, as if it had just joined — a slot that's run dry reads silence for what's missing, and
+ * one that's filled up drops its oldest sends.
+ *
+ * Joining and leaving are for the message thread (they allocate, and leaving waits for the
+ * return to finish reading). The first to join sets the sample rate, block size and comb
+ * times, and the shared reverb takes its size, damping, width and spread from the return's
+ * parameters. It always runs at the full rate.
+*/
+
+namespace pa::dsp {
+
+class ReverbBus {
+ public:
+    static constexpr int maxSlots = 64;
+
+    ~ReverbBus() {
+        jassert(getNumJoined() == 0);
+    }
+
+    // Join the bus, returns the slot to post to, or -1 if it's full or running at another
+    // sample rate, or with shorter blocks (message thread only)
+    // - the parameters are the reverb's starting point, if this is the first to join
+    int join(uint sampleRate, int maxBlockSize, const Reverb::Parameters& parameters,
+             const array<float, Reverb::maxEarlyCombs>& earlyCombTimes,
+             const array<float, Reverb::maxLateCombs>& lateCombTimes) {
+        if (getNumJoined() == 0) {
+            // (nobody's reading, so the reverb is free to be set up again)
+            latency = jmax(1, maxBlockSize);
+            busSampleRate = sampleRate;
+
+            // (set before preparing, so the smoothers start at their targets)
+            reverb.setCombTimes(earlyCombTimes, lateCombTimes);
+            reverb.setParameters(parameters);
+            reverb.prepare(sampleRate);
+            sum.allocate(latency, true);
+        }
+        else if (sampleRate != busSampleRate || maxBlockSize > latency) {
+            return -1;
+        }
+
+        for (int s = 0; s < maxSlots; s++) {
+            auto& slot = slots[size_t(s)];
+            if (slot.active.load()) continue;
+
+            // room for a few blocks' drift between the posters and the return, after the block of silence
+            slot.fifo.setTotalSize(latency * fifoBlocks + 1);
+            slot.buffer.allocate(latency * fifoBlocks + 1, true);
+            slot.fifo.finishedWrite(latency);
+
+            slot.active.store(true);
+            return s;
+        }
+
+        return -1;
+    }
+
+    // Leave the bus (message thread only, and not while the slot's owner is processing)
+    void leave(int slotIndex) {
+        if (!isPositiveAndBelow(slotIndex, maxSlots)) return;
+
+        auto& slot = slots[size_t(slotIndex)];
+        slot.active.store(false);
+
+        // (once the return isn't rendering, it can't be reading this slot any more)
+        while (rendering.load())
+            Thread::yield();
+
+        slot.buffer.free();
+        slot.fifo.reset();
+    }
+
+    int getNumJoined() const noexcept {
+        int numJoined = 0;
+
+        for (const auto& slot : slots)
+            numJoined += slot.active.load() ? 1 : 0;
+
+        return numJoined;
+    }
+
+    // The delay the shared reverb adds, in samples
+    int getLatencySamples() const noexcept {
+        return latency;
+    }
+
+    // Whether a slot is the one that renders the shared reverb (the lowest one joined)
+    bool isReturn(int slotIndex) const noexcept {
+        for (int s = 0; s < maxSlots; s++)
+            if (slots[size_t(s)].active.load())
+                return s == slotIndex;
+
+        return false;
+    }
+
+    // Post a block of a slot's send (its owner's audio thread only)
+    // - if the return has stopped reading (e.g. it's bypassed), a block that doesn't fit is
+    //   dropped whole, and the return resyncs once it's back
+    void post(int slotIndex, const float* send, int numSamples) {
+        auto& slot = slots[size_t(slotIndex)];
+        int start1, size1, start2, size2;
+
+        if (slot.fifo.getFreeSpace() < numSamples) return;
+
+        slot.fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+        std::copy_n(send, size1, slot.buffer.get() + start1);
+        std::copy_n(send + size1, size2, slot.buffer.get() + start2);
+        slot.fifo.finishedWrite(size1 + size2);
+    }
+
+    // Sum every slot's send from a block ago, run the reverb over it, and add the wet signal
+    // to left and right (the return's audio thread only, see isReturn())
+    void render(float* left, float* right, int numSamples, const Reverb::Parameters& parameters) {
+        // (only while the return changes hands could two be rendering, the second just skips it)
+        if (rendering.exchange(true)) return;
+
+        reverb.setParameters(parameters);
+
+        for (int start = 0; start < numSamples; start += latency) {
+            const int n = jmin(latency, numSamples - start);
+            std::fill_n(sum.get(), n, 0.0f);
+
+            // (always in slot order, so the sum rounds the same way every time)
+            for (auto& slot : slots)
+                if (slot.active.load())
+                    readInto(slot, n);
+
+            reverb.processReturn(sum.get(), left + start, right + start, n);
+        }
+
+        rendering.store(false);
+    }
+
+    // Clear the shared reverb, e.g. when the transport jumps (the return's audio thread only)
+    void clear() {
+        if (rendering.exchange(true)) return;
+
+        reverb.clear();
+        rendering.store(false);
+    }
+
+ private:
+    static constexpr int fifoBlocks = 4;
+
+    struct Slot {
+        std::atomic<bool> active { false };
+        AbstractFifo fifo { 1 };
+        HeapBlock<float> buffer;
+    };
+
+    array<Slot, maxSlots> slots;
+    std::atomic<bool> rendering { false };
+
+    Reverb reverb;
+    HeapBlock<float> sum;
+    uint busSampleRate = 0;
+    int latency = 0;
+
+    // Add a slot's next samples to the sum, resyncing it first if it's fallen behind or run
+    // ahead (see the top)
+    void readInto(Slot& slot, int numSamples) {
+        const int numReady = slot.fifo.getNumReady();
+        int skip = 0;
+
+        if (numReady > latency + numSamples) {
+            // overrun, drop all but the latest block
+            int start1, size1, start2, size2;
+            slot.fifo.prepareToRead(numReady - latency, start1, size1, start2, size2);
+            slot.fifo.finishedRead(size1 + size2);
+        }
+        else if (numReady < latency) {
+            // underrun, what's missing is silence (until it's a block behind again)
+            skip = jmin(numSamples, latency - numReady);
+        }
+
+        int start1, size1, start2, size2;
+        slot.fifo.prepareToRead(numSamples - skip, start1, size1, start2, size2);
+
+        const float* data = slot.buffer.get();
+        float* dest = sum.get() + skip;
+
+        for (int i = 0; i < size1; i++)
+            dest[i] += data[start1 + i];
+
+        for (int i = 0; i < size2; i++)
+            dest[size1 + i] += data[start2 + i];
+
+        slot.fifo.finishedRead(size1 + size2);
+    }
+};
+
+} // end namespace pa::dsp
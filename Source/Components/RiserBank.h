@@ -0,0 +1,577 @@
+#pragma once
+#include "RiserProcessor.h"
+
+// Bank of many independent risers, processed a SIMD register at a time
+// - each lane of a register is one riser (a "voice") with its own amounts and modulation, and
+//   all per-voice state is kept in structure-of-arrays layout, so a whole group of voices moves
+//   through the chain together
+// - the chain, its mappings (through the same tables), the LFO and the denormal flushing are the
+//   same as RiserProcessor's standard order at full quality, and like its filters the biquads
+//   run in double precision — the output is only a rounding error away from RiserProcessor's
+//   (the null tests bound it), as the block kernels and the order of some sums differ
+// - it deliberately has none of RiserProcessor's other options: the other effect orders,
+//   quality levels, multirate or pipelined reverb, the reverb bus and snapshots
+
+class RiserBank {
+ public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+    using Mask = Vec::vMaskType;
+    static constexpr size_t lanes = Vec::size();
+
+    // (the biquads' registers, a few to each float register)
+    using VecD = juce::dsp::SIMDRegister<double>;
+    static constexpr size_t doublesPerVec = lanes / VecD::size();
+    static_assert(doublesPerVec * VecD::size() == lanes);
+
+    // Set where the delay lines' memory comes from — each group of voices allocates its lines as
+    // one block from this resource when preparing (nullptr for the default resource)
+    // - call this before prepare(), or after release()
+    void setMemoryResource(std::pmr::memory_resource* resource) {
+        release();
+        memoryResource = resource != nullptr ? resource : std::pmr::get_default_resource();
+    }
+
+    // Allocates all groups for the given number of voices (not real-time safe)
+    void prepare(uint newSampleRate, size_t newNumVoices) {
+        sampleRate = jmax(1u, newSampleRate);
+        numVoices = newNumVoices;
+        mappingTables = RiserProcessor::getMappingTables(sampleRate);
+
+        voiceAmounts.resize(numVoices, { 0.0f, 0.0f, 0.0f });
+        voiceModulation.resize(numVoices);
+
+        groups.clear();
+        groups.reserve((numVoices + lanes - 1) / lanes);
+
+        for (size_t g = 0; g < (numVoices + lanes - 1) / lanes; g++) {
+            groups.emplace_back(memoryResource);
+            groups.back().prepare(sampleRate);
+        }
+
+        // start every voice at its current settings, rather than ramping to them
+        for (size_t v = 0; v < numVoices; v++) {
+            updateVoice(v, true);
+            groups[v / lanes].setModulation(v % lanes, voiceModulation[v], bpm);
+        }
+    }
+
+    // Frees all voices
+    void release() {
+        groups.clear();
+        groups.shrink_to_fit();
+        voiceAmounts.clear();
+        voiceAmounts.shrink_to_fit();
+        voiceModulation.clear();
+        voiceModulation.shrink_to_fit();
+        mappingTables = nullptr;
+        numVoices = 0;
+    }
+
+    // Set one voice's amounts, the same as RiserProcessor::setParameters()
+    void setParameters(size_t voice, float flangerAmt, float filterAmt, float reverbAmt, float masterAmt) {
+        if (voice >= numVoices) return;
+
+        masterAmt = pa::math::clamp(masterAmt, 0.0f, 1.0f);
+
+        voiceAmounts[voice] = { pa::math::clamp(flangerAmt, 0.0f, 1.0f) * masterAmt,
+                                pa::math::clamp(filterAmt, 0.0f, 1.0f) * masterAmt,
+                                pa::math::clamp(reverbAmt, 0.0f, 1.0f) * masterAmt };
+
+        updateVoice(voice, false);
+    }
+
+    // Set one voice's flanger modulation, the same as RiserProcessor::setModulation()
+    void setModulation(size_t voice, const RiserProcessor::Modulation& newModulation) {
+        if (voice >= numVoices) return;
+
+        auto& m = voiceModulation[voice];
+        m = newModulation;
+        m.depth = pa::math::clamp(m.depth, 0.0f, 1.0f);
+        m.syncBeats = jmax(m.syncBeats, 1.0f / 64.0f);
+
+        groups[voice / lanes].setModulation(voice % lanes, m, bpm);
+    }
+
+    // Pass on the host's tempo and position to every voice, the same as RiserProcessor::setHostTempo()
+    void setHostTempo(double newBpm, double ppqPosition = -1.0) {
+        if (newBpm > 0.0)
+            bpm = newBpm;
+
+        for (size_t v = 0; v < numVoices; v++)
+            groups[v / lanes].setHostTempo(v % lanes, voiceModulation[v], bpm, ppqPosition);
+    }
+
+    // Processes numSamples of every voice in place — left[v]/right[v] are voice v's channels
+    void process(float* const* left, float* const* right, int numSamples) {
+        if (left == nullptr || right == nullptr || numSamples <= 0) return;
+
+        for (size_t g = 0; g < groups.size(); g++) {
+            const size_t firstVoice = g * lanes;
+            const size_t numActive = jmin(lanes, numVoices - firstVoice);
+
+            groups[g].process(left + firstVoice, right + firstVoice, numActive, numSamples);
+        }
+    }
+
+    size_t getNumVoices() const noexcept {
+        return numVoices;
+    }
+
+ private:
+    // Returns the value, or 0 in every lane small enough to be headed for denormals
+    // (see pa::math::flushDenormal())
+    static Vec flushDenormals(Vec value) {
+        const Vec threshold = Vec::expand(pa::math::denormalThreshold);
+        return value & (Vec::greaterThanOrEqual(value, threshold) | Vec::lessThanOrEqual(value, Vec::expand(0.0f) - threshold));
+    }
+
+    // Each lane of a where the mask is set, otherwise b's
+    static Vec select(Mask mask, Vec a, Vec b) {
+        return (a & mask) + (b & ~mask);
+    }
+
+    // A per-lane linear smoother, matching juce::SmoothedValue's linear behaviour
+    // - every lane steps at once, with the lanes that have arrived held at their targets
+    struct Ramp {
+        Vec current = Vec::expand(0.0f), target = Vec::expand(0.0f), step = Vec::expand(0.0f),
+            remaining = Vec::expand(0.0f); // (steps left, in each lane)
+        int stepsToTarget = 0, maxRemaining = 0;
+
+        void reset(double newSampleRate, double rampSeconds) {
+            stepsToTarget = int(std::floor(rampSeconds * newSampleRate));
+            current = target;
+            remaining = Vec::expand(0.0f);
+            maxRemaining = 0;
+        }
+
+        void setTarget(size_t lane, float newTarget, bool snap) {
+            if (!snap && newTarget == target.get(lane)) return;
+
+            target.set(lane, newTarget);
+
+            if (snap || stepsToTarget <= 0) {
+                current.set(lane, newTarget);
+                remaining.set(lane, 0.0f);
+                return;
+            }
+
+            remaining.set(lane, float(stepsToTarget));
+            step.set(lane, (newTarget - current.get(lane)) / float(stepsToTarget));
+            maxRemaining = stepsToTarget;
+        }
+
+        Vec next() {
+            // the common case, nothing is moving
+            if (maxRemaining <= 0) return target;
+
+            maxRemaining--;
+
+            const Vec zero = Vec::expand(0.0f);
+            remaining = Vec::max(remaining - Vec::expand(1.0f), zero);
+            current = select(Vec::greaterThan(remaining, zero), current + step, target);
+
+            return current;
+        }
+    };
+
+    // Biquad with per-lane coefficients, in double precision (as pa::dsp::Filter is — the low
+    // cutoffs' poles are too close to 1 for single precision), a few registers to the lanes
+    struct Biquad {
+        array<VecD, doublesPerVec> a0, a1, a2, b1, b2, dly1, dly2;
+
+        Biquad() {
+            for (size_t r = 0; r < doublesPerVec; r++) {
+                a0[r] = VecD::expand(1.0);
+                a1[r] = a2[r] = b1[r] = b2[r] = dly1[r] = dly2[r] = VecD::expand(0.0);
+            }
+        }
+
+        void setLane(size_t lane, const pa::dsp::Filter::Coefficients& c) {
+            const size_t r = lane / VecD::size(), i = lane % VecD::size();
+
+            a0[r].set(i, c.a0);
+            a1[r].set(i, c.a1);
+            a2[r].set(i, c.a2);
+            b1[r].set(i, c.b1);
+            b2[r].set(i, c.b2);
+        }
+
+        void reset() {
+            for (size_t r = 0; r < doublesPerVec; r++)
+                dly1[r] = dly2[r] = VecD::expand(0.0);
+        }
+
+        // Process n samples of interleaved lanes in place
+        void process(double* data, size_t n) {
+            for (size_t r = 0; r < doublesPerVec; r++) {
+                VecD d1 = dly1[r], d2 = dly2[r];
+
+                for (size_t i = 0; i < n; i++) {
+                    double* x = data + i * lanes + r * VecD::size();
+                    const VecD in = VecD::fromRawArray(x);
+
+                    const VecD out = in * a0[r] + d1;
+                    d1 = in * a1[r] + d2 - b1[r] * out;
+                    d2 = in * a2[r] - b2[r] * out;
+
+                    out.copyToRawArray(x);
+                }
+
+                // (once a chunk is plenty, as in pa::dsp::Filter)
+                dly1[r] = flushDenormals(d1);
+                dly2[r] = flushDenormals(d2);
+            }
+        }
+
+     private:
+        static VecD flushDenormals(VecD value) {
+            const VecD threshold = VecD::expand(double(pa::math::denormalThreshold));
+            return value & (VecD::greaterThanOrEqual(value, threshold) | VecD::lessThanOrEqual(value, VecD::expand(0.0) - threshold));
+        }
+    };
+
+    // Delay line of whole registers, one lane per voice (power-of-2 sized)
+    struct DelayLine {
+        size_t offset = 0, mask = 0;
+    };
+
+    // Up to `lanes` voices, processed together
+    class Group {
+     public:
+        explicit Group(std::pmr::memory_resource* resource) : memory(resource) {}
+
+        void prepare(uint newSampleRate) {
+            sampleRate = newSampleRate;
+            const float rate = float(sampleRate);
+
+            // the flanger's longest delay is 1 / 20 Hz (see RiserProcessor::mapSettings()), and
+            // the modulation lengthens it by up to half
+            size_t total = 0;
+            flangerLine = makeLine(size_t(1.5f * rate / 20.0f) + 2, total);
+
+            // comb lengths include the largest stereo spread the reverb allows
+            for (size_t i = 0; i < numEarly; i++)
+                earlyLines[i] = makeLine(size_t(rate * (RiserProcessor::earlyCombTimes[i] + maxSpread)) + 2, total);
+            for (size_t i = 0; i < numLate; i++)
+                lateLines[i] = makeLine(size_t(rate * (RiserProcessor::lateCombTimes[i] + maxSpread)) + 2, total);
+
+            // one contiguous block, for both channels: [channel][line][sample]
+            memory.assign(total * 2, Vec::expand(0.0f));
+            channelStride = total;
+            writeIndex = 0;
+
+            for (auto& ramp : flangerDelay)
+                ramp.reset(sampleRate, flangerSmoothTime);
+
+            for (auto* ramp : { &damping, &feedback, &dry, &wet1, &wet2 })
+                ramp->reset(sampleRate, reverbSmoothTime);
+
+            for (size_t ch = 0; ch < 2; ch++) {
+                lowpass[ch].reset();
+                highpass[ch].reset();
+            }
+
+            previousValue = {};
+
+            for (auto& lfo : lfos)
+                lfo.prepare(sampleRate);
+        }
+
+        // Set one lane's settings, snapping rather than ramping if asked to
+        void setLane(size_t lane, const RiserProcessor::Settings& s, const pa::dsp::Filter::Coefficients& lp,
+                     const pa::dsp::Filter::Coefficients& hp, bool snap) {
+            // flanger
+            const float feed = pa::math::clamp(s.flanger.feedback, 0.0f, 1.0f);
+            flangerFeedback.set(lane, feed);
+            flangerWet.set(lane, s.flanger.wet);
+            flangerDelay[0].setTarget(lane, flangerDelayTime(s.flanger.freq), snap);
+            flangerDelay[1].setTarget(lane, flangerDelayTime(s.flanger.freq + s.flangerOffset), snap);
+
+            // filters
+            for (size_t ch = 0; ch < 2; ch++) {
+                lowpass[ch].setLane(lane, lp);
+                highpass[ch].setLane(lane, hp);
+            }
+
+            // reverb (the same mappings as pa::dsp::Reverb)
+            const float mix = pa::math::clamp(s.reverb.mix, 0.0f, 1.0f);
+            const float wet = pa::math::expRounder(mix, 0.8f) * 1.55f;
+
+            dry.setTarget(lane, 1.0f - mix, snap);
+            wet1.setTarget(lane, wetGainScale * wet * (1 + s.reverb.width), snap);
+            wet2.setTarget(lane, wetGainScale * wet * (1 - s.reverb.width), snap);
+            damping.setTarget(lane, s.reverb.damping * 0.9f, snap);
+            feedback.setTarget(lane, s.reverb.size * 0.78f + 0.2f, snap);
+
+            // the spread is clamped so hard that every mapped setting lands on the
+            // maximum, so all lanes can share their comb lengths
+            const float spread = pa::math::clamp<float>(s.reverb.spread, 0.0f, 0.01f) / 2;
+            jassert(spread == maxSpread);
+            setCombOffsets(spread);
+        }
+
+        // Set one lane's modulation (already limited, see RiserBank::setModulation())
+        void setModulation(size_t lane, const RiserProcessor::Modulation& m, double bpm) {
+            modulation[lane] = m;
+            lfos[lane].setFrequency(m.sync ? bpm / 60.0 / double(m.syncBeats) : double(m.rate));
+        }
+
+        void setHostTempo(size_t lane, const RiserProcessor::Modulation& m, double bpm, double ppqPosition) {
+            setModulation(lane, m, bpm);
+
+            // lock the phase to the bar while playing
+            if (m.sync && ppqPosition >= 0.0)
+                lfos[lane].setPhase(ppqPosition / double(m.syncBeats));
+        }
+
+        void process(float* const* left, float* const* right, size_t numActive, int numSamples) {
+            alignas(64) float rawL[chunkSize * lanes], rawR[chunkSize * lanes];
+            alignas(64) float modL[chunkSize * lanes], modR[chunkSize * lanes];
+
+            for (int start = 0; start < numSamples; start += int(chunkSize)) {
+                const auto n = size_t(jmin(int(chunkSize), numSamples - start));
+
+                // interleave the voices, one register per sample (unused lanes are silent)
+                std::fill_n(rawL, n * lanes, 0.0f);
+                std::fill_n(rawR, n * lanes, 0.0f);
+
+                for (size_t lane = 0; lane < numActive; lane++) {
+                    for (size_t i = 0; i < n; i++) {
+                        rawL[i * lanes + lane] = left[lane][size_t(start) + i];
+                        rawR[i * lanes + lane] = right[lane][size_t(start) + i];
+                    }
+                }
+
+                // each stage runs over the whole chunk, as in RiserProcessor
+                fillModulation(modL, modR, numActive, n);
+
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t ch = 0; ch < 2; ch++) {
+                        float* x = (ch == 0 ? rawL : rawR) + i * lanes;
+                        const float* mod = (ch == 0 ? modL : modR) + i * lanes;
+
+                        processFlanger(ch, Vec::fromRawArray(x), Vec::fromRawArray(mod)).copyToRawArray(x);
+                    }
+
+                    writeIndex++;
+                }
+
+                for (size_t ch = 0; ch < 2; ch++) {
+                    float* x = ch == 0 ? rawL : rawR;
+
+                    std::copy_n(x, n * lanes, filterData);
+                    lowpass[ch].process(filterData, n);
+                    highpass[ch].process(filterData, n);
+                    std::copy_n(filterData, n * lanes, x);
+                }
+
+                // (the reverb's lines are a chunk behind the flanger's write index)
+                writeIndex -= n;
+
+                for (size_t i = 0; i < n; i++) {
+                    Vec l = Vec::fromRawArray(rawL + i * lanes),
+                        r = Vec::fromRawArray(rawR + i * lanes);
+
+                    processReverb(l, r);
+
+                    l.copyToRawArray(rawL + i * lanes);
+                    r.copyToRawArray(rawR + i * lanes);
+                    writeIndex++;
+                }
+
+                for (size_t lane = 0; lane < numActive; lane++) {
+                    for (size_t i = 0; i < n; i++) {
+                        left[lane][size_t(start) + i] = rawL[i * lanes + lane];
+                        right[lane][size_t(start) + i] = rawR[i * lanes + lane];
+                    }
+                }
+            }
+        }
+
+     private:
+        static constexpr size_t numEarly = 8, numLate = 4, chunkSize = 64;
+        static constexpr float maxSpread = 0.005f, wetGainScale = 1.2f,
+                               preGain = 0.1f / float(numEarly + numLate);
+        // (the flanger's ramp time is a float in CombFilter, which changes its step count)
+        static constexpr float flangerSmoothTime = 0.03f;
+        static constexpr double reverbSmoothTime = 0.05;
+
+        uint sampleRate = 44100;
+
+        // all delay lines share a write index, and each has its own length
+        std::pmr::vector<Vec> memory;
+        size_t channelStride = 0, writeIndex = 0;
+        DelayLine flangerLine;
+        array<DelayLine, numEarly> earlyLines;
+        array<DelayLine, numLate> lateLines;
+
+        // read offsets, in samples — [channel][comb]
+        array<array<size_t, numEarly>, 2> earlyOffsets {};
+        array<array<size_t, numLate>, 2> lateOffsets {};
+        float combSpread = -1.0f;
+
+        // flanger, and its modulation
+        array<Ramp, 2> flangerDelay;
+        Vec flangerFeedback = Vec::expand(0.0f), flangerWet = Vec::expand(0.0f);
+        array<pa::dsp::LFO, lanes> lfos;
+        array<RiserProcessor::Modulation, lanes> modulation {};
+
+        // filters
+        array<Biquad, 2> lowpass, highpass;
+
+        // reverb
+        Ramp damping, feedback, dry, wet1, wet2;
+        array<array<Vec, numEarly>, 2> previousValue {};
+
+        // a chunk of one channel, in double precision for the biquads
+        alignas(64) double filterData[chunkSize * lanes];
+
+        static DelayLine makeLine(size_t minLength, size_t& total) {
+            const auto length = size_t(nextPowerOfTwo(int(minLength)));
+            DelayLine line { total, length - 1 };
+            total += length;
+            return line;
+        }
+
+        static float flangerDelayTime(float freq) {
+            return std::abs(1.0f / freq);
+        }
+
+        void setCombOffsets(float spread) {
+            if (spread == combSpread) return;
+
+            combSpread = spread;
+            const float rate = float(sampleRate);
+
+            for (size_t ch = 0; ch < 2; ch++) {
+                const float chSpread = (ch == 0) ? spread : -spread;
+
+                for (size_t i = 0; i < numEarly; i++)
+                    earlyOffsets[ch][i] = size_t(rate * pa::math::clamp(RiserProcessor::earlyCombTimes[i] + chSpread, 0.001f, 1.0f));
+                for (size_t i = 0; i < numLate; i++)
+                    lateOffsets[ch][i] = size_t(rate * pa::math::clamp(RiserProcessor::lateCombTimes[i] + chSpread, 0.001f, 1.0f));
+            }
+        }
+
+        // Fill a chunk of interleaved delay time multipliers from each lane's LFO, as in
+        // RiserProcessor::processFlanger() (1 in the lanes without any modulation)
+        void fillModulation(float* modL, float* modR, size_t numActive, size_t n) {
+            std::fill_n(modL, n * lanes, 1.0f);
+            std::fill_n(modR, n * lanes, 1.0f);
+
+            float laneL[chunkSize], laneR[chunkSize];
+
+            for (size_t lane = 0; lane < numActive; lane++) {
+                const auto& m = modulation[lane];
+                if (m.depth <= 0.0f) continue;
+
+                lfos[lane].process(laneL, laneR, int(n), m.stereoPhase);
+                const float scale = m.depth * 0.5f;
+
+                for (size_t i = 0; i < n; i++) {
+                    modL[i * lanes + lane] = 1.0f + scale * laneL[i];
+                    modR[i * lanes + lane] = 1.0f + scale * laneR[i];
+                }
+            }
+        }
+
+        Vec* line(size_t ch, const DelayLine& l) {
+            return memory.data() + ch * channelStride + l.offset;
+        }
+
+        // Reads each lane at its own (fractional) delay, linearly interpolated
+        // - the offsets and interpolation are worked out for every lane at once, only the loads
+        //   themselves go lane by lane (straight from memory, rather than through the registers)
+        Vec readFlanger(size_t ch, Vec delaySamples) {
+            const Vec whole = Vec::truncate(delaySamples), t = delaySamples - whole;
+            const float* buffer = reinterpret_cast<const float*>(line(ch, flangerLine));
+            const size_t mask = flangerLine.mask;
+
+            alignas(64) float offsets[lanes], a[lanes], b[lanes];
+            whole.copyToRawArray(offsets);
+
+            for (size_t lane = 0; lane < lanes; lane++) {
+                const size_t index = (writeIndex - size_t(offsets[lane])) & mask;
+
+                a[lane] = buffer[index * lanes + lane];
+                b[lane] = buffer[((index - 1) & mask) * lanes + lane];
+            }
+
+            const Vec va = Vec::fromRawArray(a);
+            return va + t * (Vec::fromRawArray(b) - va);
+        }
+
+        // One sample of a channel's flanger
+        Vec processFlanger(size_t ch, Vec in, Vec mod) {
+            const Vec delayed = readFlanger(ch, Vec::expand(float(sampleRate)) * flangerDelay[ch].next() * mod);
+
+            line(ch, flangerLine)[writeIndex & flangerLine.mask] = flushDenormals(in + delayed * flangerFeedback);
+
+            return in + delayed * flangerWet;
+        }
+
+        // One sample of the reverb (damped combs in parallel, then the late combs in series)
+        // and the hard-clip
+        void processReverb(Vec& left, Vec& right) {
+            const Vec input = (left + right) * Vec::expand(preGain);
+            const Vec damp = damping.next(), feed = feedback.next();
+            const Vec half = Vec::expand(0.5f);
+            Vec out[2] = { Vec::expand(0.0f), Vec::expand(0.0f) };
+
+            for (size_t ch = 0; ch < 2; ch++) {
+                for (size_t i = 0; i < numEarly; i++) {
+                    Vec* buffer = line(ch, earlyLines[i]);
+                    const auto mask = earlyLines[i].mask;
+                    const Vec delayed = buffer[(writeIndex - earlyOffsets[ch][i]) & mask];
+
+                    auto& prev = previousValue[ch][i];
+                    prev = flushDenormals(delayed + damp * (prev - delayed));
+
+                    buffer[writeIndex & mask] = flushDenormals(input + prev * feed);
+                    out[ch] += delayed;
+                }
+
+                for (size_t i = 0; i < numLate; i++) {
+                    Vec* buffer = line(ch, lateLines[i]);
+                    const auto mask = lateLines[i].mask;
+                    const Vec delayed = buffer[(writeIndex - lateOffsets[ch][i]) & mask];
+
+                    buffer[writeIndex & mask] = flushDenormals(out[ch] + delayed * half);
+                    out[ch] = delayed - out[ch];
+                }
+            }
+
+            const Vec d = dry.next(), w1 = wet1.next(), w2 = wet2.next();
+            const Vec ceiling = Vec::expand(RiserProcessor::clipCeiling);
+
+            const Vec newLeft  = d * left  + w1 * out[0] + w2 * out[1],
+                      newRight = d * right + w1 * out[1] + w2 * out[0];
+
+            // hard-clip, as at the end of RiserProcessor's chain
+            left  = Vec::max(Vec::min(newLeft, ceiling), Vec::expand(0.0f) - ceiling);
+            right = Vec::max(Vec::min(newRight, ceiling), Vec::expand(0.0f) - ceiling);
+        }
+    };
+
+    uint sampleRate = 44100;
+    size_t numVoices = 0;
+    double bpm = 120.0;
+    std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource();
+    std::shared_ptr<const RiserProcessor::MappingTables> mappingTables; // (only once prepared)
+
+    vector<array<float, 3>> voiceAmounts; // master-scaled flanger, filter and reverb amounts
+    vector<RiserProcessor::Modulation> voiceModulation;
+    vector<Group> groups;
+
+    // Map a voice's amounts through the tables, as RiserProcessor does once prepared
+    void updateVoice(size_t voice, bool snap) {
+        const auto& amounts = voiceAmounts[voice];
+        auto s = RiserProcessor::defaultSettings();
+        RiserProcessor::lookupSettings(s, *mappingTables, amounts[0], amounts[1], amounts[2]);
+
+        const auto c = mappingTables->filterCoefficients.lookup(double(amounts[1]));
+
+        groups[voice / lanes].setLane(voice % lanes, s, { c[0], c[1], c[2], c[3], c[4] },
+                                      { c[5], c[6], c[7], c[8], c[9] }, snap);
+    }
+};
@@ -1,61 +1,202 @@
 #pragma once
+#include <map>
+#include <memory>
 #include "pa.h"
 #include "CombFilter.h"
 #include "Filter.h"
 #include "Reverb.h"
+#include "LFO.h"
+#include "LookupTable.h"
+#include "StageChain.h"
+#include "Pipeline.h"
+#include "ReverbBus.h"
+#include "Trace.h"
 
 class RiserProcessor {
  public:
-    RiserProcessor() {
-        // initialise parameter objects
-        flangerParams.freq = 3000.0f;
-        flangerParams.feedback = 0.5f;
-        flangerParams.wet = 0.0f;
-        flangerParams.interpType = pa::dsp::linearInterp;
+    // All the processors' parameter objects, as mapped from the amounts
+    struct Settings {
+        pa::dsp::CombFilter::Parameters flanger;
+        pa::dsp::Filter::Parameters lowpass, highpass;
+        pa::dsp::Reverb::Parameters reverb;
+
+        // frequency offset for the right channel's flanger
+        float flangerOffset = 0.0f;
+    };
+
+    // Flanger delay modulation
+    struct Modulation {
+        float rate = 0.5f,          // Hz, when not synced
+              depth = 0.0f,         // 0 - 1, where 1 sweeps the delay by +/- half its time
+              stereoPhase = 0.25f;  // right channel's phase offset, in cycles
+        bool sync = false;          // follow the host tempo instead of the rate
+        float syncBeats = 4.0f;     // cycle length when synced, in beats
+    };
+
+    // The order of the effects (the hard-clip always comes last)
+    enum class Order {
+        standard,       // flanger -> lowpass -> highpass -> reverb
+        filteredWash,   // flanger -> reverb -> lowpass -> highpass, so the filters close over the tail too
+        flangedWash     // reverb -> flanger -> lowpass -> highpass, so the flanger sweeps the tail
+    };
+
+    static constexpr int numOrders = 3;
+
+    // the lowest quality level (see setQualityLevel())
+    static constexpr int maxQualityLevel = 2;
+
+    // Tables of mapSettings() and the filters' coefficients, so an amount change only costs a few
+    // interpolated lookups — shared by every instance at the same sample rate (see getMappingTables())
+    struct MappingTables {
+        // (the coefficients change fastest, around cutoffs near nyquist, so they get a finer table)
+        static constexpr int numIntervals = 1024, numCoefficientIntervals = 2048;
+
+        pa::dsp::LookupTable<float, 4> flanger;             // wet, freq, feedback, right channel offset
+        pa::dsp::LookupTable<float, 4> filters;             // lowpass cutoff, q, highpass cutoff, q
+        pa::dsp::LookupTable<double, 10> filterCoefficients; // lowpass a0, a1, a2, b1, b2, then highpass's
+        pa::dsp::LookupTable<float, 4> reverb;              // mix, size, width, spread
+
+        explicit MappingTables(uint sampleRate) {
+            const auto mapped = [](float flangerAmt, float filterAmt, float reverbAmt) {
+                auto s = defaultSettings();
+                mapSettings(s, flangerAmt, filterAmt, reverbAmt);
+                return s;
+            };
+
+            flanger.generate(numIntervals, [&](float x) {
+                const auto s = mapped(x, 0.0f, 0.0f);
+                return array<float, 4> { s.flanger.wet, s.flanger.freq, s.flanger.feedback, s.flangerOffset };
+            });
+
+            filters.generate(numIntervals, [&](float x) {
+                const auto s = mapped(0.0f, x, 0.0f);
+                return array<float, 4> { float(s.lowpass.cutoff), float(s.lowpass.q),
+                                         float(s.highpass.cutoff), float(s.highpass.q) };
+            });
+
+            filterCoefficients.generate(numCoefficientIntervals, [&](double x) {
+                const auto s = mapped(0.0f, float(x), 0.0f);
+                const auto lp = pa::dsp::Filter::calculateCoefficients(s.lowpass, sampleRate),
+                           hp = pa::dsp::Filter::calculateCoefficients(s.highpass, sampleRate);
+                return array<double, 10> { lp.a0, lp.a1, lp.a2, lp.b1, lp.b2, hp.a0, hp.a1, hp.a2, hp.b1, hp.b2 };
+            });
+
+            reverb.generate(numIntervals, [&](float x) {
+                const auto s = mapped(0.0f, 0.0f, x);
+                return array<float, 4> { s.reverb.mix, s.reverb.size, s.reverb.width, s.reverb.spread };
+            });
+        }
+    };
 
-        //  //  //  //  //
+    // reverb comb times, in seconds
+    static constexpr array<float, 8> earlyCombTimes { 0.0053f, 0.0134f, 0.0229f, 0.030f,
+                                                      0.0092f, 0.0158f, 0.0397f, 0.0184f };
+    static constexpr array<float, 4> lateCombTimes { 0.0111f, 0.0175f, 0.0076f, 0.0152f };
 
-        lowpassParams.enabled = true;
-        lowpassParams.q = 0.5f;
-        lowpassParams.cutoff = 20000.0f;
-        lowpassParams.type = pa::dsp::Filter::lowpass;
+    RiserProcessor() {
+        // (set in one go, so the combs are only updated once)
+        reverb.setCombTimes(earlyCombTimes, lateCombTimes);
 
-        highpassParams.enabled = true;
-        highpassParams.q = M_SQRT1_2;
-        highpassParams.cutoff = 10.0f;
-        highpassParams.type = pa::dsp::Filter::highpass;
+        // every buffer comes from the arena (see setMemoryResource())
+        for (auto& f : flanger)
+            f.setMemoryResource(&arena);
 
-        //  //  //  //  //
+        reverb.setMemoryResource(&arena);
+        reverbPipeline.setMemoryResource(&arena);
+    }
 
-        reverbParams.width = 1.0f;
-        reverbParams.damping = 0.6f;
-        reverbParams.mix = 0.0f;
-        reverbParams.size = 0.2f;
-        reverbParams.spread = 6.5f;
+    ~RiserProcessor() {
+        leaveReverbBus();
+    }
 
-        vector<float> earlyTimes { 0.0053f, 0.0134f, 0.0229f, 0.030f, 0.0092f, 0.0158f, 0.0397f, 0.0184f };
-        vector<float> lateTimes { 0.0111f, 0.0175f, 0.0076f, 0.0152f };
+    // Set where the processor's memory comes from — its buffers are allocated as one contiguous
+    // block from this resource when preparing (nullptr for the default resource)
+    // - e.g. to place every instance in an arena allocated up front
+    // - call this before prepare(), or after release()
+    void setMemoryResource(std::pmr::memory_resource* resource) {
+        jassert(!prepared);
 
-        for (uint i = 0; i < 8; i++) {
-            reverb.setEarlyCombTime(earlyTimes[i], i);
+        releaseBuffers();
+        arena.setUpstream(resource);
+        memoryLayout = {};
+    }
 
-            if (i < 4)
-                reverb.setLateCombTime(lateTimes[i], i);
-        }
+    // The size of the processor's block of memory, once prepared (see setMemoryResource())
+    size_t getMemorySize() const noexcept {
+        return arena.getCapacity();
     }
 
-    void prepare(uint sampleRate) {
-        // prepare the processors for playback
-        reverb.prepare(sampleRate);
+    // Allocates all buffers, as one block (see setMemoryResource()) — these are reused if the
+    // sample rate, reverb rate and block size haven't changed
+    // - the maximum block size is only used as the pipelined reverb's block (and so its latency)
+    void prepare(uint sampleRate, int maxBlockSize = 512) {
+        // pick the block kernels for this CPU now, rather than on the audio thread
+        pa::dsp::kernels::get();
+
+        // (the reverb can't be reallocated under the helper thread, and the bus's rate may not fit any more)
+        reverbPipeline.stop();
+        leaveReverbBus();
+        reserveMemory(sampleRate, maxBlockSize);
 
         for (size_t i = 0; i < 2; i++) {
-            flanger[i].prepare(sampleRate);
             lowpass[i].prepare(sampleRate);
             highpass[i].prepare(sampleRate);
         }
 
-        // map the correct values before playback too
+        mappingTables = getMappingTables(sampleRate);
+
+        // map the correct values before playback too, so the delay lines and
+        // smoothed values below start out at their targets rather than ramping
         calculateValues();
+
+        // prepare the processors for playback
+        reverb.prepare(sampleRate);
+        preparedSampleRate = sampleRate;
+
+        for (auto& f : flanger)
+            f.prepare(sampleRate);
+
+        lfo.prepare(sampleRate);
+        updateLfoFrequency();
+
+        preparedBlockSize = maxBlockSize;
+        prepared = true;
+
+        joinReverbBus();
+
+        if (reverbPipelined && usesOwnReverb())
+            reverbPipeline.start(preparedBlockSize, preparedSampleRate);
+    }
+
+    // Frees all buffers, e.g. while the plugin is suspended
+    void release() {
+        prepared = false;
+
+        leaveReverbBus();
+        releaseBuffers();
+        arena.reset(0);
+        memoryLayout = {};
+    }
+
+    // Clears all delay lines and filter states, without reallocating anything
+    // - this is constant time (the delay lines aren't zeroed, see RingBuffer), so it's fine on
+    //   the audio thread, e.g. when the transport jumps
+    void reset() {
+        for (size_t i = 0; i < 2; i++) {
+            flanger[i].clear();
+            lowpass[i].reset();
+            highpass[i].reset();
+        }
+
+        if (reverbPipeline.isRunning())
+            reverbPipeline.clear();
+
+        // (the return clears the shared reverb, as every instance sees the same transport)
+        if (isOnReverbBus() && reverbBus->isReturn(busSlot))
+            reverbBus->clear();
+
+        reverb.clear();
+        lfo.setPhase(0.0);
     }
 
     void setParameters(const float& newDoublerAmount, const float& newFilterAmount,
@@ -72,82 +213,685 @@ class RiserProcessor {
         calculateValues();
     }
 
-    // Processes a block of samples, i.e. the current buffer
-    // comb -> lowpass -> highpass -> reverb (in series)
+    // Run the reverb's combs at a reduced rate at high sample rates (see Reverb::setMultirate())
+    // - this reallocates (and clears) the processor, so it must not be called while processing
+    void setReverbMultirate(bool shouldBeMultirate) {
+        if (shouldBeMultirate == reverb.isMultirate()) return;
+
+        reverbPipeline.stop();
+        reverb.setMultirate(shouldBeMultirate);
+
+        // (the reverb's buffers change size, so the whole block is laid out again)
+        if (prepared)
+            prepare(preparedSampleRate, preparedBlockSize);
+    }
+
+    bool isReverbMultirate() const noexcept {
+        return reverb.isMultirate();
+    }
+
+    // Run the reverb on a helper thread, a block behind the rest of the chain (see Pipeline.h),
+    // so it runs in parallel with the next block's flanger and filters
+    // - this adds the maximum block size given to prepare() as latency (see getLatencySamples())
+    // - this starts or stops a thread, so it must not be called while processing
+    void setReverbPipelined(bool shouldBePipelined) {
+        if (shouldBePipelined == reverbPipelined) return;
+
+        reverbPipelined = shouldBePipelined;
+
+        if (!reverbPipelined)
+            reverbPipeline.stop();
+        else if (prepared && usesOwnReverb())
+            reverbPipeline.start(preparedBlockSize, preparedSampleRate);
+
+        // (the reverb's parameters aren't passed on while it's pipelined, so catch up)
+        if (!reverbPipeline.isRunning())
+            reverb.setParameters(settings.reverb);
+    }
+
+    bool isReverbPipelined() const noexcept {
+        return reverbPipelined;
+    }
+
+    // The processing delay, in samples (only the pipelined reverb has any)
+    int getLatencySamples() const noexcept {
+        return reverbPipeline.getLatencySamples();
+    }
+
+    // Share one reverb with other processors through a bus (see ReverbBus.h), or nullptr to go
+    // back to this processor's own — on the bus, its reverb only makes the send and scales the
+    // dry signal, and the pipelining option is ignored
+    // - the bus is joined when prepared, and it can turn the processor away (e.g. it's running at
+    //   another sample rate), in which case it uses its own reverb, see isOnReverbBus()
+    // - without joining, the processor never takes a slot of its own, but waits to be handed one
+    //   by another processor on the bus (a shadow, see fadeTo()) — it doesn't pipeline meanwhile
+    // - this joins or leaves the bus, so it must not be called while processing
+    void setReverbBus(pa::dsp::ReverbBus* newBus, bool shouldJoin = true) {
+        if (newBus == reverbBus && shouldJoin == joinsReverbBus) return;
+
+        leaveReverbBus();
+        reverbBus = newBus;
+        joinsReverbBus = shouldJoin;
+
+        if (prepared) {
+            joinReverbBus();
+
+            if (reverbPipelined && usesOwnReverb())
+                reverbPipeline.start(preparedBlockSize, preparedSampleRate);
+        }
+    }
+
+    pa::dsp::ReverbBus* getReverbBus() const noexcept {
+        return reverbBus;
+    }
+
+    bool isOnReverbBus() const noexcept {
+        return busSlot >= 0;
+    }
+
+    // Share this processor's bus slot with the one it's being crossfaded to (see ShadowSwap.h),
+    // for the next chunk of the crossfade, at most fadeChunkSize samples — the pair only ever
+    // holds the one slot, so the shared reverb stays with it, and gets their sends as one
+    // - process this processor over the chunk, then the other: this one renders the shared
+    //   reverb (if it's the return) and both add it, and the other posts both sends, each scaled
+    //   by its gain for the crossfade
+    // - the other has to be waiting for a slot on the same bus (see setReverbBus()), otherwise
+    //   each carries on as it is (audio thread only)
+    void fadeTo(RiserProcessor& to, const float* outGains, const float* inGains) noexcept {
+        busFade = {};
+        to.busFade = {};
+
+        if (!isOnReverbBus() || !to.isWaitingForReverbBus(reverbBus)) return;
+
+        busFade = { &to, outGains, true };
+        to.busFade = { this, inGains, false };
+    }
+
+    // Hand this processor's bus slot over to the one it's been crossfaded to, at the end of the
+    // crossfade, after which this one waits for a slot instead (cheap, so fine on the audio thread)
+    // - if there's no slot to hand over, the other carries on with its own reverb, as if the bus
+    //   had turned it away
+    void handOverTo(RiserProcessor& to) noexcept {
+        const bool waiting = to.isWaitingForReverbBus(reverbBus);
+
+        busFade = {};
+        to.busFade = {};
+        to.joinsReverbBus = true;
+
+        if (!isOnReverbBus() || !waiting) return;
+
+        to.busSlot = busSlot;
+        busSlot = -1;
+        joinsReverbBus = false;
+    }
+
+                // Snapshots
+    // Write the processor's complete state — amounts, modulation, every delay line, filter
+    // and smoother — so that processing can later resume from exactly this point
+    // - e.g. taken every few seconds of an offline render, to re-render from the last one
+    //   before an edit rather than from the start
+    // - a snapshot is only readable by the same build, into a processor prepared at the same
+    //   sample rate and reverb rate (it's the raw state, not a preset)
+    // - not while the reverb is pipelined, as the helper thread owns the reverb's state, or on
+    //   a bus, as the reverb's state is shared
+    void writeSnapshot(OutputStream& stream) const {
+        jassert(prepared && !reverbPipeline.isRunning() && !isOnReverbBus());
+
+        pa::state::write(stream, snapshotMagic);
+        pa::state::write(stream, snapshotVersion);
+        pa::state::write(stream, preparedSampleRate);
+
+        for (auto amount : { masterAmount, flangerAmount, filterAmount, reverbAmount })
+            pa::state::write(stream, amount);
+
+        pa::state::write(stream, modulation);
+        pa::state::write(stream, bpm);
+        pa::state::write(stream, order);
+        pa::state::write(stream, qualityLevel);
+        lfo.writeState(stream);
+
+        for (size_t i = 0; i < 2; i++) {
+            flanger[i].writeState(stream);
+            lowpass[i].writeState(stream);
+            highpass[i].writeState(stream);
+        }
+
+        reverb.writeState(stream);
+    }
+
+    // Call visit() with every value the processor feeds back — the flanger lines, the filters'
+    // state and the reverb's combs — e.g. for tests that check none of it goes denormal
+    // - like writeSnapshot(), not while the reverb is pipelined or on a bus
+    template <typename Visitor>
+    void visitState(Visitor&& visit) const {
+        for (size_t i = 0; i < 2; i++) {
+            flanger[i].visitState(visit);
+            lowpass[i].visitState(visit);
+            highpass[i].visitState(visit);
+        }
+
+        reverb.visitState(visit);
+    }
+
+    // Restore a state written by writeSnapshot(), returns false if it can't be (and then
+    // leaves the processor reset)
+    bool readSnapshot(InputStream& stream) {
+        int magic = 0, version = 0;
+        uint sampleRate = 0;
+
+        if (!prepared || reverbPipeline.isRunning() || isOnReverbBus()
+            || !pa::state::read(stream, magic) || magic != snapshotMagic
+            || !pa::state::read(stream, version) || version != snapshotVersion
+            || !pa::state::read(stream, sampleRate) || sampleRate != preparedSampleRate)
+            return false;
+
+        // the parameters go first, as setting them moves the smoothers' targets
+        bool valid = true;
+
+        for (auto* amount : { &masterAmount, &flangerAmount, &filterAmount, &reverbAmount })
+            valid = valid && pa::state::read(stream, *amount);
+
+        valid = valid && pa::state::read(stream, modulation) && pa::state::read(stream, bpm)
+                      && pa::state::read(stream, order) && int(order) >= 0 && int(order) < numOrders
+                      && pa::state::read(stream, qualityLevel) && isPositiveAndNotGreaterThan(qualityLevel, maxQualityLevel);
+
+        if (valid) {
+            calculateValues();
+            updateLfoFrequency();
+        }
+
+        valid = valid && lfo.readState(stream);
+
+        for (size_t i = 0; i < 2; i++)
+            valid = valid && flanger[i].readState(stream) && lowpass[i].readState(stream) && highpass[i].readState(stream);
+
+        valid = valid && reverb.readState(stream);
+
+        if (!valid) {
+            order = Order::standard;
+            qualityLevel = 0;
+            calculateValues();
+            reset();
+        }
+
+        return valid;
+    }
+
+    // How long the output rings on after the input stops (to -60 dB), with the current amounts
+    double getTailLengthSeconds() const {
+        const auto& f = settings.flanger;
+        double flangerTail = 0.0;
+
+        // the longest flanger loop is its lowest frequency, lengthened by the modulation
+        if (f.wet > 0.0f && f.feedback > 0.0f)
+            flangerTail = (1.0 + 0.5 * modulation.depth) / f.freq * std::log(0.001) / std::log(f.feedback);
+
+        return flangerTail + reverb.getTailLengthSeconds();
+    }
+
+    // Set the flanger's modulation (cheap to call every block)
+    void setModulation(const Modulation& newModulation) {
+        modulation = newModulation;
+        modulation.depth = pa::math::clamp(modulation.depth, 0.0f, 1.0f);
+        modulation.syncBeats = jmax(modulation.syncBeats, 1.0f / 64.0f);
+
+        updateLfoFrequency();
+    }
+
+    // Move the modulation to where it would be numSamples after prepare(), with no host position
+    // (e.g. to start rendering part way through a file)
+    void setModulationPosition(int64 numSamples) {
+        lfo.setPosition(numSamples);
+    }
+
+    // Trade some quality for time under CPU pressure (see CpuGovernor.h), from 0 (full quality)
+    // to maxQualityLevel — 1 runs half the reverb's combs, 2 also reads the flanger's delay
+    // without interpolation
+    // - cheap to call every block, and each step fades over a moment rather than switching (see
+    //   Reverb::startCombFade() and CombFilter::setParameters())
+    void setQualityLevel(int newLevel) {
+        newLevel = jlimit(0, maxQualityLevel, newLevel);
+        if (newLevel == qualityLevel) return;
+
+        qualityLevel = newLevel;
+        calculateValues();
+    }
+
+    int getQualityLevel() const noexcept {
+        return qualityLevel;
+    }
+
+    // Set the order of the effects (cheap to call every block, but it's a hard switch, so
+    // changing it while there's a signal can click)
+    void setOrder(Order newOrder) {
+        order = newOrder;
+    }
+
+    Order getOrder() const noexcept {
+        return order;
+    }
+
+    // Pass on the host's tempo and position, used when the modulation is synced
+    // - ppqPosition < 0 means the position is unknown (e.g. the transport is stopped)
+    void setHostTempo(double newBpm, double ppqPosition = -1.0) {
+        if (newBpm > 0.0 && newBpm != bpm) {
+            bpm = newBpm;
+            updateLfoFrequency();
+        }
+
+        // lock the phase to the bar while playing
+        if (modulation.sync && ppqPosition >= 0.0)
+            lfo.setPhase(ppqPosition / double(modulation.syncBeats));
+    }
+
+    // Processes a block of samples, i.e. the current buffer, through the chain for the order
     void process(float* left, float* right, const int& numSamples) {
-        if (left == nullptr || right == nullptr || numSamples <= 0) return;
+        if (left == nullptr || right == nullptr || numSamples <= 0 || !prepared) return;
 
-        // process loop
-        for (int i = 0; i < numSamples; i++) {
-            float outL = left[i], outR = right[i];
+        switch (order) {
+            case Order::standard:     StandardChain::process(*this, left, right, numSamples); break;
+            case Order::filteredWash: FilteredWashChain::process(*this, left, right, numSamples); break;
+            case Order::flangedWash:  FlangedWashChain::process(*this, left, right, numSamples); break;
+        }
+    }
+
+    // The parameter objects before any amounts are mapped
+    static Settings defaultSettings() {
+        Settings s;
+
+        // initialise parameter objects
+        s.flanger.freq = 3000.0f;
+        s.flanger.feedback = 0.5f;
+        s.flanger.wet = 0.0f;
+        s.flanger.interpType = pa::dsp::linearInterp;
 
-            outL = flanger[0].process(&outL);
-            outR = flanger[1].process(&outR);
+        //  //  //  //  //
+
+        s.lowpass.enabled = true;
+        s.lowpass.q = 0.5f;
+        s.lowpass.cutoff = 20000.0f;
+        s.lowpass.type = pa::dsp::Filter::lowpass;
 
-            outL = lowpass[0].process(&outL);
-            outR = lowpass[1].process(&outR);
+        s.highpass.enabled = true;
+        s.highpass.q = M_SQRT1_2;
+        s.highpass.cutoff = 10.0f;
+        s.highpass.type = pa::dsp::Filter::highpass;
+
+        //  //  //  //  //
 
-            outL = highpass[0].process(&outL);
-            outR = highpass[1].process(&outR);
+        s.reverb.width = 1.0f;
+        s.reverb.damping = 0.6f;
+        s.reverb.mix = 0.0f;
+        s.reverb.size = 0.2f;
+        s.reverb.spread = 6.5f;
 
-            reverb.process(&outL, &outR);
+        return s;
+    }
+
+    // Map the (master-scaled) amounts onto the parameter objects
+    static void mapSettings(Settings& s, float flangerAmt, float filterAmt, float reverbAmt) {
+        // flanger — map the wet, frequency, feedback
+        s.flanger.wet      = mapValue(pa::math::expRounder(flangerAmt, 0.3f), 0, 0.75f);
+        s.flanger.freq     = mapValue(flangerAmt, 20.0f, 280.0f);
+        s.flanger.feedback = mapValue(flangerAmt, 0.0f, 0.55f);
+        s.flangerOffset    = 7.0f * pa::math::expRounder(flangerAmt, -0.4f);
 
-            // hard-clip for protection, intended for development only
-            constexpr float ceil = 1.2f;
-            pa::math::setClamp(&outL, -ceil, ceil);
-            pa::math::setClamp(&outR, -ceil, ceil);
+        // filters — map the cutoff and q for both filters
+        s.lowpass.cutoff  = mapValue(pa::math::expRounder(filterAmt, 0.3f), 20000.0f, 4000.0f);
+        s.lowpass.q       = mapValue(pa::math::expRounder(filterAmt, -0.6f), 0.5f, 0.85f);
+        s.highpass.cutoff = mapValue(pa::math::expRounder(filterAmt, -0.3f), 10.0f, 200.0f);
+        s.highpass.q      = mapValue(pa::math::expRounder(filterAmt, -0.5f), static_cast<float>(M_SQRT1_2), 1.0f);
+
+        // reverb — map the mix, size, width and stereo spread
+        s.reverb.mix    = mapValue(reverbAmt, 0.0f, 0.75f);
+        s.reverb.size   = mapValue(reverbAmt, 0.01f, 0.45f);
+        s.reverb.width  = mapValue(reverbAmt, 1.0f, 0.6f);
+        s.reverb.spread = mapValue(pa::math::expRounder(reverbAmt, 0.3f), 0.5f, 1.5f);
+    }
+
+    // The same as mapSettings(), but looked up in the tables (to within about -90 dB of each value's range)
+    static void lookupSettings(Settings& s, const MappingTables& tables, float flangerAmt, float filterAmt, float reverbAmt) {
+        const auto f = tables.flanger.lookup(flangerAmt);
+        s.flanger.wet      = f[0];
+        s.flanger.freq     = f[1];
+        s.flanger.feedback = f[2];
+        s.flangerOffset    = f[3];
+
+        const auto p = tables.filters.lookup(filterAmt);
+        s.lowpass.cutoff  = p[0];
+        s.lowpass.q       = p[1];
+        s.highpass.cutoff = p[2];
+        s.highpass.q      = p[3];
+
+        const auto r = tables.reverb.lookup(reverbAmt);
+        s.reverb.mix    = r[0];
+        s.reverb.size   = r[1];
+        s.reverb.width  = r[2];
+        s.reverb.spread = r[3];
+    }
 
-            left[i] = outL;
-            right[i] = outR;
+    // Returns the tables for a sample rate, generating them if no other instance is using them
+    // - this allocates, so call it when preparing rather than on the audio thread
+    static std::shared_ptr<const MappingTables> getMappingTables(uint sampleRate) {
+        static CriticalSection lock;
+        static std::map<uint, std::weak_ptr<const MappingTables>> cache;
+
+        const ScopedLock sl(lock);
+        auto& entry = cache[sampleRate];
+        auto tables = entry.lock();
+
+        if (tables == nullptr) {
+            tables = std::make_shared<const MappingTables>(sampleRate);
+            entry = tables;
         }
+
+        return tables;
     }
 
+    // ceiling of the protective hard-clip at the end of the chain
+    static constexpr float clipCeiling = 1.2f;
+
+    static constexpr int snapshotMagic = 0x7053524f, // "ORSp"
+                         snapshotVersion = 5;
+
+    // the longest chunk of a crossfade on a reverb bus (see fadeTo())
+    static constexpr int fadeChunkSize = 256;
+
  private:
+                // Stages
+    // (see StageChain.h — the flanger and filters run a block at a time, so they can use the block kernels)
+    struct FlangerStage {
+        static constexpr const char* name = "flanger";
+        static void process(RiserProcessor& p, float* left, float* right, int numSamples) {
+            p.processFlanger(left, right, numSamples);
+        }
+    };
+
+    struct LowpassStage {
+        static constexpr const char* name = "lowpass";
+        static void process(RiserProcessor& p, float* left, float* right, int numSamples) {
+            p.lowpass[0].process(left, numSamples);
+            p.lowpass[1].process(right, numSamples);
+        }
+    };
+
+    struct HighpassStage {
+        static constexpr const char* name = "highpass";
+        static void process(RiserProcessor& p, float* left, float* right, int numSamples) {
+            p.highpass[0].process(left, numSamples);
+            p.highpass[1].process(right, numSamples);
+        }
+    };
+
+    struct ReverbStage {
+        static constexpr const char* name = "reverb";
+        static void process(RiserProcessor& p, float* left, float* right, int numSamples) {
+            if (p.isOnReverbBus() || p.busFade.partner != nullptr) {
+                p.processReverbBus(left, right, numSamples);
+                return;
+            }
+
+            if (!p.reverbPipeline.isRunning()) {
+                p.reverb.process(left, right, numSamples);
+                return;
+            }
+
+            // (the parameters are passed on between blocks, while the helper is idle)
+            p.reverbPipeline.process(left, right, numSamples, [&p] { p.reverb.setParameters(p.settings.reverb); });
+        }
+    };
+
+    // hard-clip for protection, intended for development only
+    struct ClipStage {
+        static constexpr const char* name = "clip";
+        static void process(RiserProcessor&, float* left, float* right, int numSamples) {
+            for (int i = 0; i < numSamples; i++) {
+                pa::math::setClamp(&left[i], -clipCeiling, clipCeiling);
+                pa::math::setClamp(&right[i], -clipCeiling, clipCeiling);
+            }
+        }
+    };
+
+    using StandardChain = pa::dsp::StageChain<FlangerStage, LowpassStage, HighpassStage, ReverbStage, ClipStage>;
+    using FilteredWashChain = pa::dsp::StageChain<FlangerStage, ReverbStage, LowpassStage, HighpassStage, ClipStage>;
+    using FlangedWashChain = pa::dsp::StageChain<ReverbStage, FlangerStage, LowpassStage, HighpassStage, ClipStage>;
+
+    // What the memory block was sized for
+    struct MemoryLayout {
+        uint sampleRate = 0;
+        bool reverbMultirate = false;
+        int blockSize = 0;
+
+        bool operator== (const MemoryLayout&) const = default;
+    };
+
+    // (first, so it outlives every buffer allocated from it)
+    pa::dsp::MemoryArena arena;
+    MemoryLayout memoryLayout;
+
     float masterAmount = 0.0f, reverbAmount = 0.65f, filterAmount = 1.0f, flangerAmount = 0.7f;
+    bool prepared = false, reverbPipelined = false;
+    uint preparedSampleRate = 0;
+    int preparedBlockSize = 512;
     array<pa::dsp::CombFilter, 2> flanger;
     array<pa::dsp::Filter, 2> lowpass;
     array<pa::dsp::Filter, 2> highpass;
     pa::dsp::Reverb reverb;
+    pa::dsp::Pipeline<pa::dsp::Reverb> reverbPipeline { reverb };
+    pa::dsp::ReverbBus* reverbBus = nullptr;
+    int busSlot = -1;
+    bool joinsReverbBus = true;
+
+    // the other half of a crossfade sharing this processor's bus slot, with this one's gains
+    // for the chunk (see fadeTo()), and the chunk's send and shared reverb, kept by the one
+    // fading out for the one fading in
+    struct BusFade {
+        RiserProcessor* partner = nullptr;
+        const float* gains = nullptr;
+        bool outgoing = false;
+    } busFade;
+
+    array<float, fadeChunkSize> fadeSend, fadeWetL, fadeWetR;
+    pa::dsp::LFO lfo;
+
+    Settings settings = defaultSettings();
+    std::shared_ptr<const MappingTables> mappingTables; // (only once prepared)
+    Modulation modulation;
+    double bpm = 120.0;
+    Order order = Order::standard;
+    int qualityLevel = 0;
+
+    // Lay the buffers out in one block from the arena, sized by allocating them once first
+    // - only when the sizes change, otherwise the buffers are reused as they are
+    void reserveMemory(uint sampleRate, int maxBlockSize) {
+        const MemoryLayout layout { sampleRate, reverb.isMultirate(), maxBlockSize };
+        if (layout == memoryLayout && arena.getCapacity() > 0) return;
+
+        releaseBuffers();
+        arena.reset(0);
+        allocateBuffers(sampleRate, maxBlockSize);
+
+        const size_t numBytes = arena.getBytesAllocated();
+
+        releaseBuffers();
+        arena.reset(numBytes);
+        allocateBuffers(sampleRate, maxBlockSize);
+
+        memoryLayout = layout;
+    }
 
-    pa::dsp::CombFilter::Parameters flangerParams;
-    pa::dsp::Filter::Parameters lowpassParams, highpassParams;
-    pa::dsp::Reverb::Parameters reverbParams;
+    void allocateBuffers(uint sampleRate, int maxBlockSize) {
+        for (auto& f : flanger)
+            f.prepare(sampleRate);
+
+        reverb.prepare(sampleRate);
+        reverbPipeline.allocate(maxBlockSize);
+    }
+
+    void releaseBuffers() {
+        reverbPipeline.release();
+        reverb.release();
+
+        for (auto& f : flanger)
+            f.release();
+    }
+
+    void joinReverbBus() {
+        if (reverbBus == nullptr || !joinsReverbBus || isOnReverbBus()) return;
+
+        busSlot = reverbBus->join(preparedSampleRate, preparedBlockSize, settings.reverb,
+                                  earlyCombTimes, lateCombTimes);
+
+        if (isOnReverbBus())
+            reverbPipeline.stop();
+    }
+
+    void leaveReverbBus() {
+        if (!isOnReverbBus()) return;
+
+        reverbBus->leave(busSlot);
+        busSlot = -1;
+    }
+
+    // Whether the reverb runs here, rather than on a bus (or one that's turned this processor away)
+    bool usesOwnReverb() const noexcept {
+        return reverbBus == nullptr || (joinsReverbBus && !isOnReverbBus());
+    }
+
+    bool isWaitingForReverbBus(const pa::dsp::ReverbBus* bus) const noexcept {
+        return bus != nullptr && reverbBus == bus && !joinsReverbBus && !isOnReverbBus();
+    }
+
+    // Posts the block's send to the bus, leaving the dry signal, and if this is the return,
+    // adds the shared reverb
+    void processReverbBus(float* left, float* right, int numSamples) {
+        if (busFade.partner != nullptr) {
+            processReverbBusFade(left, right, numSamples);
+            return;
+        }
+
+        constexpr int chunkSize = 256;
+        float send[chunkSize];
+
+        for (int start = 0; start < numSamples; start += chunkSize) {
+            const int n = jmin(chunkSize, numSamples - start);
+
+            reverb.processSend(left + start, right + start, send, n);
+            reverbBus->post(busSlot, send, n);
+        }
+
+        if (reverbBus->isReturn(busSlot))
+            reverbBus->render(left, right, numSamples, settings.reverb);
+    }
+
+    // The same for a chunk of a crossfade (see fadeTo()): the one fading out keeps its scaled
+    // send and renders the shared reverb, and the one fading in posts both sends as one
+    // - the return then renders before its own slot's post, which still reads the same sends, as
+    //   the slot just holds a chunk fewer at the time
+    void processReverbBusFade(float* left, float* right, int numSamples) {
+        jassert(numSamples <= fadeChunkSize);
+
+        auto& outgoing = busFade.outgoing ? *this : *busFade.partner;
+        float send[fadeChunkSize];
+
+        reverb.processSend(left, right, send, numSamples);
+
+        if (busFade.outgoing) {
+            for (int i = 0; i < numSamples; i++)
+                fadeSend[size_t(i)] = busFade.gains[i] * send[i];
+
+            std::fill_n(fadeWetL.begin(), numSamples, 0.0f);
+            std::fill_n(fadeWetR.begin(), numSamples, 0.0f);
+
+            if (reverbBus->isReturn(busSlot))
+                reverbBus->render(fadeWetL.data(), fadeWetR.data(), numSamples, settings.reverb);
+        }
+        else {
+            for (int i = 0; i < numSamples; i++)
+                send[i] = busFade.gains[i] * send[i] + outgoing.fadeSend[size_t(i)];
+
+            reverbBus->post(outgoing.busSlot, send, numSamples);
+        }
+
+        for (int i = 0; i < numSamples; i++) {
+            left[i] += outgoing.fadeWetL[size_t(i)];
+            right[i] += outgoing.fadeWetR[size_t(i)];
+        }
+    }
+
+    void updateLfoFrequency() {
+        lfo.setFrequency(modulation.sync ? bpm / 60.0 / double(modulation.syncBeats) : double(modulation.rate));
+    }
+
+    // Runs both flangers over the block, with the LFO computed a chunk at a time
+    void processFlanger(float* left, float* right, int numSamples) {
+        if (modulation.depth <= 0.0f) {
+            flanger[0].process(left, numSamples);
+            flanger[1].process(right, numSamples);
+            return;
+        }
+
+        constexpr int chunkSize = 256;
+        float modL[chunkSize], modR[chunkSize];
+        const float scale = modulation.depth * 0.5f;
+
+        for (int start = 0; start < numSamples; start += chunkSize) {
+            const int n = jmin(chunkSize, numSamples - start);
+
+            lfo.process(modL, modR, n, modulation.stereoPhase);
+
+            // turn the LFO into delay time multipliers
+            for (int i = 0; i < n; i++) {
+                modL[i] = 1.0f + scale * modL[i];
+                modR[i] = 1.0f + scale * modR[i];
+            }
+
+            flanger[0].process(left + start, n, modL);
+            flanger[1].process(right + start, n, modR);
+        }
+    }
 
     // calculate the value mappings, and set the processors' values
+    // - once prepared this goes through the mapping tables, so it's cheap enough for every block
     void calculateValues() {
-        // flanger — map the wet, frequency, feedback
-        flangerParams.wet      = mapValue(pa::math::expRounder(flangerAmount, 0.3f), 0, 0.75f);
-        flangerParams.freq     = mapValue(flangerAmount, 20.0f, 280.0f);
-        flangerParams.feedback = mapValue(flangerAmount, 0.0f, 0.55f);
+        if (mappingTables != nullptr)
+            lookupSettings(settings, *mappingTables, flangerAmount, filterAmount, reverbAmount);
+        else
+            mapSettings(settings, flangerAmount, filterAmount, reverbAmount);
 
-        // filters — map the cutoff and q for both filters
-        lowpassParams.cutoff  = mapValue(pa::math::expRounder(filterAmount, 0.3f), 20000.0f, 4000.0f);
-        lowpassParams.q       = mapValue(pa::math::expRounder(filterAmount, -0.6f), 0.5f, 0.85f);
-        highpassParams.cutoff = mapValue(pa::math::expRounder(filterAmount, -0.3f), 10.0f, 200.0f);
-        highpassParams.q      = mapValue(pa::math::expRounder(filterAmount, -0.5f), static_cast<float>(M_SQRT1_2), 1.0f);
-
-        // reverb — map the mix, size, width and stereo spread
-        reverbParams.mix    = mapValue(reverbAmount, 0.0f, 0.75f);
-        reverbParams.size   = mapValue(reverbAmount, 0.01f, 0.45f);
-        reverbParams.width  = mapValue(reverbAmount, 1.0f, 0.6f);
-        reverbParams.spread = mapValue(pa::math::expRounder(reverbAmount, 0.3f), 0.5f, 1.5f);
+        // (see setQualityLevel())
+        settings.reverb.numEarlyCombs = qualityLevel > 0 ? pa::dsp::Reverb::maxEarlyCombs / 2 : pa::dsp::Reverb::maxEarlyCombs;
+        settings.reverb.numLateCombs = qualityLevel > 0 ? pa::dsp::Reverb::maxLateCombs / 2 : pa::dsp::Reverb::maxLateCombs;
+        settings.flanger.interpType = qualityLevel > 1 ? pa::dsp::noInterp : pa::dsp::linearInterp;
 
         //          //          //          //          //
 
         // set parameter objects
-        flanger[0].setParameters(flangerParams, 0.0f);
-        flanger[1].setParameters(flangerParams, 7.0f * pa::math::expRounder(flangerAmount, -0.4f));
+        flanger[0].setParameters(settings.flanger, 0.0f);
+        flanger[1].setParameters(settings.flanger, settings.flangerOffset);
 
-        for (size_t i = 0; i < 2; i++) {
-            lowpass[i].setParameters(lowpassParams);
-            highpass[i].setParameters(highpassParams);
+        if (mappingTables != nullptr) {
+            const auto c = mappingTables->filterCoefficients.lookup(double(filterAmount));
+
+            for (size_t i = 0; i < 2; i++) {
+                lowpass[i].setParameters(settings.lowpass, { c[0], c[1], c[2], c[3], c[4] });
+                highpass[i].setParameters(settings.highpass, { c[5], c[6], c[7], c[8], c[9] });
+            }
+        }
+        else {
+            for (size_t i = 0; i < 2; i++) {
+                lowpass[i].setParameters(settings.lowpass);
+                highpass[i].setParameters(settings.highpass);
+            }
         }
 
-        reverb.setParameters(reverbParams);
+        // (the pipelined reverb's are passed on between its blocks instead)
+        if (!reverbPipeline.isRunning())
+            reverb.setParameters(settings.reverb);
     }
 
     // Function to prevent having to type out the input range every time
     static inline float mapValue(const float& val, const float& min, const float& max) {
         return pa::math::map<float>(val, 0, 1, min, max);
     }
-};
\ No newline at end of file
+};
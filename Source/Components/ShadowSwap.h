@@ -0,0 +1,192 @@
+#pragma once
+#include <atomic>
+#include "pa.h"
+
+/*
+ * ~ Shadow swap ~
+ * Swaps a stereo processor for a freshly set-up one (its "shadow") without a click, e.g.
+ * when the host loads a state or a preset mid-playback.
+ *
+ * There are two processors, the live one and the shadow. A swap first freezes the live one
+ * at its current parameters, then the shadow is set up and prepared for the new ones off the
+ * audio thread, and handed over. The audio thread runs both over the same input for a short
+ * window, with an equal-power crossfade from the live one to the shadow, after which the
+ * shadow is live and the old live one is the next shadow. So their memory is reused from
+ * swap to swap, and nothing is allocated or freed on the audio thread.
+ *
+ * The handover is a small state machine in one atomic, so neither side ever waits: starting a
+ * swap freezes the live one straight away, whether or not the audio thread is running, and a
+ * swap can't start while another is under way (the incoming shadow follows the parameters then).
+ *
+ * Preparing or releasing in the middle of a swap finishes it at once (see finishSwap()), so a
+ * crossfade never carries on into processors that have been prepared again or freed.
+ *
+ * Anything the two share outside themselves is passed between them through the processor's
+ * fadeTo(to, outGains, inGains), before each chunk of the crossfade, and handOverTo(to), as
+ * the shadow goes live — e.g. RiserProcessor's slot on a reverb bus, which the pair only ever
+ * holds one of.
+*/
+
+namespace pa::dsp {
+
+template <typename Processor>
+class ShadowSwap {
+ public:
+    static constexpr double fadeSeconds = 0.05;
+
+    // Set the crossfade's length for a sample rate (not while processing), finishing any swap
+    // under way first — so prepare the live processor after this, as it may have changed
+    void prepare(uint sampleRate) {
+        finishSwap();
+        fadeLength = jmax(1, int(fadeSeconds * sampleRate));
+    }
+
+    // Finish any swap under way at once, e.g. before releasing (not while processing)
+    // - a shadow that's been handed over goes live straight away, without the rest of its
+    //   crossfade, and one that's still being set up is dropped (its commitSwap() does nothing)
+    void finishSwap() {
+        const int s = state.exchange(idle);
+
+        if (s == ready || s == fading) {
+            getLive().handOverTo(getShadow());
+            live.store(1 - live.load());
+            swapped.store(true);
+        }
+
+        fadePosition = 0;
+    }
+
+    // (the live one only changes at the end of a crossfade, on the audio thread)
+    Processor& getLive() noexcept {
+        return processors[size_t(live.load())];
+    }
+
+    Processor& getShadow() noexcept {
+        return processors[size_t(1 - live.load())];
+    }
+
+    // Apply fn to both processors (not while processing)
+    template <typename Function>
+    void forEach(Function&& fn) {
+        for (auto& p : processors)
+            fn(p);
+    }
+
+    bool isSwapping() const noexcept {
+        return state.load() != idle;
+    }
+
+    // Start a swap (not on the audio thread): freezes the live processor, so the audio thread
+    // stops updating it from its next block, after which the shadow is free to be set up
+    // - returns false if a swap is already under way, in which case there's no swap to commit
+    //   (its shadow follows the parameters from when it's handed over, so it picks up the new ones)
+    // - a block already under way may still update the live one, which its smoothing covers
+    bool beginSwap() {
+        int expected = idle;
+        return state.compare_exchange_strong(expected, frozen);
+    }
+
+    // Hand the shadow over, once it's set up for the new parameters and prepared
+    // (unless finishSwap() has dropped the swap since)
+    void commitSwap() {
+        int expected = frozen;
+        state.compare_exchange_strong(expected, ready);
+    }
+
+    // Give up on a swap after beginSwap(), e.g. if the new state couldn't be read
+    void cancelSwap() {
+        int expected = frozen;
+        state.compare_exchange_strong(expected, idle);
+    }
+
+    // Returns true once after each swap has finished (e.g. to tidy up the old live processor)
+    bool takeSwapped() noexcept {
+        return swapped.exchange(false);
+    }
+
+    // Process a block (audio thread only)
+    // - update(processor) is called with whichever processor should follow the parameters this
+    //   block: the live one, or the shadow once it's been handed over (the live one stays frozen)
+    template <typename Update>
+    void process(float* left, float* right, int numSamples, Update&& update) {
+        int s = state.load();
+
+        if (s == ready) {
+            fadePosition = 0;
+            state.store(fading);
+            s = fading;
+        }
+
+        if (s == idle)
+            update(getLive());
+        else if (s == fading)
+            update(getShadow());
+
+        if (s != fading) {
+            getLive().process(left, right, numSamples);
+            return;
+        }
+
+        crossfade(left, right, numSamples);
+    }
+
+ private:
+    enum { idle, frozen, ready, fading };
+
+    static constexpr int chunkSize = Processor::fadeChunkSize;
+
+    array<Processor, 2> processors;
+    std::atomic<int> live { 0 }, state { idle };
+    std::atomic<bool> swapped { false };
+
+    int fadeLength = 2400, fadePosition = 0; // (audio thread only)
+
+    // Runs both processors over the block, crossfading until the shadow takes over
+    void crossfade(float* left, float* right, int numSamples) {
+        auto& from = getLive();
+        auto& to = getShadow();
+        float shadowL[chunkSize], shadowR[chunkSize], outGains[chunkSize], inGains[chunkSize];
+
+        for (int start = 0; start < numSamples;) {
+            const int n = jmin(chunkSize, jmin(numSamples - start, fadeLength - fadePosition));
+            float* l = left + start, * r = right + start;
+
+            // (equal power, so the level holds through the fade even where the two don't correlate)
+            for (int i = 0; i < n; i++) {
+                const double angle = MathConstants<double>::halfPi * double(fadePosition + i) / double(fadeLength);
+                outGains[i] = float(std::cos(angle));
+                inGains[i] = float(std::sin(angle));
+            }
+
+            std::copy_n(l, n, shadowL);
+            std::copy_n(r, n, shadowR);
+
+            from.fadeTo(to, outGains, inGains);
+            from.process(l, r, n);
+            to.process(shadowL, shadowR, n);
+
+            for (int i = 0; i < n; i++) {
+                l[i] = outGains[i] * l[i] + inGains[i] * shadowL[i];
+                r[i] = outGains[i] * r[i] + inGains[i] * shadowR[i];
+            }
+
+            start += n;
+            fadePosition += n;
+
+            if (fadePosition >= fadeLength) {
+                from.handOverTo(to);
+                live.store(1 - live.load());
+                state.store(idle);
+                swapped.store(true);
+
+                // the rest of the block is the new live processor's alone
+                if (start < numSamples)
+                    to.process(left + start, right + start, numSamples - start);
+
+                return;
+            }
+        }
+    }
+};
+
+} // end namespace pa::dsp
@@ -0,0 +1,244 @@
+// Process-wide cache of the editor's decoded images, typeface and pre-scaled variants
+#pragma once
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+#include "BinaryData.h"
+
+// Every editor holds this through a SharedResourcePointer, so the assets are
+// decoded once per process rather than once per editor, and the memory they
+// use stays flat however many editors are open (and none of it is used, or
+// decoded, by instances that never open one, e.g. headless or offline)
+class SharedAssets {
+ public:
+    enum ImageID {
+        background,
+        smallKnobBase,
+        smallKnobTop,
+        largeKnobBase,
+        largeKnobTop,
+        numImages
+    };
+
+    // number of pre-rotated positions a knob snaps to
+    static constexpr int numFrames = 128;
+
+    // the most memory the rendered knob frames may hold between them — frames are kept and
+    // evicted as whole sets (a knob type at one pixel width), least recently drawn first, but the
+    // latest set of each knob type is always kept, so a knob's frames all fit whatever the scale
+    // (a large knob at hi-dpi scales is more than this on its own)
+    static constexpr size_t frameBudgetBytes = size_t(16) << 20;
+
+    // Identifies a pre-rotated knob frame: { knob type, pixel width, frame index }
+    using FrameKey = std::tuple<int, int, int>;
+
+    // Identifies a set of frames: { knob type, pixel width }
+    using FrameSetKey = std::pair<int, int>;
+
+    // Decoding starts straight away in the background, so the first editor
+    // usually finds everything ready
+    SharedAssets() { loader.startThread(Thread::Priority::low); }
+
+    ~SharedAssets() { loader.stopThread(2000); }
+
+    // Returns a decoded image, decoding it now if the loader hasn't got to it yet
+    // - decoding happens outside the lock, so a caller only ever waits for its own decode
+    //   (if both threads decode the same image at once, the first to finish is kept)
+    Image getImage(ImageID id) {
+        {
+            const ScopedLock sl(lock);
+            const auto& image = images[size_t(id)];
+
+            if (!image.isNull())
+                return image;
+        }
+
+        const Image decoded = decodeImage(id);
+
+        const ScopedLock sl(lock);
+        auto& image = images[size_t(id)];
+
+        if (image.isNull())
+            image = decoded;
+
+        return image;
+    }
+
+    // Returns the label typeface, creating it now if the loader hasn't got to it yet
+    // (created outside the lock too, as with the images)
+    Typeface::Ptr getTypeface() {
+        {
+            const ScopedLock sl(lock);
+
+            if (typeface != nullptr)
+                return typeface;
+        }
+
+        const auto created = Typeface::createSystemTypefaceFor(BinaryData::MuliBold_ttf, BinaryData::MuliBold_ttfSize);
+
+        const ScopedLock sl(lock);
+
+        if (typeface == nullptr)
+            typeface = created;
+
+        return typeface;
+    }
+
+    // Returns a knob frame shared by all knobs of its type and size, or a null image if it
+    // hasn't been rendered yet (or has since been evicted)
+    Image findFrame(const FrameKey& key) {
+        const ScopedLock sl(lock);
+        const auto it = frames.find(key);
+
+        if (it == frames.end())
+            return {};
+
+        touchFrameSet(getFrameSetKey(key));
+        return it->second;
+    }
+
+    // Adds a newly rendered knob frame, evicting the least recently used sets beyond the budget
+    // - frames are rendered lazily (on the message thread) by whoever draws them first
+    void addFrame(const FrameKey& key, const Image& frame) {
+        const ScopedLock sl(lock);
+
+        if (!frames.emplace(key, frame).second) return;
+
+        const auto setKey = getFrameSetKey(key);
+        touchFrameSet(setKey);
+        frameSetBytes[setKey] += getFrameBytes(frame);
+        frameBytes += getFrameBytes(frame);
+
+        // (oldest first, skipping the latest set of each knob type)
+        for (auto it = frameSetOrder.end(); frameBytes > frameBudgetBytes && it != frameSetOrder.begin();) {
+            --it;
+            const int knobType = it->first;
+
+            if (std::none_of(frameSetOrder.begin(), it, [knobType](const FrameSetKey& k) { return k.first == knobType; }))
+                continue;
+
+            const auto first = frames.lower_bound({ it->first, it->second, 0 }),
+                       last = frames.lower_bound({ it->first, it->second + 1, 0 });
+            frames.erase(first, last);
+
+            frameBytes -= frameSetBytes[*it];
+            frameSetBytes.erase(*it);
+            it = frameSetOrder.erase(it);
+        }
+    }
+
+    // Returns the background rescaled to the given size, shared between editors of that size
+    // (and fill colour)
+    std::shared_ptr<const Image> getScaledBackground(int width, int height, Colour fillColour) {
+        const BackgroundKey key { width, height, fillColour.getARGB() };
+        {
+            const ScopedLock sl(lock);
+            const auto it = backgrounds.find(key);
+            auto scaled = it != backgrounds.end() ? it->second.lock() : nullptr;
+
+            if (scaled != nullptr)
+                return scaled;
+        }
+
+        // (drawn outside the lock, as getImage() may have to wait for its decode)
+        Image image(Image::RGB, width, height, false);
+        {
+            Graphics g(image);
+
+            // Fill the background with a solid colour
+            g.fillAll(fillColour);
+
+            g.setImageResamplingQuality(Graphics::highResamplingQuality);
+            g.drawImageWithin(getImage(background), 0, 0, width, height, RectanglePlacement::centred);
+        }
+
+        const ScopedLock sl(lock);
+        auto& entry = backgrounds[key];
+        auto scaled = entry.lock();
+
+        if (scaled == nullptr) {
+            scaled = std::make_shared<const Image>(image);
+            entry = scaled;
+
+            // (sizes that every editor has since left behind)
+            std::erase_if(backgrounds, [](const auto& b) { return b.second.expired(); });
+        }
+
+        return scaled;
+    }
+
+ private:
+    // Decodes everything up front, away from the message thread
+    class Loader : public Thread {
+     public:
+        explicit Loader(SharedAssets& a) : Thread("OneRiser asset loader"), assets(a) {}
+
+        void run() override {
+            for (int i = 0; i < numImages && !threadShouldExit(); i++)
+                assets.getImage(ImageID(i));
+
+            if (!threadShouldExit())
+                assets.getTypeface();
+        }
+
+     private:
+        SharedAssets& assets;
+    };
+
+    static FrameSetKey getFrameSetKey(const FrameKey& key) {
+        return { std::get<0>(key), std::get<1>(key) };
+    }
+
+    // Moves a set to the front of frameSetOrder, as the most recently used (lock held)
+    void touchFrameSet(const FrameSetKey& setKey) {
+        const auto it = std::find(frameSetOrder.begin(), frameSetOrder.end(), setKey);
+
+        if (it == frameSetOrder.end())
+            frameSetOrder.push_front(setKey);
+        else
+            frameSetOrder.splice(frameSetOrder.begin(), frameSetOrder, it);
+    }
+
+    static size_t getFrameBytes(const Image& frame) {
+        return size_t(frame.getWidth()) * size_t(frame.getHeight()) * sizeof(PixelARGB);
+    }
+
+    static Image decodeImage(ImageID id) {
+        switch (id) {
+            case background:
+                return ImageFileFormat::loadFrom(BinaryData::Background2_5_png, BinaryData::Background2_5_pngSize);
+            case smallKnobBase:
+                return ImageFileFormat::loadFrom(BinaryData::SmallKnobBase_png, BinaryData::SmallKnobBase_pngSize);
+            case smallKnobTop:
+                return ImageFileFormat::loadFrom(BinaryData::SmallKnobTop_png, BinaryData::SmallKnobTop_pngSize);
+            case largeKnobBase:
+                return ImageFileFormat::loadFrom(BinaryData::LargeKnobBase_png, BinaryData::LargeKnobBase_pngSize);
+            case largeKnobTop:
+                return ImageFileFormat::loadFrom(BinaryData::LargeKnobTop_png, BinaryData::LargeKnobTop_pngSize);
+            default:
+                return {};
+        }
+    }
+
+    CriticalSection lock;
+    array<Image, numImages> images;
+    Typeface::Ptr typeface;
+
+    // the knob frames, with their sets most recently used first in frameSetOrder (there are only
+    // ever a few sets, so it's just searched)
+    std::map<FrameKey, Image> frames;
+    std::list<FrameSetKey> frameSetOrder;
+    std::map<FrameSetKey, size_t> frameSetBytes;
+    size_t frameBytes = 0;
+
+    // keyed by { width, height, fill colour (ARGB) }
+    using BackgroundKey = std::tuple<int, int, uint32>;
+    std::map<BackgroundKey, std::weak_ptr<const Image>> backgrounds;
+
+    // declared last, so it's stopped before anything it touches is destroyed
+    Loader loader { *this };
+
+    JUCE_DECLARE_NON_COPYABLE(SharedAssets)
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include "pa.h"
+
+// Lock-free (single producer, single consumer) feed of block levels and a
+// downsampled mono signal, from the audio thread to the editor
+
+namespace pa {
+
+class SignalFeed {
+ public:
+    // Peak levels of a single block, before and after the riser
+    struct Levels {
+        float input = 0.0f, output = 0.0f;
+    };
+
+    // the downsampled signal sits around this rate, whatever the host rate is
+    static constexpr double targetRate = 24000.0;
+
+    // All allocation happens here, so the audio thread never has to
+    SignalFeed() : samples(sampleFifoSize), levels(levelFifoSize) {}
+
+    // Set the decimation factor for the host's sample rate (not on the audio thread)
+    void prepare(double sampleRate) {
+        decimation = jmax(1, roundToInt(sampleRate / targetRate));
+        feedRate.store(sampleRate / decimation);
+        accumulator = 0.0f;
+        accumulated = 0;
+    }
+
+    // Turn the feed on or off, the editor does this when it opens/closes
+    void setActive(bool shouldBeActive) {
+        active.store(shouldBeActive, std::memory_order_release);
+    }
+
+    bool isActive() const noexcept {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Returns the rate of the downsampled signal
+    double getFeedRate() const noexcept {
+        return feedRate.load();
+    }
+
+    //              // audio thread //              //
+
+    // Push the levels for one block — dropped if the editor isn't keeping up
+    void pushLevels(const Levels& newLevels) noexcept {
+        const auto scope = levelFifo.write(1);
+
+        if (scope.blockSize1 > 0)
+            levels[size_t(scope.startIndex1)] = newLevels;
+    }
+
+    // Push a stereo block, which is summed to mono and decimated by averaging
+    void pushSignal(const float* left, const float* right, int numSamples) noexcept {
+        // scratch for one chunk of decimated samples
+        float decimated[maxBlockSize];
+
+        while (numSamples > 0) {
+            const int blockSize = jmin(numSamples, maxBlockSize);
+            int numDecimated = 0;
+
+            for (int i = 0; i < blockSize; i++) {
+                accumulator += left[i] + right[i];
+
+                if (++accumulated >= decimation) {
+                    decimated[numDecimated++] = accumulator * 0.5f / float(decimation);
+                    accumulator = 0.0f;
+                    accumulated = 0;
+                }
+            }
+
+            const auto scope = sampleFifo.write(numDecimated);
+
+            if (scope.blockSize1 > 0)
+                std::copy_n(decimated, scope.blockSize1, samples.begin() + scope.startIndex1);
+            if (scope.blockSize2 > 0)
+                std::copy_n(decimated + scope.blockSize1, scope.blockSize2, samples.begin() + scope.startIndex2);
+
+            left += blockSize;
+            right += blockSize;
+            numSamples -= blockSize;
+        }
+    }
+
+    //              // message thread //              //
+
+    // Read up to maxSamples of the downsampled signal, returns the number read
+    int readSignal(float* dest, int maxSamples) noexcept {
+        const auto scope = sampleFifo.read(jmin(maxSamples, sampleFifo.getNumReady()));
+
+        std::copy_n(samples.begin() + scope.startIndex1, scope.blockSize1, dest);
+        std::copy_n(samples.begin() + scope.startIndex2, scope.blockSize2, dest + scope.blockSize1);
+
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+    // Read all pending levels, returns the highest of them
+    Levels readLevels() noexcept {
+        Levels peak;
+        const auto scope = levelFifo.read(levelFifo.getNumReady());
+
+        auto accumulate = [&](int start, int size) {
+            for (int i = start; i < start + size; i++) {
+                peak.input = jmax(peak.input, levels[size_t(i)].input);
+                peak.output = jmax(peak.output, levels[size_t(i)].output);
+            }
+        };
+
+        accumulate(scope.startIndex1, scope.blockSize1);
+        accumulate(scope.startIndex2, scope.blockSize2);
+
+        return peak;
+    }
+
+    // Discard anything pending, e.g. when the editor reopens (consumer side only)
+    void discard() noexcept {
+        sampleFifo.read(sampleFifo.getNumReady());
+        levelFifo.read(levelFifo.getNumReady());
+    }
+
+ private:
+    static constexpr int sampleFifoSize = 1 << 14, levelFifoSize = 512, maxBlockSize = 256;
+
+    std::atomic<bool> active { false };
+    std::atomic<double> feedRate { targetRate };
+
+    // audio thread only
+    int decimation = 2, accumulated = 0;
+    float accumulator = 0.0f;
+
+    AbstractFifo sampleFifo { sampleFifoSize }, levelFifo { levelFifoSize };
+    vector<float> samples;
+    vector<Levels> levels;
+};
+
+} // end namespace pa
@@ -0,0 +1,126 @@
+#pragma once
+#include "SignalFeed.h"
+
+// Live spectrum and input/output level display, fed by the processor's SignalFeed
+// - the FFT runs here on the message thread, the audio thread only decimates
+
+class SpectrumDisplay : public juce::Component {
+ public:
+    explicit SpectrumDisplay(pa::SignalFeed& signalFeed) : feed(signalFeed) {
+        setInterceptsMouseClicks(false, false);
+        spectrum.fill(minDb);
+
+        // anything left over from a previous editor is stale
+        feed.discard();
+        feed.setActive(true);
+    }
+
+    ~SpectrumDisplay() override {
+        feed.setActive(false);
+    }
+
+    void paint(Graphics& g) override {
+        const auto bounds = getLocalBounds().toFloat();
+        const float meterWidth = jmax(2.0f, bounds.getWidth() / 80.0f);
+        auto area = bounds.reduced(meterWidth * 2.0f, 0.0f);
+
+        // spectrum, on a log frequency scale
+        Path path;
+        path.startNewSubPath(area.getBottomLeft());
+
+        for (size_t i = 0; i < numPoints; i++) {
+            const float x = area.getX() + area.getWidth() * float(i) / float(numPoints - 1);
+            path.lineTo(x, dbToY(spectrum[i], area));
+        }
+
+        path.lineTo(area.getBottomRight());
+        path.closeSubPath();
+
+        g.setColour(Colours::white.withAlpha(0.18f));
+        g.fillPath(path);
+
+        // input level on the left, output level on the right
+        auto drawMeter = [&](float x, float level) {
+            const float y = dbToY(Decibels::gainToDecibels(level, minDb), bounds);
+            g.fillRect(x, y, meterWidth, bounds.getBottom() - y);
+        };
+
+        g.setColour(Colours::white.withAlpha(0.5f));
+        drawMeter(bounds.getX(), inputLevel);
+        drawMeter(bounds.getRight() - meterWidth, outputLevel);
+    }
+
+ private:
+    static constexpr int fftOrder = 11, fftSize = 1 << fftOrder;
+    static constexpr size_t numPoints = 96;
+    static constexpr float minDb = -90.0f, minFreq = 20.0f, decayDb = 1.5f, levelDecay = 0.85f;
+
+    pa::SignalFeed& feed;
+
+    juce::dsp::FFT fft { fftOrder };
+    juce::dsp::WindowingFunction<float> window { size_t(fftSize), juce::dsp::WindowingFunction<float>::hann };
+
+    // the latest fftSize samples of the feed, oldest first
+    array<float, fftSize> history {};
+    array<float, fftSize * 2> fftData {};
+    array<float, numPoints> spectrum {};
+    float inputLevel = 0.0f, outputLevel = 0.0f;
+
+    // updates are aligned to the display's refresh, rather than a free-running timer
+    VBlankAttachment vBlank { this, [this] { update(); } };
+
+    // Pull whatever the audio thread has pushed since the last frame
+    void update() {
+        array<float, fftSize> incoming;
+        const int numNew = feed.readSignal(incoming.data(), fftSize);
+        const auto levels = feed.readLevels();
+
+        inputLevel = jmax(levels.input, inputLevel * levelDecay);
+        outputLevel = jmax(levels.output, outputLevel * levelDecay);
+
+        if (numNew > 0) {
+            std::move(history.begin() + numNew, history.end(), history.begin());
+            std::copy_n(incoming.begin(), numNew, history.end() - numNew);
+        }
+
+        // nothing to show, and nothing still decaying — skip the repaint
+        if (numNew == 0 && inputLevel < 1.0e-5f && outputLevel < 1.0e-5f
+            && std::all_of(spectrum.begin(), spectrum.end(), [](float db) { return db <= minDb; }))
+            return;
+
+        // (with nothing new, the history is what's already shown — just let it fall away)
+        if (numNew > 0) {
+            calculateSpectrum();
+        }
+        else {
+            for (auto& db : spectrum)
+                db = jmax(minDb, db - decayDb);
+        }
+
+        repaint();
+    }
+
+    void calculateSpectrum() {
+        std::copy(history.begin(), history.end(), fftData.begin());
+        window.multiplyWithWindowingTable(fftData.data(), size_t(fftSize));
+        fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+        const float nyquist = float(feed.getFeedRate()) * 0.5f;
+
+        for (size_t i = 0; i < numPoints; i++) {
+            // log-spaced points between minFreq and nyquist
+            const float freq = minFreq * std::pow(nyquist / minFreq, float(i) / float(numPoints - 1));
+            const auto bin = jlimit(0, fftSize / 2, roundToInt(freq / nyquist * float(fftSize / 2)));
+            const float db = Decibels::gainToDecibels(fftData[size_t(bin)] * 4.0f / float(fftSize), minDb);
+
+            // fast attack, slow release
+            spectrum[i] = jmax(db, spectrum[i] - decayDb);
+        }
+    }
+
+    static float dbToY(float db, Rectangle<float> area) {
+        return jmap(jlimit(minDb, 0.0f, db), minDb, 0.0f, area.getBottom(), area.getY());
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumDisplay)
+};
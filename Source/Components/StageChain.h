@@ -0,0 +1,31 @@
+#pragma once
+#include "pa.h"
+#include "Trace.h"
+
+// A fixed order of stereo processing stages, chosen at compile time
+// - like juce::dsp::ProcessorChain, but the stages don't own their processors: each is a
+//   small type with a name and a static process(context, left, right, numSamples), which
+//   runs its part of the context (e.g. RiserProcessor's filters). So any number of orders
+//   can be instantiated over the same processors, and their state carries over between them
+// - the stages are called directly, in order, so the whole chain inlines into one function
+
+namespace pa::dsp {
+
+template <typename... Stages>
+struct StageChain {
+    static constexpr size_t numStages = sizeof...(Stages);
+
+    template <typename Context>
+    static void process(Context& context, float* left, float* right, int numSamples) {
+        (processStage<Stages>(context, left, right, numSamples), ...);
+    }
+
+ private:
+    template <typename Stage, typename Context>
+    static void processStage(Context& context, float* left, float* right, int numSamples) {
+        PA_TRACE_SCOPE(Stage::name);
+        Stage::process(context, left, right, numSamples);
+    }
+};
+
+} // end namespace pa::dsp
@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <semaphore>
+#include <thread>
+#include "ChunkedRender.h"
+
+/*
+ * ~ Streaming rendering ~
+ * Offline rendering of a signal of any length through one RiserProcessor, in a fixed amount
+ * of memory, e.g. for multi-hour stems that wouldn't fit in memory whole.
+ *
+ * The signal goes round a ring of a few fixed-size buffers in three stages, each on its own
+ * thread: the reader fills a buffer from the source, the calling thread processes it, then
+ * the writer passes it on to the destination, after which it's free for the reader again. So
+ * reading, processing and writing all overlap, and the processing only waits once the reader
+ * or writer has fallen a whole ring behind — a slow read or write on its own never holds it up
+ * (with three or more buffers). The ring is all the memory it needs, whatever the length.
+ *
+ * Processing runs in ChunkedRenderer's block grid from the start, so the output is exactly
+ * its sequential render (ChunkedRenderer::renderSequential()).
+*/
+
+class StreamingRenderer {
+ public:
+    struct Options {
+        int bufferSize = 1 << 16; // samples per buffer (rounded up to a whole number of blocks)
+        int numBuffers = 3;       // 2 overlaps the processing with reading or writing, 3 or more with both
+    };
+
+    struct Report {
+        int64 numSamples = 0;        // rendered, including any tail
+        double dspWaitSeconds = 0.0; // how long processing waited for the reader (or, through it, the writer)
+        size_t bufferBytes = 0;      // the ring's memory
+        bool succeeded = false;
+    };
+
+    // Fills left and right with numSamples of the source, from position (on the reader thread)
+    using Reader = std::function<bool(float* left, float* right, int64 position, int numSamples)>;
+
+    // Takes the next numSamples of the output (on the writer thread)
+    using Writer = std::function<bool(const float* left, const float* right, int numSamples)>;
+
+    static constexpr int blockSize = ChunkedRenderer::blockSize, maxBuffers = 16;
+
+    // Render numSamples through a prepared processor, from the source for its first numInputSamples
+    // and then from silence (e.g. for the tail)
+    // - stops early (and doesn't succeed) if the reader or writer returns false
+    static Report render(RiserProcessor& processor, int64 numInputSamples, int64 numSamples,
+                         const Reader& read, const Writer& write, const Options& options) {
+        Report report;
+
+        const int bufferSize = getBufferSize(options);
+        const int numBuffers = jlimit(2, maxBuffers, options.numBuffers);
+        const int64 numRounds = (jmax(int64(0), numSamples) + bufferSize - 1) / bufferSize;
+
+        // (allocated once, up front)
+        vector<float> memory(size_t(2 * numBuffers * bufferSize));
+        report.bufferBytes = memory.size() * sizeof(float);
+
+        const auto getBuffer = [&](int64 round, int channel) {
+            return memory.data() + (size_t(round % numBuffers) * 2 + size_t(channel)) * size_t(bufferSize);
+        };
+
+        const auto getLength = [&](int64 round) {
+            return int(jmin(int64(bufferSize), numSamples - round * bufferSize));
+        };
+
+        Stage stage(numBuffers);
+
+        std::thread reader([&] {
+            for (int64 round = 0; round < numRounds; round++) {
+                if (!stage.acquire(stage.free)) return;
+
+                const int64 position = round * bufferSize;
+                const int n = getLength(round),
+                          fromSource = int(jlimit(int64(0), int64(n), numInputSamples - position));
+                float* left = getBuffer(round, 0), * right = getBuffer(round, 1);
+
+                if (fromSource > 0 && !read(left, right, position, fromSource)) {
+                    stage.fail();
+                    return;
+                }
+
+                std::fill(left + fromSource, left + n, 0.0f);
+                std::fill(right + fromSource, right + n, 0.0f);
+
+                stage.read.release();
+            }
+        });
+
+        std::thread writer([&] {
+            for (int64 round = 0; round < numRounds; round++) {
+                if (!stage.acquire(stage.processed)) return;
+
+                if (!write(getBuffer(round, 0), getBuffer(round, 1), getLength(round))) {
+                    stage.fail();
+                    return;
+                }
+
+                stage.free.release();
+            }
+        });
+
+        for (int64 round = 0; round < numRounds; round++) {
+            // (only timed when it actually has to wait)
+            if (!stage.read.try_acquire()) {
+                const auto start = Time::getHighResolutionTicks();
+                stage.read.acquire();
+                report.dspWaitSeconds += Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+            }
+
+            if (stage.failed.load()) break;
+
+            const int n = getLength(round);
+            float* left = getBuffer(round, 0), * right = getBuffer(round, 1);
+
+            for (int start = 0; start < n; start += blockSize)
+                processor.process(left + start, right + start, jmin(blockSize, n - start));
+
+            report.numSamples += n;
+            stage.processed.release();
+        }
+
+        reader.join();
+        writer.join();
+
+        report.succeeded = !stage.failed.load();
+        return report;
+    }
+
+    // The most samples a reader or writer is given at once, for the options
+    static int getBufferSize(const Options& options) {
+        return (jmax(blockSize, options.bufferSize) + blockSize - 1) / blockSize * blockSize;
+    }
+
+ private:
+    using Semaphore = std::counting_semaphore<4 * maxBuffers>;
+
+    // The handoffs between the threads: each buffer goes free -> read -> processed -> free
+    struct Stage {
+        explicit Stage(int numBuffers) : numBuffers(numBuffers), free(numBuffers) {}
+
+        const int numBuffers;
+        Semaphore free, read { 0 }, processed { 0 };
+        std::atomic<bool> failed { false };
+
+        // returns false if a stage has failed, and so this one should stop too
+        bool acquire(Semaphore& s) {
+            s.acquire();
+            return !failed.load();
+        }
+
+        // wake every stage, so they all see the failure (each stage fails at most once, so the
+        // semaphores stay within their maximum)
+        void fail() {
+            failed.store(true);
+
+            for (auto* s : { &free, &read, &processed })
+                s->release(numBuffers);
+        }
+    };
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+/*
+ * ~ Audio thread tracing ~
+ * Opt-in (configure with -DONERISER_TRACING=ON), otherwise the macros below compile to nothing.
+ *
+ * Each plugin instance gets a Session, whose lock-free ring the audio thread writes
+ * timestamped begin/end/instant events into. One background thread per process drains
+ * every instance's ring into a Chrome/Perfetto trace (JSON array format, so a file cut
+ * short by a crash still loads), and keeps a histogram of each instance's callback jitter
+ * and load next to it.
+ *
+ * Files go to <temp>/OneRiserTraces, or the ONERISER_TRACE_DIR environment variable's
+ * directory. Load the .json in ui.perfetto.dev or chrome://tracing — each instance is a
+ * thread, and every instance in the same process shares a timeline.
+*/
+
+#if ONERISER_TRACING
+
+namespace pa::trace {
+
+// One trace event (names must be string literals, they're only read later)
+struct Event {
+    int64 ticks = 0;
+    const char* name = nullptr;
+    float value = 0.0f;
+    char phase = 'i'; // 'B'egin, 'E'nd or 'i'nstant, as in the Chrome format
+};
+
+// Single producer (the audio thread), single consumer (the drain thread) event queue
+class Ring {
+ public:
+    static constexpr int capacity = 1 << 14;
+
+    Ring() : events(size_t(capacity)) {}
+
+    // Add an event — dropped (and counted) if the drain thread isn't keeping up
+    void push(const char* name, char phase, float value = 0.0f) noexcept {
+        const auto scope = fifo.write(1);
+
+        if (scope.blockSize1 > 0)
+            events[size_t(scope.startIndex1)] = { Time::getHighResolutionTicks(), name, value, phase };
+        else
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename Callback>
+    void drain(Callback&& callback) {
+        const auto scope = fifo.read(fifo.getNumReady());
+        scope.forEach([&](int index) { callback(events[size_t(index)]); });
+    }
+
+    int64 getNumDropped() const noexcept {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+ private:
+    AbstractFifo fifo { capacity };
+    vector<Event> events;
+    std::atomic<int64> dropped { 0 };
+};
+
+// The ring the current thread is tracing into, set for the length of a block by BlockScope
+inline thread_local Ring* currentRing = nullptr;
+
+// Begin/end events for a scope, into the current ring (if any)
+class Scope {
+ public:
+    Scope(const char* scopeName, float value = 0.0f) : name(scopeName), ring(currentRing) {
+        if (ring != nullptr) ring->push(name, 'B', value);
+    }
+
+    ~Scope() {
+        if (ring != nullptr) ring->push(name, 'E');
+    }
+
+ private:
+    const char* name;
+    Ring* ring;
+
+    JUCE_DECLARE_NON_COPYABLE(Scope)
+};
+
+inline void instant(const char* name, float value = 0.0f) {
+    if (currentRing != nullptr) currentRing->push(name, 'i', value);
+}
+
+// Drains every session's ring to the trace file, one per process (shared by the sessions)
+class Tracer : private Thread {
+ public:
+    static constexpr const char* blockEventName = "processBlock";
+
+    Tracer() : Thread("OneRiser trace drain") {
+        const auto envDir = SystemStats::getEnvironmentVariable("ONERISER_TRACE_DIR", {});
+        const auto dir = envDir.isNotEmpty() ? File(envDir)
+                                             : File::getSpecialLocation(File::tempDirectory).getChildFile("OneRiserTraces");
+        dir.createDirectory();
+
+        const auto name = "oneriser-" + Time::getCurrentTime().formatted("%Y%m%d-%H%M%S")
+                        + "-" + String::toHexString(Random::getSystemRandom().nextInt());
+        traceFile = dir.getChildFile(name + ".json");
+        histogramFile = dir.getChildFile(name + "-jitter.csv");
+
+        stream = traceFile.createOutputStream();
+
+        if (stream != nullptr)
+            stream->writeText("[\n", false, false, nullptr);
+
+        startThread(Thread::Priority::low);
+    }
+
+    ~Tracer() override {
+        stopThread(1000);
+        drain();
+        writeHistograms();
+
+        if (stream != nullptr) {
+            // (the process name doubles as the closing event, after the last trailing comma)
+            stream->writeText("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"OneRiser\"}}]\n",
+                              false, false, nullptr);
+            stream->flush();
+        }
+    }
+
+    // Start draining a session's ring, returns its id (its "thread" in the trace)
+    int add(Ring& ring, const std::atomic<double>& sampleRate) {
+        const ScopedLock sl(lock);
+        sessions.push_back({ &ring, &sampleRate, ++lastId });
+
+        writeEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" + String(lastId)
+                   + ",\"args\":{\"name\":\"OneRiser " + String(lastId) + "\"}}");
+        return lastId;
+    }
+
+    // Stop draining a ring (after draining what's left in it)
+    void remove(Ring& ring) {
+        const ScopedLock sl(lock);
+
+        for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+            if (it->ring == &ring) {
+                drainSession(*it);
+                sessions.erase(it);
+                break;
+            }
+        }
+    }
+
+ private:
+    // callback interval deviation, 50 us buckets over +/- 5 ms
+    static constexpr int jitterBucketUs = 50, jitterRangeUs = 5000,
+                         numJitterBuckets = 2 * jitterRangeUs / jitterBucketUs + 1;
+    // time spent in processBlock as a share of the block's length, 5% buckets up to 200%
+    static constexpr int loadBucketPercent = 5, numLoadBuckets = 200 / loadBucketPercent + 1;
+
+    struct SessionState {
+        Ring* ring;
+        const std::atomic<double>* sampleRate;
+        int id;
+
+        int64 lastBlockStart = 0, blockStart = 0;
+        float lastBlockSize = 0.0f;
+        array<int64, numJitterBuckets> jitter {};
+        array<int64, numLoadBuckets> load {};
+    };
+
+    CriticalSection lock;
+    vector<SessionState> sessions;
+    int lastId = 0;
+
+    File traceFile, histogramFile;
+    std::unique_ptr<FileOutputStream> stream;
+
+    void run() override {
+        int drains = 0;
+
+        while (!threadShouldExit()) {
+            wait(100);
+            drain();
+
+            // (the histograms are small, so they're just rewritten every few seconds)
+            if (++drains % 50 == 0)
+                writeHistograms();
+        }
+    }
+
+    void drain() {
+        const ScopedLock sl(lock);
+
+        for (auto& s : sessions)
+            drainSession(s);
+
+        if (stream != nullptr)
+            stream->flush();
+    }
+
+    void drainSession(SessionState& s) {
+        s.ring->drain([&](const Event& e) {
+            const double us = Time::highResolutionTicksToSeconds(e.ticks) * 1.0e6;
+
+            writeEvent("{\"name\":\"" + String(e.name) + "\",\"ph\":\"" + String::charToString(e.phase)
+                       + "\",\"ts\":" + String(us, 3) + ",\"pid\":0,\"tid\":" + String(s.id)
+                       + (e.phase == 'E' ? String() : ",\"args\":{\"value\":" + String(e.value) + "}")
+                       + (e.phase == 'i' ? ",\"s\":\"t\"}" : "}"));
+
+            if (std::strcmp(e.name, blockEventName) == 0)
+                addBlockEvent(s, e);
+        });
+    }
+
+    void addBlockEvent(SessionState& s, const Event& e) {
+        const double rate = s.sampleRate->load();
+
+        if (e.phase == 'B') {
+            // how late (or early) this callback came, given the length of the previous block
+            if (s.lastBlockStart != 0 && rate > 0.0) {
+                const double interval = Time::highResolutionTicksToSeconds(e.ticks - s.lastBlockStart);
+                const double deviationUs = (interval - s.lastBlockSize / rate) * 1.0e6;
+                const int bucket = roundToInt(jlimit(-double(jitterRangeUs), double(jitterRangeUs), deviationUs)
+                                              / jitterBucketUs) + jitterRangeUs / jitterBucketUs;
+                s.jitter[size_t(bucket)]++;
+            }
+
+            s.lastBlockStart = s.blockStart = e.ticks;
+            s.lastBlockSize = e.value;
+        }
+        else if (e.phase == 'E' && s.blockStart != 0 && rate > 0.0 && s.lastBlockSize > 0.0f) {
+            const double duration = Time::highResolutionTicksToSeconds(e.ticks - s.blockStart);
+            const double percent = 100.0 * duration / (s.lastBlockSize / rate);
+            s.load[size_t(jmin(numLoadBuckets - 1, int(percent) / loadBucketPercent))]++;
+        }
+    }
+
+    void writeEvent(const String& json) {
+        if (stream != nullptr)
+            stream->writeText(json + ",\n", false, false, nullptr);
+    }
+
+    void writeHistograms() {
+        const ScopedLock sl(lock);
+        String csv = "instance,histogram,bucket,count\n";
+
+        for (const auto& s : sessions) {
+            for (size_t i = 0; i < s.jitter.size(); i++)
+                if (s.jitter[i] > 0)
+                    csv << s.id << ",jitter_us," << (int(i) * jitterBucketUs - jitterRangeUs) << "," << s.jitter[i] << "\n";
+
+            for (size_t i = 0; i < s.load.size(); i++)
+                if (s.load[i] > 0)
+                    csv << s.id << ",load_percent," << (int(i) * loadBucketPercent) << "," << s.load[i] << "\n";
+
+            if (s.ring->getNumDropped() > 0)
+                csv << s.id << ",dropped_events,0," << s.ring->getNumDropped() << "\n";
+        }
+
+        histogramFile.replaceWithText(csv);
+    }
+};
+
+// One plugin instance's tracing (create it on the message thread)
+class Session {
+ public:
+    Session() {
+        tracer->add(ring, sampleRate);
+    }
+
+    ~Session() {
+        tracer->remove(ring);
+    }
+
+    void setSampleRate(double newSampleRate) {
+        sampleRate.store(newSampleRate);
+    }
+
+    Ring& getRing() noexcept {
+        return ring;
+    }
+
+ private:
+    SharedResourcePointer<Tracer> tracer;
+    Ring ring;
+    std::atomic<double> sampleRate { 0.0 };
+};
+
+// Traces a whole block, and points the thread's scopes at the session's ring meanwhile
+class BlockScope {
+ public:
+    BlockScope(Session& session, int numSamples) : ring(session.getRing()) {
+        currentRing = &ring;
+        ring.push(Tracer::blockEventName, 'B', float(numSamples));
+    }
+
+    ~BlockScope() {
+        ring.push(Tracer::blockEventName, 'E');
+        currentRing = nullptr;
+    }
+
+ private:
+    Ring& ring;
+
+    JUCE_DECLARE_NON_COPYABLE(BlockScope)
+};
+
+} // end namespace pa::trace
+
+ #define PA_TRACE_CONCAT_(a, b) a##b
+ #define PA_TRACE_CONCAT(a, b) PA_TRACE_CONCAT_(a, b)
+
+ #define PA_TRACE_BLOCK(session, numSamples) pa::trace::BlockScope PA_TRACE_CONCAT(paTraceBlock, __LINE__) (session, numSamples)
+ #define PA_TRACE_SCOPE(name) pa::trace::Scope PA_TRACE_CONCAT(paTraceScope, __LINE__) (name)
+ #define PA_TRACE_INSTANT(name, value) pa::trace::instant(name, value)
+#else
+ #define PA_TRACE_BLOCK(session, numSamples)
+ #define PA_TRACE_SCOPE(name)
+ #define PA_TRACE_INSTANT(name, value)
+#endif
@@ -17,6 +17,9 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <type_traits>
+#include <memory_resource>
+#include "Kernels.h"
 using namespace juce;
 using std::array, std::vector;
 using uint = unsigned int;
@@ -155,8 +158,50 @@ static FloatType expRounder(const FloatType &input, const FloatType& curveValue)
     return 0;
 }
 
+                // Denormals
+// Values below this are flushed to zero in the processors' feedback paths (around -600 dBFS),
+// so decaying tails reach zero rather than lingering as denormals, whatever the FPU's flush
+// modes are (e.g. outside ScopedNoDenormals, in tests and other hosts)
+static constexpr float denormalThreshold = dsp::kernels::denormalThreshold;
+
+// Returns the value, or 0 if it's small enough to be headed for denormals
+template <typename FloatType>
+static inline FloatType flushDenormal(const FloatType& value) {
+    return (std::abs(value) < FloatType(denormalThreshold)) ? FloatType(0) : value;
+}
+
 } // end namespace math
 
+                // State snapshots
+// Raw reads and writes of processor state (see RiserProcessor::writeSnapshot()) — the
+// bytes are native, so a snapshot is only meant to be read back by the same build
+namespace state {
+template <typename Type>
+static void write(OutputStream& stream, const Type& value) {
+    static_assert(std::is_trivially_copyable_v<Type>);
+    stream.write(&value, sizeof(Type));
+}
+
+template <typename Type>
+static bool read(InputStream& stream, Type& value) {
+    static_assert(std::is_trivially_copyable_v<Type>);
+    return stream.read(&value, int(sizeof(Type))) == int(sizeof(Type));
+}
+
+template <typename Type>
+static void writeArray(OutputStream& stream, const Type* values, size_t numValues) {
+    static_assert(std::is_trivially_copyable_v<Type>);
+    stream.write(values, numValues * sizeof(Type));
+}
+
+template <typename Type>
+static bool readArray(InputStream& stream, Type* values, size_t numValues) {
+    static_assert(std::is_trivially_copyable_v<Type>);
+    const auto numBytes = int(numValues * sizeof(Type));
+    return stream.read(values, numBytes) == numBytes;
+}
+} // end namespace state
+
                 // DSP
 namespace dsp {
 // Different interpolation enums for general use
@@ -168,9 +213,14 @@ enum InterpolationType {
     hermiteInterp
 };
 
+// Alignment of every buffer allocated through a memory resource (a cache line, and an AVX-512 register)
+static constexpr size_t memoryAlignment = 64;
+
 // A block of memory on the heap, useful for buffers
 // Mostly a piece-for-piece copy of the JUCE version minus some
 // stuff so I could see how it worked
+// - the memory comes from a std::pmr::memory_resource (the default one unless another is set),
+//   aligned to memoryAlignment
 template <typename ElementType>
 class HeapBlock {
  public:
@@ -181,18 +231,26 @@ class HeapBlock {
         this->allocate(numElements, initialise);
     }
 
-    HeapBlock(HeapBlock&& copy) noexcept : data(copy.data), size(copy.size) {
+    HeapBlock(HeapBlock&& copy) noexcept : data(copy.data), size(copy.size), resource(copy.resource) {
         copy.data = nullptr;
+        copy.size = 0;
     }
 
-    ~HeapBlock() { std::free(data); }
+    ~HeapBlock() { free(); }
 
     HeapBlock& operator= (HeapBlock&& copy) noexcept {
         std::swap(data, copy.data);
-        size = copy.size;
+        std::swap(size, copy.size);
+        std::swap(resource, copy.resource);
         return *this;
     }
 
+    // Set where the memory comes from (this frees any memory from the previous resource)
+    void setMemoryResource(std::pmr::memory_resource* newResource) {
+        free();
+        resource = newResource != nullptr ? newResource : std::pmr::get_default_resource();
+    }
+
     // return the data pointer
     [[nodiscard]] inline ElementType* get() const noexcept {
         return data;
@@ -218,25 +276,33 @@ class HeapBlock {
     // allocate new memory
     template <typename SizeType>
     void allocate(const SizeType& newNumElements, const bool& initialise = true) {
-        if (data != nullptr)
-            std::free(data);
+        free();
+
+        data = allocateElements(uint(newNumElements));
+        size = uint(newNumElements);
 
-        data = (ElementType*)(initialise ? std::calloc(size_t(newNumElements), sizeof(ElementType))
-                                         : std::malloc(size_t(newNumElements) * sizeof(ElementType)));
-        size = newNumElements;
+        if (initialise)
+            this->initialise();
     }
 
     // reallocate memory - retain as much existing data as possible
     template <typename SizeType>
     void reallocate(const SizeType& newNumElements) {
-        data = (ElementType*)(data == nullptr ? std::malloc(size_t(newNumElements) * sizeof(ElementType))
-                                              : std::realloc(data, size_t(newNumElements) * sizeof(ElementType)));
-        size = newNumElements;
+        auto* newData = allocateElements(uint(newNumElements));
+
+        if (data != nullptr)
+            std::copy_n(data, jmin(size, uint(newNumElements)), newData);
+
+        free();
+        data = newData;
+        size = uint(newNumElements);
     }
 
     // free the memory
     void free() noexcept {
-        std::free(data);
+        if (data != nullptr)
+            resource->deallocate(data, size_t(size) * sizeof(ElementType), memoryAlignment);
+
         data = nullptr;
         size = 0;
     }
@@ -250,11 +316,180 @@ class HeapBlock {
  private:
     ElementType* data = nullptr;
     uint size = 0;
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+    ElementType* allocateElements(uint numElements) {
+        if (numElements == 0) return nullptr;
+
+        return static_cast<ElementType*>(resource->allocate(size_t(numElements) * sizeof(ElementType), memoryAlignment));
+    }
+};
+
+// A memory resource that hands out aligned pieces of one block, taken from an upstream resource
+// - deallocating is a no-op (the block is only returned as a whole, by reset()), so it suits
+//   buffers that are allocated together and live as long as each other, like a processor's
+// - anything that doesn't fit comes from the upstream resource instead, but is still counted,
+//   so a first pass with no block measures how big the block needs to be
+class MemoryArena : public std::pmr::memory_resource {
+ public:
+    explicit MemoryArena(std::pmr::memory_resource* upstreamResource = nullptr) {
+        setUpstream(upstreamResource);
+    }
+
+    ~MemoryArena() override {
+        reset(0);
+    }
+
+    // Set where the block comes from (this frees the block)
+    void setUpstream(std::pmr::memory_resource* newUpstream) {
+        reset(0);
+        upstream = newUpstream != nullptr ? newUpstream : std::pmr::get_default_resource();
+    }
+
+    // Replace the block with one of numBytes (0 for none), and start counting again
+    // - everything allocated from the old block must have been freed
+    void reset(size_t numBytes) {
+        if (block != nullptr)
+            upstream->deallocate(block, capacity, memoryAlignment);
+
+        block = numBytes > 0 ? static_cast<char*>(upstream->allocate(numBytes, memoryAlignment)) : nullptr;
+        capacity = block != nullptr ? numBytes : 0;
+        used = 0;
+    }
+
+    size_t getCapacity() const noexcept {
+        return capacity;
+    }
+
+    // Everything allocated since the last reset (with alignment padding), in or out of the block
+    size_t getBytesAllocated() const noexcept {
+        return used;
+    }
+
+ private:
+    std::pmr::memory_resource* upstream = nullptr;
+    char* block = nullptr;
+    size_t capacity = 0, used = 0;
+
+    void* do_allocate(size_t numBytes, size_t alignment) override {
+        const size_t offset = (used + alignment - 1) / alignment * alignment;
+        used = offset + numBytes;
+
+        if (used <= capacity && alignment <= memoryAlignment)
+            return block + offset;
+
+        return upstream->allocate(numBytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t numBytes, size_t alignment) override {
+        const bool inBlock = block != nullptr && p >= block && static_cast<char*>(p) < block + capacity;
+
+        if (!inBlock)
+            upstream->deallocate(p, numBytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Linear smoother, which behaves (and rounds) exactly as juce::SmoothedValue's linear
+// smoothing does, but whose whole state can be saved and restored
+template <typename FloatType>
+class SmoothValue {
+ public:
+    SmoothValue() = default;
+    SmoothValue(FloatType initialValue) : current(initialValue), target(initialValue) {}
+
+    // Set the ramp length, which stops any ramp in progress
+    void reset(double sampleRate, double rampLengthInSeconds) {
+        stepsToTarget = int(std::floor(rampLengthInSeconds * sampleRate));
+        setCurrentAndTargetValue(target);
+    }
+
+    void setCurrentAndTargetValue(FloatType newValue) {
+        target = current = newValue;
+        countdown = 0;
+    }
+
+    void setTargetValue(FloatType newValue) {
+        if (newValue == target) return;
+
+        if (stepsToTarget <= 0) {
+            setCurrentAndTargetValue(newValue);
+            return;
+        }
+
+        target = newValue;
+        countdown = stepsToTarget;
+        step = (target - current) / FloatType(countdown);
+    }
+
+    FloatType getNextValue() {
+        if (!isSmoothing()) return target;
+
+        if (--countdown > 0)
+            current += step;
+        else
+            current = target;
+
+        return current;
+    }
+
+    // Fill a block with the next numSamples values, exactly as that many getNextValue() calls
+    // - the ramp stays a running sum, as multiplying its steps out rounds differently, and the
+    //   reverb's feedback recirculates that (to around -90 dB)
+    void getNextValues(FloatType* dest, int numSamples) {
+        const int numRamp = jlimit(0, numSamples, countdown - 1);
+
+        for (int i = 0; i < numRamp; i++)
+            dest[i] = (current += step);
+
+        countdown -= numRamp;
+
+        // (the ramp's last step always lands on the target)
+        if (numRamp < numSamples) {
+            std::fill_n(dest + numRamp, numSamples - numRamp, target);
+            current = target;
+            countdown = 0;
+        }
+    }
+
+    bool isSmoothing() const noexcept {
+        return countdown > 0;
+    }
+
+    FloatType getCurrentValue() const noexcept {
+        return current;
+    }
+
+    FloatType getTargetValue() const noexcept {
+        return target;
+    }
+
+    void writeState(OutputStream& stream) const {
+        for (auto value : { current, target, step })
+            state::write(stream, value);
+
+        state::write(stream, countdown);
+        state::write(stream, stepsToTarget);
+    }
+
+    bool readState(InputStream& stream) {
+        return state::read(stream, current) && state::read(stream, target) && state::read(stream, step)
+            && state::read(stream, countdown) && state::read(stream, stepsToTarget);
+    }
 
+ private:
+    FloatType current = 0, target = 0, step = 0;
+    int countdown = 0, stepsToTarget = 0;
 };
 
 // Ring (AKA circular) buffer, a classic method for creating delay
 // uint is only used to prevent negative values
+// - clearing is constant time: the buffer isn't zeroed, the write pointer just restarts from 0
+//   and everything from it onwards reads as silence until it's been written again (only the
+//   first pass after a clear pays the check, the block reads take the scalar path until then)
 template <typename FloatType>
 class RingBuffer {
  public:
@@ -263,20 +498,26 @@ class RingBuffer {
     void prepare(uint newBufferSizeSamples, const uint& newSampleRate) {
         pa::math::setClamp<uint>(&newBufferSizeSamples, 0, newBufferSizeSamples * newSampleRate * 10);
 
-        if (newBufferSizeSamples != size) {
-            pa::math::setClamp<uint>(&newBufferSizeSamples, 0, newSampleRate * 600);
-            writeIndex = 0;
-            buffer.reallocate(newBufferSizeSamples);
+        pa::math::setClamp<uint>(&newBufferSizeSamples, 0, newSampleRate * 600);
+
+        // only allocate when the size actually changes, the existing memory is reused otherwise
+        // (nothing is zeroed either way, a cleared buffer reads as silence)
+        if (newBufferSizeSamples != size || buffer.get() == nullptr) {
+            buffer.allocate(newBufferSizeSamples, false);
             size = newBufferSizeSamples;
         }
 
+        clear();
+
         if (newSampleRate != sampleRate)
             sampleRate = newSampleRate;
 
         if (sampleRate == 0)
             sampleRate = 1;
 
-        clear();
+        // apply any delay time that was set before the buffer existed
+        delayTime.reset(sampleRate, delaySmoothTime);
+        delayTime.setCurrentAndTargetValue(clampDelayTime(requestedDelayTime));
     }
 
     void prepare(FloatType newBufferSizeSeconds, const uint& newSampleRate) {
@@ -285,12 +526,28 @@ class RingBuffer {
         prepare(bufferSize, newSampleRate);
     }
 
-    // Set all elements to 0
+    // Free the buffer's memory, prepare() must be called again before use
+    void release() {
+        buffer.free();
+        size = 0;
+        writeIndex = 0;
+        validEnd = 0;
+    }
+
+    // Set where the buffer's memory comes from (this frees it, like release())
+    void setMemoryResource(std::pmr::memory_resource* resource) {
+        release();
+        buffer.setMemoryResource(resource);
+    }
+
+    // Set all elements to 0 (in constant time, see above)
     void clear() {
-        buffer.initialise();
+        writeIndex = 0;
+        validEnd = 0;
     }
 
     // Set the delay created within the buffer
+    // - this can be called before prepare(), the time is applied once the buffer exists
     void setDelayTime(FloatType newDelayTime, FloatType smoothTime = 0.1f) {
         if (smoothTime != delaySmoothTime) {
             pa::math::setClamp(&smoothTime, 0.0f, smoothTime);
@@ -298,9 +555,9 @@ class RingBuffer {
             delayTime.reset(sampleRate, delaySmoothTime);
         }
 
-        newDelayTime = pa::math::clamp(abs(newDelayTime), 0.0f, FloatType(size) / FloatType(sampleRate));
+        requestedDelayTime = abs(newDelayTime);
 
-        delayTime.setTargetValue(newDelayTime);
+        delayTime.setTargetValue(clampDelayTime(requestedDelayTime));
     }
 
     // Simultaneously read from and push to the buffer
@@ -353,23 +610,141 @@ class RingBuffer {
         incrementWritePointer();
     }
 
+    // Write the buffer's contents, position and delay smoothing (for snapshots)
+    void writeState(OutputStream& stream) const {
+        state::write(stream, size);
+        state::write(stream, writeIndex);
+        state::write(stream, delaySmoothTime);
+        state::write(stream, requestedDelayTime);
+        delayTime.writeState(stream);
+
+        // (only the part that's been written since a clear, the rest is silence whatever's in memory)
+        state::write(stream, validEnd);
+        state::writeArray(stream, buffer.get(), validEnd);
+    }
+
+    // Read back a state from writeState(), returns false (leaving the buffer cleared) if it
+    // doesn't fit this buffer, as prepared
+    bool readState(InputStream& stream) {
+        uint stateSize = 0;
+
+        const bool valid = state::read(stream, stateSize) && stateSize == size
+                        && state::read(stream, writeIndex) && writeIndex < jmax(1u, size)
+                        && state::read(stream, delaySmoothTime) && state::read(stream, requestedDelayTime)
+                        && delayTime.readState(stream)
+                        && state::read(stream, validEnd) && validEnd <= size
+                        && (validEnd == size || writeIndex == validEnd)
+                        && state::readArray(stream, buffer.get(), validEnd);
+
+        if (!valid)
+            clear();
+
+        return valid;
+    }
+
+    // Call visit() with every sample held in the buffer (as writeState() writes them, e.g. for
+    // tests to check that nothing fed back has gone denormal)
+    template <typename Visitor>
+    void visitState(Visitor&& visit) const {
+        for (uint i = 0; i < validEnd; i++)
+            visit(buffer[i]);
+    }
+
     // Force the write pointer to increment, if needed
     void forceIncrementWritePointer() {
         incrementWritePointer();
     }
 
+                // Block processing
+    // Fill a block with the (smoothed) delay time in samples, advancing the smoothing
+    void getDelaySamples(FloatType* dest, int numSamples) {
+        const auto rate = static_cast<FloatType>(sampleRate);
+
+        // (most of the time the delay isn't moving at all)
+        if (!delayTime.isSmoothing()) {
+            std::fill_n(dest, numSamples, rate * delayTime.getTargetValue());
+            return;
+        }
+
+        for (int i = 0; i < numSamples; i++)
+            dest[i] = rate * delayTime.getNextValue();
+    }
+
+    // Read a block of delayed samples, each at its own delay (in samples) — the same
+    // reads as numSamples calls to getFromBuffer() with a push in between each
+    // - every delay must be longer than the block, so none of the reads land on
+    //   samples that are only pushed during it (see pushBlockToBuffer())
+    void getBlockFromBuffer(FloatType* dest, const FloatType* delaySamples,
+                            int numSamples, const InterpolationType interp) {
+        // (the kernels read memory directly, so they have to wait until it's all been written)
+        if constexpr (std::is_same_v<FloatType, float>) {
+            if (validEnd == size) {
+                const auto& kernels = pa::dsp::kernels::get();
+                const float* data = buffer.get();
+
+                if (interp == linearInterp)
+                    kernels.readLinear(dest, data, delaySamples, writeIndex, size, numSamples);
+                else
+                    kernels.readNearest(dest, data, delaySamples, writeIndex, size, numSamples);
+
+                return;
+            }
+        }
+
+        if (interp == linearInterp) {
+            for (int i = 0; i < numSamples; i++) {
+                const FloatType readOffset = delaySamples[i];
+                const uint index = wrapIndex(writeIndex + uint(i) + size - uint(readOffset));
+                const uint previous = (index == 0) ? size - 1 : index - 1;
+                const FloatType t = pa::math::mod1(readOffset);
+
+                dest[i] = readAt(index) + t * (readAt(previous) - readAt(index));
+            }
+        }
+        else {
+            for (int i = 0; i < numSamples; i++)
+                dest[i] = readAt(wrapIndex(writeIndex + uint(i) + size - uint(delaySamples[i])));
+        }
+    }
+
+    // Push a block of samples to the buffer (increments the write pointer past them)
+    void pushBlockToBuffer(const FloatType* input, int numSamples) {
+        if (input == nullptr || size == 0) return;
+
+        while (numSamples > 0) {
+            const int toEnd = jmin(numSamples, int(size - writeIndex));
+            std::copy_n(input, toEnd, buffer.get() + writeIndex);
+
+            writeIndex += uint(toEnd);
+            if (writeIndex >= size) {
+                writeIndex -= size;
+                validEnd = size;
+            }
+
+            validEnd = jmax(validEnd, writeIndex);
+
+            input += toEnd;
+            numSamples -= toEnd;
+        }
+    }
+
  private:
     HeapBlock<FloatType> buffer;
     uint size = 0, writeIndex = 0, sampleRate = 44100;
-    FloatType delaySmoothTime = 0.0;
-    juce::SmoothedValue<FloatType> delayTime = 0.0;
+    uint validEnd = 0; // everything from here on reads as 0 (size once it's all been written)
+    FloatType delaySmoothTime = 0.0, requestedDelayTime = 0.0;
+    SmoothValue<FloatType> delayTime = 0.0;
+
+    FloatType clampDelayTime(FloatType newDelayTime) const {
+        return pa::math::clamp(newDelayTime, FloatType(0), FloatType(size) / FloatType(sampleRate));
+    }
 
     FloatType getFromBufferNoInterp() {
         const FloatType delay = delayTime.getNextValue();
         uint readOffset = uint(FloatType(sampleRate) * delay);
         uint readIndex = getReadIndex(readOffset);
 
-        return buffer[readIndex];
+        return readAt(readIndex);
     }
 
     FloatType getFromBufferLinearInterp() {
@@ -377,7 +752,8 @@ class RingBuffer {
         FloatType readOffset = static_cast<FloatType>(sampleRate) * delay;
         uint readIndex = getReadIndex(readOffset);
 
-        return pa::math::linearInterp(buffer[readIndex], buffer[readIndex - 1], pa::math::mod1(readOffset));
+        return pa::math::linearInterp(readAt(readIndex), readAt(wrapIndex(readIndex + size - 1)),
+                                      pa::math::mod1(readOffset));
     }
 
     FloatType getFromBufferCubicInterp() {
@@ -388,14 +764,19 @@ class RingBuffer {
 
         uint readIndex = getReadIndex(readOffset);
 
-        FloatType s1 = buffer[readIndex + 1],
-                  s2 = buffer[readIndex],
-                  s3 = buffer[readIndex - 1],
-                  s4 = buffer[readIndex - 2];
+        // (neighbours wrap around the buffer's ends)
+        FloatType s1 = readAt(wrapIndex(readIndex + 1)),
+                  s2 = readAt(readIndex),
+                  s3 = readAt(wrapIndex(readIndex + size - 1)),
+                  s4 = readAt(wrapIndex(readIndex + size - 2));
 
         return pa::math::cubicInterp(s1, s2, s3, s4, pa::math::mod1(readOffset), true);
     }
 
+    FloatType readAt(uint index) const {
+        return (index < validEnd) ? buffer[index] : FloatType(0);
+    }
+
     uint getReadIndex(const uint& readOffset) const {
         uint tmp = writeIndex - readOffset + size;
         if (tmp >= size)
@@ -404,17 +785,24 @@ class RingBuffer {
         return tmp;
     }
 
+    // wraps an index that's less than 3 * size
+    uint wrapIndex(uint index) const {
+        if (index >= size) index -= size;
+        if (index >= size) index -= size;
+
+        return index;
+    }
+
     void incrementWritePointer() {
         // writeIndex = (writeIndex + 1) % size;
-        if (++writeIndex >= size)
+        if (++writeIndex >= size) {
             writeIndex -= size;
+            validEnd = size;
+        }
+
+        validEnd = jmax(validEnd, writeIndex);
     }
 };
 
-/*template <typename FloatType, InterpolationType Interp = noInterp>
-class SmoothValue {
-
-};*/
-
 } // end namespace dsp
 } // end namespace pa
\ No newline at end of file
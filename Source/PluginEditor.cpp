@@ -1,7 +1,8 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
-OneRiserEditor::OneRiserEditor(OneRiserProcessor& p) : AudioProcessorEditor(&p), processorRef(p) {
+OneRiserEditor::OneRiserEditor(OneRiserProcessor& p)
+ : AudioProcessorEditor(&p), processorRef(p), spectrumDisplay(p.signalFeed) {
     // set look/feel knob states
     smallKnobLookFeel.knobType = KnobAppearance::small;
     largeKnobLookFeel.knobType = KnobAppearance::large;
@@ -16,11 +17,8 @@ OneRiserEditor::OneRiserEditor(OneRiserProcessor& p) : AudioProcessorEditor(&p),
     masterAttachment =  std::make_unique<AudioProcessorValueTreeState::SliderAttachment>
                         (processorRef.parameters, "MAS_AMT", masterKnob);
 
-    // set font and background image from binary
-    fontMuli = Typeface::createSystemTypefaceFor
-        (BinaryData::MuliBold_ttf, BinaryData::MuliBold_ttfSize);
-    backgroundImage = ImageFileFormat::loadFrom
-        (BinaryData::Background2_5_png, BinaryData::Background2_5_pngSize);
+    // set font from the shared (already decoded) typeface
+    fontMuli = Font(assets->getTypeface());
 
     // functions for when a knob's value is changed
     flangerKnob.onValueChange = [&]() { onKnobChange(flangerKnob, flangerAmount, flangerEnabled); };
@@ -55,6 +53,19 @@ OneRiserEditor::OneRiserEditor(OneRiserProcessor& p) : AudioProcessorEditor(&p),
     setKnob(filterKnob, filterAmount);
     setKnob(masterKnob, masterAmount, false);
 
+    addAndMakeVisible(spectrumDisplay);
+
+    // (the attachment's callback comes on the message thread, whichever thread the level changed on)
+    qualityNotice.setJustificationType(Justification::centred);
+    qualityNotice.setColour(Label::textColourId, Colours::grey);
+    qualityNotice.setTooltip("The processor is short of CPU time, so it's running a lighter reverb and flanger\n"
+                             "It returns to full quality once there's headroom again (see \"Adaptive Quality\")");
+    addChildComponent(qualityNotice);
+
+    qualityAttachment = std::make_unique<ParameterAttachment>(*processorRef.parameters.getParameter("GOV_LVL"),
+                                                              [this](float) { showQualityLevel(); });
+    qualityAttachment->sendInitialUpdate();
+
     // set reset values
     const auto resetKey = ModifierKeys::commandModifier;
     flangerKnob.setDoubleClickReturnValue(true, 0.65f, resetKey);
@@ -81,15 +92,22 @@ OneRiserEditor::OneRiserEditor(OneRiserProcessor& p) : AudioProcessorEditor(&p),
     setResizeLimits(320, int(320 / ratio), 440, int(440 / ratio));
     getConstrainer()->setFixedAspectRatio(ratio);
     setSize(320, 440);
+
+    // the cached background covers the whole editor, so nothing behind it needs repainting
+    setOpaque(true);
 }
 
 OneRiserEditor::~OneRiserEditor() = default;
 
 void OneRiserEditor::paint(juce::Graphics& g) {
-    // Fill the background with a solid colour
-    g.fillAll(getLookAndFeel().findColour(ResizableWindow::backgroundColourId));
+    // the background is only rescaled when the editor size (or display scale) changes
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    const int w = roundToInt(float(getWidth()) * scale), h = roundToInt(float(getHeight()) * scale);
 
-    g.drawImageWithin(backgroundImage, 0, 0, getWidth(), getHeight(), RectanglePlacement::centred);
+    if (backgroundCache == nullptr || backgroundCache->getWidth() != w || backgroundCache->getHeight() != h)
+        backgroundCache = assets->getScaledBackground(w, h, getLookAndFeel().findColour(ResizableWindow::backgroundColourId));
+
+    g.drawImageTransformed(*backgroundCache, AffineTransform::scale(1.0f / scale));
 }
 
 void OneRiserEditor::resized() {
@@ -113,6 +131,12 @@ void OneRiserEditor::resized() {
     masterKnob.setBounds(w / 2 - largeKnobSize / 2, h / 2 - float(h) / 3.75f, largeKnobSize, largeKnobSize);
     masterAmount.setBounds(w / 2 - labelWidth / 2, h / 2 + h / 28, labelWidth, float(smallKnobSize) / 2.5f);
 
+    // a thin strip along the top edge
+    qualityNotice.setBounds(w / 20, h / 40, w - w / 10, h / 20);
+
+    // a thin strip along the bottom edge, below the labels
+    spectrumDisplay.setBounds(w / 20, h - h / 12, w - w / 10, h / 16);
+
     /*auto centreSpace = getLocalBounds(), bottomSpace = getLocalBounds();
     auto masterSpace = centreSpace.removeFromTop(static_cast<int>(getHeight() * 0.75));
 
@@ -157,23 +181,13 @@ void OneRiserEditor::onKnobChange(Slider& knob, Label& label, bool& enabledState
     else
         valStr = String::toDecimalStringWithSignificantFigures(val * 100, 3) + " %";
 
+    // (both of these only repaint the label when something actually changed)
     label.setColour(Label::textColourId, isZero ? Colours::grey : Colours::white);
     label.setText(valStr, dontSendNotification);
 }
 
-// Used to pass the parameter values to the processor
+// Used to update the editor when a value changes (the processor reads the parameters itself, every block)
 void OneRiserEditor::valueChanged() {
-    // references for shorthand
-    auto& pr = processorRef;
-    auto& params = pr.parameters;
-
-    auto flangerAmt = params.getRawParameterValue("FLG_AMT")->load(),
-         filterAmt  = params.getRawParameterValue("FIL_AMT")->load(),
-         reverbAmt  = params.getRawParameterValue("REV_AMT")->load(),
-         masterAmt  = params.getRawParameterValue("MAS_AMT")->load();
-
-    pr.riserProcessor.setParameters(flangerAmt, filterAmt, reverbAmt, masterAmt);
-
     checkMasterLabelState();
 }
 
@@ -221,10 +235,19 @@ void OneRiserEditor::setLabelFonts() {
     filterAmount.setFont(fontMuli);
     flangerAmount.setFont(fontMuli);
     masterAmount.setFont(fontMuli);
+    qualityNotice.setFont(fontMuli.withHeight(fontMuli.getHeight() * 0.6f));
 }
 
 // Used to grey out the master label if all the small knobs are disabled
 void OneRiserEditor::checkMasterLabelState() {
     bool anyEnabled = reverbEnabled || filterEnabled || flangerEnabled;
     masterAmount.setColour(Label::textColourId, anyEnabled ? Colours::white : Colours::grey);
+}
+
+// Used to show the processor's quality level, when it's below full
+void OneRiserEditor::showQualityLevel() {
+    const auto* level = processorRef.parameters.getParameter("GOV_LVL");
+
+    qualityNotice.setText(level->getCurrentValueAsText() + " quality", dontSendNotification);
+    qualityNotice.setVisible(level->getValue() > 0.0f);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "PluginProcessor.h"
+#include "Components/SpectrumDisplay.h"
 
 class OneRiserEditor : public juce::AudioProcessorEditor {
 public:
@@ -15,6 +16,7 @@ public:
     static void onLabelChange(Slider& knob, Label& label);
     void setLabelFonts();
     void checkMasterLabelState();
+    void showQualityLevel();
 
  private:
     OneRiserProcessor& processorRef;
@@ -23,10 +25,16 @@ public:
     // because they all have slightly different requirements
     Slider flangerKnob, filterKnob, reverbKnob, masterKnob;
     Label flangerAmount, filterAmount, reverbAmount, masterAmount;
+    SpectrumDisplay spectrumDisplay;
+
+    // only shown while the processor has reduced its quality under CPU load (see CpuGovernor.h)
+    Label qualityNotice;
 
     KnobAppearance smallKnobLookFeel, largeKnobLookFeel;
     TooltipWindow tooltipWindow;
-    Image backgroundImage;
+    // the decoded assets and scaled backgrounds are shared by every instance in the process
+    SharedResourcePointer<SharedAssets> assets;
+    std::shared_ptr<const Image> backgroundCache;
     Font fontMuli;
 
     // used to track the state of all the smaller knobs so the master label can
@@ -38,5 +46,8 @@ public:
     std::unique_ptr<AudioProcessorValueTreeState::SliderAttachment> flangerAttachment,
                                    filterAttachment, reverbAttachment, masterAttachment;
 
+    // follows the quality the processor is currently at
+    std::unique_ptr<ParameterAttachment> qualityAttachment;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OneRiserEditor)
 };
\ No newline at end of file
@@ -1,6 +1,40 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace {
+// Binary state format: a small header followed by the parameter values, in the
+// order below. New parameters are only ever appended, so older states set their
+// missing parameters to the defaults (and newer states' extra values are skipped)
+constexpr int stateMagic = 0x7453524f; // "ORSt"
+
+constexpr std::array stateParameterIDs { "MAS_AMT", "FLG_AMT", "FIL_AMT", "REV_AMT",
+                                         "LFO_RTE", "LFO_DPT", "LFO_PHS", "LFO_SYN", "LFO_DIV",
+                                         "REV_DEC", "FX_ORD", "REV_PIP", "REV_BUS", "GOV_ON" };
+
+// The number of values each version of the format holds, from version 1 — any change to the
+// list above adds a version here
+constexpr std::array stateVersionSizes { 4,  // 1: the amounts
+                                         9,  // 2: + the LFO
+                                         10, // 3: + multirate reverb
+                                         11, // 4: + effect order
+                                         12, // 5: + pipelined reverb
+                                         13, // 6: + shared reverb bus
+                                         14  // 7: + adaptive quality
+                                       };
+
+constexpr int stateVersion = int(stateVersionSizes.size());
+static_assert(stateVersionSizes.back() == int(stateParameterIDs.size()), "the state IDs changed without a new version");
+
+// Tempo-synced LFO cycle lengths, in beats (matching the "LFO_DIV" choices)
+constexpr std::array lfoDivisionBeats { 0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f };
+
+// At the CPU governor's lowest level, the parameters are only passed on every this many blocks
+constexpr int coarseParameterInterval = 4;
+
+// How often the message thread checks for anything the audio thread has left it to do
+constexpr int updateRateHz = 30;
+}
+
 OneRiserProcessor::OneRiserProcessor()
  : AudioProcessor(
     BusesProperties()
@@ -12,9 +46,42 @@ OneRiserProcessor::OneRiserProcessor()
      #endif
  ),
  // the parameters object is passed its arguments here
- parameters(*this, nullptr, "Parameters", createParameters()) {}
+ parameters(*this, nullptr, "Parameters", createParameters()) {
+    masterAmount  = parameters.getRawParameterValue("MAS_AMT");
+    flangerAmount = parameters.getRawParameterValue("FLG_AMT");
+    filterAmount  = parameters.getRawParameterValue("FIL_AMT");
+    reverbAmount  = parameters.getRawParameterValue("REV_AMT");
+
+    lfoRate     = parameters.getRawParameterValue("LFO_RTE");
+    lfoDepth    = parameters.getRawParameterValue("LFO_DPT");
+    lfoPhase    = parameters.getRawParameterValue("LFO_PHS");
+    lfoSync     = parameters.getRawParameterValue("LFO_SYN");
+    lfoDivision = parameters.getRawParameterValue("LFO_DIV");
+
+    reverbMultirate = parameters.getRawParameterValue("REV_DEC");
+    reverbPipelined = parameters.getRawParameterValue("REV_PIP");
+    reverbShared    = parameters.getRawParameterValue("REV_BUS");
+    effectOrder     = parameters.getRawParameterValue("FX_ORD");
+
+    governorEnabled = parameters.getRawParameterValue("GOV_ON");
+    qualityLevel    = parameters.getParameter("GOV_LVL");
+
+   #if ONERISER_TRACING
+    for (const auto* id : stateParameterIDs) {
+        tracedParameters.push_back({ id, parameters.getRawParameterValue(id) });
+        tracedValues.push_back(tracedParameters.back().second->load());
+    }
+   #endif
+
+    startTimerHz(updateRateHz);
+}
 
-OneRiserProcessor::~OneRiserProcessor() = default;
+OneRiserProcessor::~OneRiserProcessor() {
+    stopTimer();
+
+    // (leave the shared reverb while it's certainly still there)
+    processors.forEach([](RiserProcessor& p) { p.setReverbBus(nullptr); });
+}
 
 const juce::String OneRiserProcessor::getName() const {
     return JucePlugin_Name;
@@ -45,7 +112,8 @@ bool OneRiserProcessor::isMidiEffect() const {
 }
 
 double OneRiserProcessor::getTailLengthSeconds() const {
-    return 0.0;
+    // (hosts ask from any thread, so this is whatever the audio thread last left)
+    return tailSeconds.load();
 }
 
 int OneRiserProcessor::getNumPrograms() {
@@ -71,14 +139,48 @@ void OneRiserProcessor::changeProgramName(int index, const juce::String& newName
 }
 
 void OneRiserProcessor::prepareToPlay(double sampleRate, int samplesPerBlock) {
-    juce::ignoreUnused(samplesPerBlock);
-
-    riserProcessor.prepare(uint(sampleRate));
+    // (first, as a swap still under way is finished, which can change the live processor)
+    processors.prepare(uint(sampleRate));
+    auto& live = processors.getLive();
+
+    // (the parameters go first, so everything starts out at them rather than ramping — the
+    // quality level too, which would fade otherwise)
+    governor.prepare(sampleRate);
+    live.setQualityLevel(0);
+    applyParameters(live);
+    live.setReverbMultirate(reverbMultirate->load() >= 0.5f);
+    live.setReverbPipelined(reverbPipelined->load() >= 0.5f);
+    live.setReverbBus(getRequestedReverbBus());
+    live.prepare(uint(sampleRate), samplesPerBlock);
+    setLatencySamples(live.getLatencySamples());
+    tailSeconds.store(live.getTailLengthSeconds());
+
+    preparedSampleRate = uint(sampleRate);
+    preparedBlockSize = samplesPerBlock;
+    prepared.store(true);
+
+    signalFeed.prepare(sampleRate);
+
+    wasPlaying = false;
+    expectedTimeInSamples = -1;
+
+   #if ONERISER_TRACING
+    traceSession.setSampleRate(sampleRate);
+   #endif
 }
 
 void OneRiserProcessor::releaseResources() {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    // suspended instances don't need to hold on to their delay lines (and a swap can't fade
+    // into a freed processor)
+    prepared.store(false);
+    processors.finishSwap();
+    processors.forEach([](RiserProcessor& p) { p.release(); });
+    preparedSampleRate = 0;
+}
+
+void OneRiserProcessor::reset() {
+    // (clearing is constant time, so this is fine wherever the host calls it from)
+    processors.getLive().reset();
 }
 
 bool OneRiserProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const {
@@ -107,6 +209,14 @@ bool OneRiserProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 void OneRiserProcessor::processBlock(juce::AudioBuffer<float>& buffer,
                                      juce::MidiBuffer& midiMessages) {
     juce::ignoreUnused(midiMessages);
+    PA_TRACE_BLOCK(traceSession, buffer.getNumSamples());
+
+    const auto startTicks = Time::getHighResolutionTicks();
+
+    // (offline, there's no deadline to keep — and turning the governor off puts the level back to
+    // full quality, which the host is told of like any other change)
+    if (governor.setEnabled(governorEnabled->load() >= 0.5f && !isNonRealtime()))
+        updatePending.store(true);
 
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
@@ -126,9 +236,68 @@ void OneRiserProcessor::processBlock(juce::AudioBuffer<float>& buffer,
     //     rightData[i] = 0;
     // }
 
-    riserProcessor.process(leftData, rightData, buffer.getNumSamples());
+    // nothing is measured unless an editor is listening
+    const bool feedActive = signalFeed.isActive();
+    const float inputLevel = feedActive ? buffer.getMagnitude(0, buffer.getNumSamples()) : 0.0f;
+
+    // switching the reverb's rate reallocates it, pipelining it starts a thread and sharing it joins the bus,
+    // so those are left to the message thread
+    auto& live = processors.getLive();
+
+    if ((reverbMultirate->load() >= 0.5f) != live.isReverbMultirate()
+        || (reverbPipelined->load() >= 0.5f) != live.isReverbPipelined()
+        || getRequestedReverbBus() != live.getReverbBus())
+        updatePending.store(true);
+
+   #if ONERISER_TRACING
+    traceParameterChanges();
+   #endif
+
+    followTransport(buffer.getNumSamples());
+
+    // the parameters go to the live processor, or to the shadow while it's being crossfaded in
+    // - at the governor's lowest level, only every few blocks
+    processors.process(leftData, rightData, buffer.getNumSamples(), [this](RiserProcessor& p) {
+        p.setQualityLevel(governor.getLevel());
+
+        if (governor.getLevel() < pa::CpuGovernor::maxLevel || ++blocksSinceParameters >= coarseParameterInterval) {
+            applyParameters(p);
+            blocksSinceParameters = 0;
+        }
+
+        followHostTempo(p);
+    });
+
+    // (the old live processor is tidied up on the message thread)
+    if (processors.takeSwapped())
+        updatePending.store(true);
+
+    tailSeconds.store(processors.getLive().getTailLengthSeconds());
+
+    // (the new level is passed on to the host from the message thread)
+    if (governor.update(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks), buffer.getNumSamples()))
+        updatePending.store(true);
+
+    if (feedActive) {
+        signalFeed.pushLevels({ inputLevel, buffer.getMagnitude(0, buffer.getNumSamples()) });
+        signalFeed.pushSignal(leftData, rightData, buffer.getNumSamples());
+    }
 }
 
+#if ONERISER_TRACING
+// Marks each parameter change in the trace, so glitches can be lined up with automation
+void OneRiserProcessor::traceParameterChanges() {
+    for (size_t i = 0; i < tracedParameters.size(); i++) {
+        const float value = tracedParameters[i].second->load();
+
+        if (value != tracedValues[i]) {
+            PA_TRACE_INSTANT(tracedParameters[i].first, value);
+            tracedValues[i] = value;
+        }
+    }
+}
+#endif
+
 bool OneRiserProcessor::hasEditor() const {
     return true; // (change this to false if you choose to not supply an editor)
 }
@@ -139,17 +308,196 @@ juce::AudioProcessorEditor* OneRiserProcessor::createEditor() {
 
 void OneRiserProcessor::getStateInformation(juce::MemoryBlock& destData) {
     // this allows the host to save the state of the device
-    auto state = parameters.copyState();
-    std::unique_ptr<XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
+    MemoryOutputStream stream(destData, false);
+
+    stream.writeInt(stateMagic);
+    stream.writeInt(stateVersion);
+    stream.writeInt(int(stateParameterIDs.size()));
+
+    for (const auto* id : stateParameterIDs)
+        stream.writeFloat(parameters.getRawParameterValue(id)->load());
 }
 
 void OneRiserProcessor::setStateInformation(const void* data, int sizeInBytes) {
+    // while prepared to play, the new state goes to the shadow processor, which is crossfaded in
+    // rather than the live one jumping to it (see ShadowSwap.h)
+    const bool swapping = prepared.load() && processors.beginSwap();
+
+    if (!readState(data, sizeInBytes)) {
+        if (swapping)
+            processors.cancelSwap();
+
+        return;
+    }
+
+    if (swapping) {
+        setUpShadow();
+        processors.commitSwap();
+    }
+}
+
+// Used to load a state into the parameters, returns false if it isn't one
+bool OneRiserProcessor::readState(const void* data, int sizeInBytes) {
     // this allows the host to load the state of the device
+    if (readBinaryState(data, sizeInBytes))
+        return true;
+
+    // states saved before the binary format are XML
     std::unique_ptr<XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
 
-    if (xmlState != nullptr && xmlState->hasTagName(parameters.state.getType()))
-        parameters.replaceState(ValueTree::fromXml(*xmlState));
+    if (xmlState == nullptr || !xmlState->hasTagName(parameters.state.getType()))
+        return false;
+
+    parameters.replaceState(ValueTree::fromXml(*xmlState));
+    return true;
+}
+
+// Used to set the shadow processor up like the live one, but at the new parameters, ready to be crossfaded in
+// - once prepared, it keeps its memory between swaps, so this only allocates the first time
+// - on the shared reverb, it doesn't join it, but takes over the live one's slot (see RiserProcessor::fadeTo())
+void OneRiserProcessor::setUpShadow() {
+    auto& live = processors.getLive();
+    auto& shadow = processors.getShadow();
+
+    applyParameters(shadow);
+    shadow.setQualityLevel(live.getQualityLevel());
+    shadow.setReverbMultirate(live.isReverbMultirate());
+    shadow.setReverbPipelined(live.isReverbPipelined());
+    shadow.setReverbBus(live.isOnReverbBus() ? live.getReverbBus() : nullptr, false);
+    shadow.prepare(preparedSampleRate, preparedBlockSize);
+}
+
+// Used to read the binary state straight into the parameters, returns false if it isn't one
+bool OneRiserProcessor::readBinaryState(const void* data, int sizeInBytes) {
+    constexpr int headerSize = 3 * int(sizeof(int));
+
+    if (data == nullptr || sizeInBytes < headerSize)
+        return false;
+
+    MemoryInputStream stream(data, size_t(sizeInBytes), false);
+
+    if (stream.readInt() != stateMagic)
+        return false;
+
+    const int version = stream.readInt(), numStored = stream.readInt();
+
+    if (version < 1 || numStored < 0 || numStored > (sizeInBytes - headerSize) / int(sizeof(float)))
+        return false;
+
+    // a known version has to hold exactly its own layout, and a newer one at least all of this
+    // one's (the layout only ever grows, so its extra values are for parameters this one lacks)
+    const int expected = stateVersionSizes[size_t(jmin(version, stateVersion) - 1)];
+
+    if (version <= stateVersion ? numStored != expected : numStored < expected)
+        return false;
+
+    for (int i = 0; i < int(stateParameterIDs.size()); i++) {
+        auto* param = parameters.getParameter(stateParameterIDs[size_t(i)]);
+
+        // (parameters added after the state's version go back to their defaults)
+        param->setValueNotifyingHost(i < expected ? param->convertTo0to1(stream.readFloat())
+                                                  : param->getDefaultValue());
+    }
+
+    return true;
+}
+
+// Used to pass the parameters on to a riser processor (the live one every block, or the shadow as it's set up)
+void OneRiserProcessor::applyParameters(RiserProcessor& p) {
+    p.setParameters(flangerAmount->load(), filterAmount->load(), reverbAmount->load(), masterAmount->load());
+    p.setOrder(RiserProcessor::Order(jlimit(0, RiserProcessor::numOrders - 1, roundToInt(effectOrder->load()))));
+
+    RiserProcessor::Modulation m;
+    m.rate        = lfoRate->load();
+    m.depth       = lfoDepth->load();
+    m.stereoPhase = lfoPhase->load() / 360.0f;
+    m.sync        = lfoSync->load() >= 0.5f;
+    m.syncBeats   = lfoDivisionBeats[size_t(jlimit(0, int(lfoDivisionBeats.size()) - 1, roundToInt(lfoDivision->load())))];
+
+    p.setModulation(m);
+}
+
+// Used to pass the host's tempo and position on to a riser processor (audio thread only)
+void OneRiserProcessor::followHostTempo(RiserProcessor& p) {
+    // without a tempo the LFO just keeps its last rate, and free-runs if the position is unknown
+    if (auto* playHead = getPlayHead()) {
+        if (const auto position = playHead->getPosition()) {
+            const auto ppq = position->getIsPlaying() ? position->getPpqPosition() : Optional<double>();
+            p.setHostTempo(position->getBpm().orFallback(0.0), ppq.orFallback(-1.0));
+        }
+    }
+}
+
+// Flushes the tails when the transport stops or jumps, so a seek doesn't carry the old position's
+// tail into the new one (clearing is constant time, so there's no spike)
+// - loop wraps aren't treated as jumps, so the tail carries over the loop point
+void OneRiserProcessor::followTransport(int numSamples) {
+    auto* playHead = getPlayHead();
+    if (playHead == nullptr) return;
+
+    const auto position = playHead->getPosition();
+    if (!position) return;
+
+    const bool playing = position->getIsPlaying();
+    const auto time = position->getTimeInSamples();
+
+    const bool stopped = wasPlaying && !playing;
+    const bool jumped = wasPlaying && playing && !position->getIsLooping() && time
+                     && expectedTimeInSamples >= 0 && *time != expectedTimeInSamples;
+
+    if (stopped || jumped)
+        processors.getLive().reset();
+
+    wasPlaying = playing;
+    expectedTimeInSamples = (playing && time) ? *time + numSamples : -1;
+}
+
+// The shared reverb, if this instance is set to use it
+pa::dsp::ReverbBus* OneRiserProcessor::getRequestedReverbBus() {
+    return reverbShared->load() >= 0.5f ? reverbBus.get() : nullptr;
+}
+
+// Polls for anything the audio thread has left for the message thread (see handlePendingUpdate())
+void OneRiserProcessor::timerCallback() {
+    if (updatePending.exchange(false))
+        handlePendingUpdate();
+}
+
+// Used to apply the reverb rate, pipelining and sharing options, with processing suspended while the
+// reverb is reallocated, its thread started or the bus joined, then to report the new latency
+// - also tidies up after a state swap: the old live processor (now the shadow) keeps its memory for the
+//   next swap, but stops its reverb thread and lets go of the shared reverb — the audio thread doesn't
+//   touch the shadow between swaps, so that's done without suspending (which would drop out right
+//   after the crossfade)
+// - and passes the CPU governor's level on to the host (and editor)
+// - processing is only suspended if the live processor actually has to change, not for every level change
+void OneRiserProcessor::handlePendingUpdate() {
+    auto& live = processors.getLive();
+    auto& shadow = processors.getShadow();
+
+    // (outside any suspension, as the host may call back in)
+    if (const auto level = float(governor.getLevel()); level != qualityLevel->convertFrom0to1(qualityLevel->getValue()))
+        qualityLevel->setValueNotifyingHost(qualityLevel->convertTo0to1(level));
+
+    if (!processors.isSwapping()) {
+        shadow.setReverbPipelined(false);
+        shadow.setReverbBus(nullptr);
+    }
+
+    const bool multirate = reverbMultirate->load() >= 0.5f,
+               pipelined = reverbPipelined->load() >= 0.5f;
+    auto* bus = getRequestedReverbBus();
+
+    if (multirate == live.isReverbMultirate() && pipelined == live.isReverbPipelined() && bus == live.getReverbBus())
+        return;
+
+    suspendProcessing(true);
+    live.setReverbMultirate(multirate);
+    live.setReverbPipelined(pipelined);
+    live.setReverbBus(bus);
+    suspendProcessing(false);
+
+    setLatencySamples(live.getLatencySamples());
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter() {
@@ -169,5 +517,44 @@ AudioProcessorValueTreeState::ParameterLayout OneRiserProcessor::createParameter
     params.push_back(std::make_unique<AudioParameterFloat>(ParameterID { "FIL_AMT", 1 }, "Filter Amount",  normRange, 1.00f));
     params.push_back(std::make_unique<AudioParameterFloat>(ParameterID { "REV_AMT", 1 }, "Reverb Amount",  normRange, 0.70f));
 
+    // flanger modulation, parameter version hint 2 (state format version 2)
+    NormalisableRange<float> rateRange(0.01f, 10.0f, 0.001f);
+    rateRange.setSkewForCentre(0.5f);
+
+    params.push_back(std::make_unique<AudioParameterFloat>(ParameterID { "LFO_RTE", 2 }, "LFO Rate",  rateRange, 0.5f));
+    params.push_back(std::make_unique<AudioParameterFloat>(ParameterID { "LFO_DPT", 2 }, "LFO Depth", normRange, 0.0f));
+    params.push_back(std::make_unique<AudioParameterFloat>(ParameterID { "LFO_PHS", 2 }, "LFO Stereo Phase",
+                                                           NormalisableRange<float>(0.0f, 180.0f, 1.0f), 90.0f));
+    params.push_back(std::make_unique<AudioParameterBool>(ParameterID { "LFO_SYN", 2 }, "LFO Sync", false));
+    params.push_back(std::make_unique<AudioParameterChoice>(ParameterID { "LFO_DIV", 2 }, "LFO Sync Division",
+                                                            StringArray { "1/16", "1/8", "1/4", "1/2", "1 Bar", "2 Bars", "4 Bars" }, 4));
+
+    // runs the reverb's combs at 44.1/48 kHz at higher sample rates (a session setting, so not automatable)
+    params.push_back(std::make_unique<AudioParameterBool>(ParameterID { "REV_DEC", 2 }, "Reverb Downsampling", false,
+                                                          AudioParameterBoolAttributes().withAutomatable(false)));
+
+    // effect order, parameter version hint 3 (state format version 4), matching RiserProcessor::Order
+    params.push_back(std::make_unique<AudioParameterChoice>(ParameterID { "FX_ORD", 3 }, "Effect Order",
+                                                            StringArray { "Standard", "Filtered Wash", "Flanged Wash" }, 0));
+
+    // runs the reverb on a helper thread, for a block of latency (a session setting, so not automatable)
+    params.push_back(std::make_unique<AudioParameterBool>(ParameterID { "REV_PIP", 3 }, "Reverb Pipelining", false,
+                                                          AudioParameterBoolAttributes().withAutomatable(false)));
+
+    // sends to one reverb shared by every instance with this on, parameter version hint 4 (state format version 6)
+    // (a session setting, so not automatable)
+    params.push_back(std::make_unique<AudioParameterBool>(ParameterID { "REV_BUS", 4 }, "Shared Reverb", false,
+                                                          AudioParameterBoolAttributes().withAutomatable(false)));
+
+    // lets the processor trade some quality for time under sustained CPU load (off unless asked for), parameter version
+    // hint 5 (state format version 7; a session setting, so not automatable), along with the quality it's currently at
+    // (a read-only meter, set by the processor, and not part of the state)
+    params.push_back(std::make_unique<AudioParameterBool>(ParameterID { "GOV_ON", 5 }, "Adaptive Quality", false,
+                                                          AudioParameterBoolAttributes().withAutomatable(false)));
+    params.push_back(std::make_unique<AudioParameterChoice>(ParameterID { "GOV_LVL", 5 }, "Quality",
+                                                            StringArray { "Full", "Reduced", "Minimal" }, 0,
+                                                            AudioParameterChoiceAttributes().withAutomatable(false)
+                                                                .withCategory(AudioProcessorParameter::otherMeter)));
+
     return { params.begin(), params.end() };
 }
\ No newline at end of file
@@ -3,15 +3,21 @@
 #include "juce_dsp/juce_dsp.h"
 #include <array>
 #include "Components/RiserProcessor.h"
+#include "Components/ReverbBus.h"
+#include "Components/ShadowSwap.h"
+#include "Components/CpuGovernor.h"
 #include "Components/CustomLookAndFeel.h"
+#include "Components/SignalFeed.h"
 
-class OneRiserProcessor : public juce::AudioProcessor {
+class OneRiserProcessor : public juce::AudioProcessor,
+                          private juce::Timer {
  public:
     OneRiserProcessor();
     ~OneRiserProcessor() override;
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 
@@ -47,10 +53,74 @@ class OneRiserProcessor : public juce::AudioProcessor {
 
     AudioProcessorValueTreeState parameters;
 
-    RiserProcessor riserProcessor;
+    // levels and signal for the editor's display, only fed while an editor is open
+    pa::SignalFeed signalFeed;
 
  private:
+    // the reverb shared by every instance in the process that opts into it (see ReverbBus.h)
+    SharedResourcePointer<pa::dsp::ReverbBus> reverbBus;
+
+    // the live riser processor, and the shadow that a new state is crossfaded over to (see ShadowSwap.h)
+    pa::dsp::ShadowSwap<RiserProcessor> processors;
+    uint preparedSampleRate = 0; // (0 while not prepared)
+    int preparedBlockSize = 0;
+
+    // steps the processors' quality down when the blocks take too long (see CpuGovernor.h), with its level
+    // passed on to the host from the message thread
+    pa::CpuGovernor governor;
+    RangedAudioParameter* qualityLevel = nullptr;
+    int blocksSinceParameters = 0; // (audio thread only)
+
+    // set in prepareToPlay() and cleared in releaseResources(), so a new state knows whether to swap
+    std::atomic<bool> prepared { false };
+
+    // set on the audio thread when there's something for the message thread to do, which polls it on a
+    // timer (see timerCallback()), as posting a message from the audio thread isn't real-time safe
+    std::atomic<bool> updatePending { false };
+
+    // the live processor's tail estimate as of the last block, for the host (see getTailLengthSeconds())
+    std::atomic<double> tailSeconds { 0.0 };
+
+    // amounts, read on the audio thread every block
+    std::atomic<float>* masterAmount = nullptr, * flangerAmount = nullptr,
+                      * filterAmount = nullptr, * reverbAmount = nullptr;
+
+    // flanger modulation parameters, read on the audio thread every block
+    std::atomic<float>* lfoRate = nullptr, * lfoDepth = nullptr, * lfoPhase = nullptr,
+                      * lfoSync = nullptr, * lfoDivision = nullptr;
+
+    // reverb rate and pipelining options, which are applied off the audio thread (see handlePendingUpdate())
+    std::atomic<float>* reverbMultirate = nullptr, * reverbPipelined = nullptr, * reverbShared = nullptr;
+
+    // whether the CPU governor may reduce the quality, read on the audio thread every block
+    std::atomic<float>* governorEnabled = nullptr;
+
+    // effect order, read on the audio thread every block
+    std::atomic<float>* effectOrder = nullptr;
+
+    // the transport as of the last block, for flushing the tails when it stops or jumps
+    bool wasPlaying = false;
+    juce::int64 expectedTimeInSamples = -1;
+
+   #if ONERISER_TRACING
+    // per-instance trace, with the parameter values last marked in it
+    pa::trace::Session traceSession;
+    vector<std::pair<const char*, std::atomic<float>*>> tracedParameters;
+    vector<float> tracedValues;
+
+    void traceParameterChanges();
+   #endif
+
     static AudioProcessorValueTreeState::ParameterLayout createParameters();
+    void applyParameters(RiserProcessor& p);
+    void followHostTempo(RiserProcessor& p);
+    void setUpShadow();
+    bool readState(const void* data, int sizeInBytes);
+    void followTransport(int numSamples);
+    pa::dsp::ReverbBus* getRequestedReverbBus();
+    void timerCallback() override;
+    void handlePendingUpdate();
+    bool readBinaryState(const void* data, int sizeInBytes);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OneRiserProcessor)
 };
\ No newline at end of file
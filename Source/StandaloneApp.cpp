@@ -0,0 +1,259 @@
+// The Standalone app: JUCE's usual plugin window, plus headless test modes
+// - OneRiser --stress [--instances N] [--threads M] [--block B] [--rate SR] [--seconds S]
+//   (see StressTest.h), exits with 1 if any deadline was missed
+// - OneRiser --render=IN --output=OUT [--master=A] [--flanger=A] [--filter=A] [--reverb=A] [--threads=N]
+//   renders a file (with its tail) across every core (see Components/ChunkedRender.h), exits with 1
+//   if it couldn't, or the result isn't within the error bound
+//   - with --stream [--bits=16|24|32], renders it as a stream in a fixed amount of memory instead,
+//     for files of any length (see Components/StreamingRender.h)
+#include <cstdio>
+#include <juce_audio_plugin_client/Standalone/juce_StandaloneFilterWindow.h>
+#include "StressTest.h"
+#include "Components/ChunkedRender.h"
+#include "Components/StreamingRender.h"
+
+class OneRiserStandaloneApp : public JUCEApplication {
+ public:
+    OneRiserStandaloneApp() {
+        PropertiesFile::Options options;
+        options.applicationName     = getApplicationName();
+        options.filenameSuffix      = ".settings";
+        options.osxLibrarySubFolder = "Application Support";
+       #if JUCE_LINUX || JUCE_BSD
+        options.folderName          = "~/.config";
+       #endif
+        appProperties.setStorageParameters(options);
+    }
+
+    const String getApplicationName() override { return JucePlugin_Name; }
+    const String getApplicationVersion() override { return JucePlugin_VersionString; }
+    bool moreThanOneInstanceAllowed() override { return true; }
+    void anotherInstanceStarted(const String&) override {}
+
+    void initialise(const String& commandLine) override {
+        const ArgumentList args(getApplicationName(), commandLine);
+
+        if (args.containsOption("--render")) {
+            finish(renderFile(args));
+            return;
+        }
+
+        if (args.containsOption("--stress")) {
+            // (run in the background, so the message loop stays free for the processors' async updates)
+            stressTest = std::make_unique<StressTest>(StressTest::Options::fromArguments(args),
+                                                      [this](const String& report, bool passed) {
+                std::printf("%s", report.toRawUTF8());
+                std::fflush(stdout);
+
+                MessageManager::callAsync([this, passed] { finish(passed); });
+            });
+            return;
+        }
+
+        mainWindow = std::make_unique<StandaloneFilterWindow>(getApplicationName(),
+                                                              LookAndFeel::getDefaultLookAndFeel().findColour(ResizableWindow::backgroundColourId),
+                                                              appProperties.getUserSettings(), false);
+        mainWindow->setVisible(true);
+    }
+
+    void shutdown() override {
+        stressTest = nullptr;
+        mainWindow = nullptr;
+        appProperties.saveIfNeeded();
+    }
+
+    void systemRequestedQuit() override {
+        if (mainWindow != nullptr)
+            mainWindow->pluginHolder->savePluginState();
+
+        // let any open dialogs close first
+        if (ModalComponentManager::getInstance()->cancelAllModals()) {
+            Timer::callAfterDelay(100, [] {
+                if (auto* app = JUCEApplicationBase::getInstance())
+                    app->systemRequestedQuit();
+            });
+        }
+        else {
+            quit();
+        }
+    }
+
+ private:
+    ApplicationProperties appProperties;
+    std::unique_ptr<StandaloneFilterWindow> mainWindow;
+    std::unique_ptr<StressTest> stressTest;
+
+    // Render one file to a 24 bit WAV with the default amounts (or those given), at its own sample rate
+    static bool renderFile(const ArgumentList& args) {
+        const auto getFile = [&](const char* option) {
+            const auto path = args.getValueForOption(option);
+            return path.isEmpty() ? File() : File::getCurrentWorkingDirectory().getChildFile(path);
+        };
+
+        const File input = getFile("--render"), output = getFile("--output");
+
+        AudioFormatManager formats;
+        formats.registerBasicFormats();
+        std::unique_ptr<AudioFormatReader> reader(input.existsAsFile() ? formats.createReaderFor(input) : nullptr);
+
+        if (reader == nullptr || output == File()) {
+            std::printf("Couldn't read %s (or no --output given)\n", input.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        ChunkedRenderer::Options options;
+        options.sampleRate = uint(reader->sampleRate + 0.5);
+
+        const auto read = [&](const char* option, float fallback) {
+            const auto value = args.getValueForOption(option);
+            return value.isEmpty() ? fallback : jlimit(0.0f, 1.0f, value.getFloatValue());
+        };
+
+        options.masterAmount = read("--master", options.masterAmount);
+        options.flangerAmount = read("--flanger", options.flangerAmount);
+        options.filterAmount = read("--filter", options.filterAmount);
+        options.reverbAmount = read("--reverb", options.reverbAmount);
+        options.numThreads = args.getValueForOption("--threads").getIntValue();
+
+        if (args.containsOption("--stream")) {
+            const auto bits = args.getValueForOption("--bits");
+            return streamFile(input, output, *reader, options, bits.isEmpty() ? 24 : bits.getIntValue());
+        }
+
+        // (the tail is rendered too, so the input is padded with silence)
+        RiserProcessor p;
+        p.setParameters(options.flangerAmount, options.filterAmount, options.reverbAmount, options.masterAmount);
+        const auto length = reader->lengthInSamples + int64(p.getTailLengthSeconds() * options.sampleRate);
+
+        if (length > std::numeric_limits<int>::max()) {
+            std::printf("%s is too long\n", input.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        AudioBuffer<float> in(2, int(length)), out(2, int(length));
+        in.clear();
+        reader->read(&in, 0, int(reader->lengthInSamples), 0, true, true);
+
+        const auto start = Time::getMillisecondCounterHiRes();
+        const auto report = ChunkedRenderer::render(in.getReadPointer(0), in.getReadPointer(1),
+                                                    out.getWritePointer(0), out.getWritePointer(1), length, options);
+
+        std::printf("%d chunks, %.2f s pre-roll, %d re-rendered, worst seam %.1f dB, %.1f s\n",
+                    report.numChunks, report.prerollSeconds, report.numRerendered, report.worstSeamErrorDb,
+                    (Time::getMillisecondCounterHiRes() - start) / 1000.0);
+
+        output.deleteFile();
+        std::unique_ptr<OutputStream> stream(output.createOutputStream());
+        std::unique_ptr<AudioFormatWriter> writer;
+
+        if (stream != nullptr)
+            writer.reset(WavAudioFormat().createWriterFor(stream.get(), reader->sampleRate, 2, 24, {}, 0));
+
+        if (writer == nullptr) {
+            std::printf("Couldn't write %s\n", output.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        stream.release(); // (owned by the writer now)
+        return writer->writeFromAudioSampleBuffer(out, 0, out.getNumSamples()) && report.withinBound;
+    }
+
+    // Render one file (with its tail) as a stream, reading, processing and writing a buffer at a time on
+    // their own threads, to a WAV at a bit depth of 16, 24 or 32 (float)
+    // - WAV and AIFF input is read through a memory map of just the buffer being read, anything else
+    //   through the usual reader, so the memory used doesn't grow with the file
+    static bool streamFile(const File& input, const File& output, AudioFormatReader& reader,
+                           const ChunkedRenderer::Options& options, int bitDepth) {
+        if (bitDepth != 16 && bitDepth != 24 && bitDepth != 32) {
+            std::printf("Can't write %d bit files (only 16, 24 or 32)\n", bitDepth);
+            return false;
+        }
+
+        std::unique_ptr<MemoryMappedAudioFormatReader> mapped(WavAudioFormat().createMemoryMappedReader(input));
+
+        if (mapped == nullptr)
+            mapped.reset(AiffAudioFormat().createMemoryMappedReader(input));
+
+        AudioFormatReader& source = (mapped != nullptr) ? *mapped : reader;
+
+        RiserProcessor p;
+        ChunkedRenderer::prepareProcessor(p, options, 0);
+        const auto length = reader.lengthInSamples + int64(p.getTailLengthSeconds() * options.sampleRate);
+
+        output.deleteFile();
+        std::unique_ptr<OutputStream> stream(output.createOutputStream());
+        std::unique_ptr<AudioFormatWriter> writer;
+
+        // (WAV switches to RF64 by itself past 4 GB)
+        if (stream != nullptr)
+            writer.reset(WavAudioFormat().createWriterFor(stream.get(), reader.sampleRate, 2, bitDepth, {}, 0));
+
+        if (writer == nullptr) {
+            std::printf("Couldn't write %s\n", output.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        stream.release(); // (owned by the writer now)
+
+        StreamingRenderer::Options streamOptions;
+        const auto& kernels = pa::dsp::kernels::get();
+
+        // the readers and writers take (and give) integer formats as full scale 32 bit integers, converted
+        // here a buffer at a time (each scratch is only used by its own thread)
+        const int bufferSize = StreamingRenderer::getBufferSize(streamOptions);
+        vector<int> readScratch(size_t(2 * bufferSize)), writeScratch(size_t(2 * bufferSize));
+
+        const auto read = [&](float* left, float* right, int64 position, int numSamples) {
+            int* channels[] { readScratch.data(), readScratch.data() + bufferSize };
+
+            // (mapping only this buffer's section keeps the mapping the same size, however long the file)
+            if (mapped != nullptr && !mapped->mapSectionOfFile({ position, position + numSamples }))
+                return false;
+
+            if (!source.read(channels, 2, position, numSamples, true, true))
+                return false;
+
+            // (a float file's samples come through as they are)
+            if (source.usesFloatingPointData) {
+                std::memcpy(left, channels[0], size_t(numSamples) * sizeof(float));
+                std::memcpy(right, channels[1], size_t(numSamples) * sizeof(float));
+            }
+            else {
+                kernels.intToFloat(channels[0], left, numSamples);
+                kernels.intToFloat(channels[1], right, numSamples);
+            }
+
+            return true;
+        };
+
+        const auto write = [&](const float* left, const float* right, int numSamples) {
+            // (a float writer takes its samples as they are, through the same pointers)
+            if (writer->isFloatingPoint()) {
+                const int* channels[] { reinterpret_cast<const int*>(left), reinterpret_cast<const int*>(right), nullptr };
+                return writer->write(channels, numSamples);
+            }
+
+            kernels.floatToInt(left, writeScratch.data(), bitDepth, numSamples);
+            kernels.floatToInt(right, writeScratch.data() + bufferSize, bitDepth, numSamples);
+
+            const int* channels[] { writeScratch.data(), writeScratch.data() + bufferSize, nullptr };
+            return writer->write(channels, numSamples);
+        };
+
+        const auto start = Time::getMillisecondCounterHiRes();
+        const auto report = StreamingRenderer::render(p, reader.lengthInSamples, length, read, write, streamOptions);
+
+        std::printf("%.1f s rendered, %.1f MB of buffers, %.2f s waiting for I/O, %.1f s\n",
+                    double(report.numSamples) / options.sampleRate, double(report.bufferBytes) / (1024.0 * 1024.0),
+                    report.dspWaitSeconds, (Time::getMillisecondCounterHiRes() - start) / 1000.0);
+
+        return report.succeeded && writer->flush();
+    }
+
+    void finish(bool passed) {
+        setApplicationReturnValue(passed ? 0 : 1);
+        quit();
+    }
+};
+
+JUCE_CREATE_APPLICATION_DEFINE(OneRiserStandaloneApp)
@@ -0,0 +1,278 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "PluginProcessor.h"
+
+/*
+ * ~ Stress test ~
+ * Headless real-time load test, run from the Standalone app with --stress.
+ *
+ * N processor instances are spread over M worker threads, each of which acts as an audio
+ * callback: every block period it processes all of its instances in series, and misses its
+ * deadline if that takes longer than the period. Meanwhile a host thread randomly automates
+ * parameters, loads states and re-enters prepareToPlay(), with the instance suspended
+ * meanwhile (so its worker skips it, as a host would stop its audio). The states and
+ * re-prepares are serialized with the message thread, as a host would make those calls on it.
+ *
+ * e.g. OneRiser --stress --instances 32 --threads 4 --block 64 --rate 96000 --seconds 60
+*/
+
+class StressTest : private Thread {
+ public:
+    struct Options {
+        int instances = 16, threads = 1, blockSize = 128;
+        double sampleRate = 48000.0, seconds = 30.0;
+
+        // average number of host events per instance per second
+        double automationRate = 20.0, stateLoadRate = 0.5, reprepareRate = 0.1;
+
+        static Options fromArguments(const ArgumentList& args) {
+            Options o;
+            const auto read = [&](const char* option, auto fallback) {
+                const auto value = args.getValueForOption(option);
+                return value.isEmpty() ? fallback : decltype(fallback)(value.getDoubleValue());
+            };
+
+            o.instances  = jmax(1, read("--instances", o.instances));
+            o.threads    = jlimit(1, o.instances, read("--threads", o.threads));
+            o.blockSize  = jlimit(16, 8192, read("--block", o.blockSize));
+            o.sampleRate = jlimit(8000.0, 768000.0, read("--rate", o.sampleRate));
+            o.seconds    = jmax(1.0, read("--seconds", o.seconds));
+            return o;
+        }
+    };
+
+    // Runs the test in the background, calling onFinished (on this thread) with the report
+    // and whether every deadline was met
+    StressTest(const Options& testOptions, std::function<void(const String&, bool)> finishedCallback)
+     : Thread("OneRiser stress host"), options(testOptions), onFinished(std::move(finishedCallback)) {
+        startThread();
+    }
+
+    ~StressTest() override {
+        stopThread(10000);
+    }
+
+ private:
+    struct Instance {
+        std::unique_ptr<OneRiserProcessor> processor;
+        Random random;
+    };
+
+    // One simulated audio callback, processing its instances in series
+    class Worker : public Thread {
+     public:
+        Worker(const Options& o, vector<Instance*> workerInstances)
+         : Thread("OneRiser stress worker"), options(o), instances(std::move(workerInstances)),
+           buffer(2, o.blockSize) {
+            numCycles = int(o.seconds * o.sampleRate / o.blockSize);
+            blockTimes.reserve(size_t(numCycles) * instances.size());
+        }
+
+        const Options& options;
+        vector<Instance*> instances;
+
+        AudioBuffer<float> buffer;
+        MidiBuffer midi;
+
+        int numCycles = 0, misses = 0;
+        double worstCycle = 0.0;  // seconds
+        vector<float> blockTimes; // microseconds, per instance block
+
+        void run() override {
+            const double period = options.blockSize / options.sampleRate;
+            const auto periodDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                            std::chrono::duration<double>(period));
+            auto deadline = std::chrono::steady_clock::now();
+
+            for (int cycle = 0; cycle < numCycles && !threadShouldExit(); cycle++) {
+                const auto cycleStart = Time::getHighResolutionTicks();
+
+                for (auto* instance : instances) {
+                    auto& p = *instance->processor;
+
+                    // a quiet noise input, so the effect has something to chew on
+                    for (int c = 0; c < buffer.getNumChannels(); c++) {
+                        float* data = buffer.getWritePointer(c);
+
+                        for (int i = 0; i < buffer.getNumSamples(); i++)
+                            data[i] = 0.25f * (2.0f * instance->random.nextFloat() - 1.0f);
+                    }
+
+                    const auto blockStart = Time::getHighResolutionTicks();
+
+                    // (as the plugin wrappers do, so suspendProcessing() is respected, e.g. while re-preparing)
+                    {
+                        const ScopedLock sl(p.getCallbackLock());
+
+                        if (p.isSuspended())
+                            buffer.clear();
+                        else
+                            p.processBlock(buffer, midi);
+                    }
+
+                    const auto blockEnd = Time::getHighResolutionTicks();
+                    blockTimes.push_back(float(Time::highResolutionTicksToSeconds(blockEnd - blockStart) * 1.0e6));
+                }
+
+                const double cycleTime = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - cycleStart);
+                worstCycle = jmax(worstCycle, cycleTime);
+
+                if (cycleTime > period)
+                    misses++;
+
+                // wait for the next period, or carry straight on (from now) if this one overran
+                deadline += periodDuration;
+                const auto now = std::chrono::steady_clock::now();
+
+                if (now < deadline)
+                    std::this_thread::sleep_until(deadline);
+                else
+                    deadline = now;
+            }
+        }
+    };
+
+    Options options;
+    std::function<void(const String&, bool)> onFinished;
+
+    vector<std::unique_ptr<Instance>> instances;
+    vector<std::unique_ptr<Worker>> workers;
+    Random random;
+
+    int automations = 0, stateLoads = 0, reprepares = 0;
+
+    void run() override {
+        for (int i = 0; i < options.instances; i++) {
+            auto instance = std::make_unique<Instance>();
+            instance->processor = std::make_unique<OneRiserProcessor>();
+            instance->processor->setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+            instance->processor->prepareToPlay(options.sampleRate, options.blockSize);
+            instances.push_back(std::move(instance));
+        }
+
+        // instances are dealt out to the workers in turn
+        for (int w = 0; w < options.threads; w++) {
+            vector<Instance*> workerInstances;
+
+            for (size_t i = size_t(w); i < instances.size(); i += size_t(options.threads))
+                workerInstances.push_back(instances[i].get());
+
+            workers.push_back(std::make_unique<Worker>(options, std::move(workerInstances)));
+        }
+
+        for (auto& w : workers)
+            w->startThread(Thread::Priority::highest);
+
+        hostLoop();
+
+        for (auto& w : workers)
+            w->stopThread(-1);
+
+        const auto report = createReport();
+        const bool passed = getTotalMisses() == 0;
+
+        workers.clear();
+        instances.clear();
+
+        if (onFinished != nullptr)
+            onFinished(report, passed);
+    }
+
+    // Pokes the instances at random, much as a host's message thread would
+    void hostLoop() {
+        constexpr int intervalMs = 10;
+        const double chance = intervalMs / 1000.0;
+        vector<MemoryBlock> states;
+
+        while (!threadShouldExit() && std::any_of(workers.begin(), workers.end(), [](auto& w) { return w->isThreadRunning(); })) {
+            wait(intervalMs);
+
+            for (auto& instance : instances) {
+                auto& p = *instance->processor;
+
+                if (random.nextDouble() < options.automationRate * chance) {
+                    const auto& params = p.getParameters();
+                    params[random.nextInt(params.size())]->setValueNotifyingHost(random.nextFloat());
+                    automations++;
+                }
+
+                // states are taken from random instances, and loaded into random instances
+                if (random.nextDouble() < options.stateLoadRate * chance) {
+                    if (states.empty() || random.nextBool()) {
+                        states.emplace_back();
+                        p.getStateInformation(states.back());
+                    }
+                    else if (const MessageManagerLock mml(this); mml.lockWasGained()) {
+                        const auto& state = states[size_t(random.nextInt(int(states.size())))];
+                        p.setStateInformation(state.getData(), int(state.getSize()));
+                        stateLoads++;
+                    }
+                }
+
+                // (suspended, so its worker skips it rather than processing it half prepared)
+                if (random.nextDouble() < options.reprepareRate * chance) {
+                    if (const MessageManagerLock mml(this); mml.lockWasGained()) {
+                        p.suspendProcessing(true);
+                        p.releaseResources();
+                        p.prepareToPlay(options.sampleRate, options.blockSize);
+                        p.suspendProcessing(false);
+                        reprepares++;
+                    }
+                }
+            }
+        }
+    }
+
+    int getTotalMisses() const {
+        int misses = 0;
+
+        for (const auto& w : workers)
+            misses += w->misses;
+
+        return misses;
+    }
+
+    String createReport() const {
+        const double deadlineMs = 1000.0 * options.blockSize / options.sampleRate;
+        vector<float> times;
+        int cycles = 0;
+        double worstCycle = 0.0;
+
+        for (const auto& w : workers) {
+            times.insert(times.end(), w->blockTimes.begin(), w->blockTimes.end());
+            cycles += w->numCycles;
+            worstCycle = jmax(worstCycle, w->worstCycle);
+        }
+
+        std::sort(times.begin(), times.end());
+
+        const auto percentile = [&](double p) {
+            return times.empty() ? 0.0f : times[size_t(p / 100.0 * double(times.size() - 1))];
+        };
+
+        const int misses = getTotalMisses();
+        String s;
+
+        s << options.instances << " instances on " << options.threads << " threads, " << options.blockSize
+          << " samples at " << options.sampleRate << " Hz (" << String(deadlineMs, 3) << " ms deadline), "
+          << options.seconds << " s\n";
+
+        s << "cycles: " << cycles << ", deadline misses: " << misses
+          << " (" << String(100.0 * misses / jmax(1, cycles), 3) << "%), worst cycle: "
+          << String(worstCycle * 1000.0, 3) << " ms (" << String(100.0 * worstCycle * 1000.0 / deadlineMs, 1)
+          << "% of deadline)\n";
+
+        s << "block time (us): p50 " << String(percentile(50.0), 1) << ", p90 " << String(percentile(90.0), 1)
+          << ", p99 " << String(percentile(99.0), 1) << ", p99.9 " << String(percentile(99.9), 1)
+          << ", max " << String(percentile(100.0), 1) << "\n";
+
+        s << "host events: " << automations << " parameter changes, " << stateLoads << " state loads, "
+          << reprepares << " re-prepares\n";
+
+        return s;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(StressTest)
+};
@@ -0,0 +1,23 @@
+// The reference for the C API test (see CApiTest.c) — RiserProcessor run directly, the way the
+// library runs it, behind a C function the test can call
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "../Source/Components/RiserProcessor.h"
+
+// Process numFrames of stereo in place through a new processor, in calls of callFrames, each
+// split into pieces of at most maxPiece (as oneriser_process_interleaved() splits them)
+extern "C" void oneriser_reference_process(float* left, float* right, int numFrames, int callFrames, int maxPiece,
+                                           double sampleRate, int maxBlockSize, const float* amounts) {
+    RiserProcessor processor;
+    processor.prepare(uint(sampleRate + 0.5), maxBlockSize);
+    processor.setParameters(amounts[1], amounts[2], amounts[3], amounts[0]);
+
+    for (int call = 0; call < numFrames; call += callFrames) {
+        const int callEnd = jmin(numFrames, call + callFrames);
+
+        for (int start = call; start < callEnd; start += maxPiece) {
+            const int n = jmin(maxPiece, callEnd - start);
+            processor.process(left + start, right + start, n);
+        }
+    }
+}
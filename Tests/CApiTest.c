@@ -0,0 +1,224 @@
+/*
+ * ~ C API test ~
+ * A plain C program against the oneriser shared library (see Source/CApi/oneriser.h), run by
+ * CTest as oneriser_capi_tests — creates, prepares, processes and destroys handles through the
+ * C API only, and checks the output against RiserProcessor run directly (CApiReference.cpp).
+ *
+ * Covers planar and interleaved (stereo and mono) processing, with blocks that don't line up
+ * with the maximum block size, and a custom allocator whose every allocation must be freed.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "oneriser.h"
+
+#if defined(_WIN32)
+ #include <malloc.h>
+#endif
+
+/* RiserProcessor itself, in place (defined in CApiReference.cpp) */
+extern void oneriser_reference_process(float* left, float* right, int numFrames, int callFrames, int maxPiece,
+                                       double sampleRate, int maxBlockSize, const float* amounts);
+
+enum {
+    numFrames = 48000,
+    maxBlockSize = 256,
+    callFrames = 1000 /* (not a multiple of the maximum block, so interleaved calls are split unevenly) */
+};
+
+static const double sampleRate = 48000.0;
+static const float amounts[4] = { 0.9f, 0.8f, 0.6f, 0.7f }; /* master, flanger, filter, reverb */
+
+/* (the library and the reference are built separately, so a compiler may round a little differently) */
+static const float tolerance = 1.0e-5f;
+
+static int numFailed = 0;
+
+static void report(const char* name, int passed, float maxDiff) {
+    printf("%s  %-38s%.3g max diff\n", passed ? "PASS" : "FAIL", name, (double) maxDiff);
+
+    if (!passed)
+        numFailed++;
+}
+
+/* Deterministic noise with a slow sine under it, so the flanger and filters have something to move */
+static void generate(float* dest, int num, unsigned seed) {
+    unsigned state = seed * 2654435761u + 1u;
+
+    for (int i = 0; i < num; i++) {
+        state = state * 1664525u + 1013904223u;
+        const float noise = (float) (state >> 8) / 16777216.0f * 2.0f - 1.0f;
+        dest[i] = 0.25f * noise + 0.5f * (float) sin(0.01 * (double) i);
+    }
+}
+
+static float maxDifference(const float* a, const float* b, int num) {
+    float maxDiff = 0.0f;
+
+    for (int i = 0; i < num; i++) {
+        const float diff = fabsf(a[i] - b[i]);
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+    }
+
+    return maxDiff;
+}
+
+/* Counts what's still allocated, which must be nothing once the handle is destroyed */
+typedef struct {
+    int numLive;
+} AllocationCount;
+
+static void* countedAllocate(void* context, size_t numBytes, size_t alignment) {
+    ((AllocationCount*) context)->numLive++;
+
+#if defined(_WIN32)
+    return _aligned_malloc(numBytes, alignment);
+#else
+    /* (aligned_alloc() wants a multiple of the alignment) */
+    return aligned_alloc(alignment, (numBytes + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void countedDeallocate(void* context, void* memory, size_t numBytes, size_t alignment) {
+    (void) numBytes;
+    (void) alignment;
+    ((AllocationCount*) context)->numLive--;
+
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+static oneriser* createPrepared(const oneriser_allocator* allocator) {
+    oneriser* riser = allocator != NULL ? oneriser_create_with_allocator(allocator) : oneriser_create();
+
+    if (riser == NULL)
+        return NULL;
+
+    if (oneriser_prepare(riser, sampleRate, maxBlockSize) != ONERISER_OK
+        || oneriser_set_amounts(riser, amounts[0], amounts[1], amounts[2], amounts[3]) != ONERISER_OK) {
+        oneriser_destroy(riser);
+        return NULL;
+    }
+
+    return riser;
+}
+
+static void testArguments(void) {
+    oneriser* riser = oneriser_create();
+    float left[4] = { 0 }, right[4] = { 0 };
+
+    const int passed = oneriser_get_api_version() == ONERISER_API_VERSION && riser != NULL
+                    && oneriser_process_planar(riser, left, right, 4) == ONERISER_ERROR_NOT_PREPARED
+                    && oneriser_prepare(riser, 0.0, maxBlockSize) == ONERISER_ERROR_INVALID_ARGUMENT
+                    && oneriser_process_planar(NULL, left, right, 4) == ONERISER_ERROR_INVALID_ARGUMENT
+                    && oneriser_create_with_allocator(NULL) == NULL;
+
+    oneriser_destroy(riser);
+    oneriser_destroy(NULL);
+    report("C API arguments", passed, 0.0f);
+}
+
+static void testPlanar(float* left, float* right, float* expectedL, float* expectedR) {
+    oneriser* riser = createPrepared(NULL);
+    int passed = riser != NULL;
+
+    for (int start = 0; passed && start < numFrames; start += callFrames) {
+        const int n = numFrames - start < callFrames ? numFrames - start : callFrames;
+        passed = oneriser_process_planar(riser, left + start, right + start, n) == ONERISER_OK;
+    }
+
+    oneriser_destroy(riser);
+
+    /* (planar blocks go to the processor whole, however long) */
+    oneriser_reference_process(expectedL, expectedR, numFrames, callFrames, callFrames, sampleRate, maxBlockSize, amounts);
+
+    const float l = maxDifference(left, expectedL, numFrames), r = maxDifference(right, expectedR, numFrames);
+    const float maxDiff = l > r ? l : r;
+    report("C API planar (stereo)", passed && maxDiff <= tolerance, maxDiff);
+}
+
+static void testInterleaved(int numChannels, const float* left, const float* right, float* expectedL, float* expectedR) {
+    AllocationCount count = { 0 };
+    const oneriser_allocator allocator = { countedAllocate, countedDeallocate, &count };
+
+    float* data = malloc(sizeof(float) * (size_t) numFrames * (size_t) numChannels);
+    oneriser* riser = createPrepared(&allocator);
+    int passed = data != NULL && riser != NULL;
+
+    for (int i = 0; data != NULL && i < numFrames; i++) {
+        data[i * numChannels] = left[i];
+
+        if (numChannels > 1)
+            data[i * numChannels + 1] = right[i];
+    }
+
+    for (int start = 0; passed && start < numFrames; start += callFrames) {
+        const int n = numFrames - start < callFrames ? numFrames - start : callFrames;
+        passed = oneriser_process_interleaved(riser, data + start * numChannels, n, numChannels) == ONERISER_OK;
+    }
+
+    oneriser_destroy(riser);
+    passed = passed && count.numLive == 0;
+
+    /* (mono is both sides of the processor, written back as their average) */
+    if (numChannels == 1)
+        memcpy(expectedR, expectedL, sizeof(float) * numFrames);
+
+    oneriser_reference_process(expectedL, expectedR, numFrames, callFrames, maxBlockSize, sampleRate, maxBlockSize, amounts);
+
+    float maxDiff = 0.0f;
+
+    for (int i = 0; data != NULL && i < numFrames; i++) {
+        const float l = numChannels > 1 ? expectedL[i] : 0.5f * (expectedL[i] + expectedR[i]);
+        float diff = fabsf(data[i * numChannels] - l);
+
+        if (numChannels > 1) {
+            const float r = fabsf(data[i * numChannels + 1] - expectedR[i]);
+            diff = r > diff ? r : diff;
+        }
+
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+    }
+
+    free(data);
+    report(numChannels > 1 ? "C API interleaved (stereo)" : "C API interleaved (mono)", passed && maxDiff <= tolerance, maxDiff);
+}
+
+int main(void) {
+    float* left = malloc(sizeof(float) * numFrames);
+    float* right = malloc(sizeof(float) * numFrames);
+    float* expectedL = malloc(sizeof(float) * numFrames);
+    float* expectedR = malloc(sizeof(float) * numFrames);
+
+    if (left == NULL || right == NULL || expectedL == NULL || expectedR == NULL)
+        return 1;
+
+    testArguments();
+
+    generate(left, numFrames, 1);
+    generate(right, numFrames, 2);
+    memcpy(expectedL, left, sizeof(float) * numFrames);
+    memcpy(expectedR, right, sizeof(float) * numFrames);
+    testPlanar(left, right, expectedL, expectedR);
+
+    generate(left, numFrames, 1);
+    generate(right, numFrames, 2);
+    memcpy(expectedL, left, sizeof(float) * numFrames);
+    memcpy(expectedR, right, sizeof(float) * numFrames);
+    testInterleaved(2, left, right, expectedL, expectedR);
+
+    memcpy(expectedL, left, sizeof(float) * numFrames);
+    testInterleaved(1, left, right, expectedL, expectedR);
+
+    free(left);
+    free(right);
+    free(expectedL);
+    free(expectedR);
+
+    return numFailed == 0 ? 0 : 1;
+}
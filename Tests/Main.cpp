@@ -0,0 +1,24 @@
+// The DSP test runner (see NullTest.h), run by CTest
+// - oneriser_tests, runs the null tests, exits with 1 on a failure
+// - oneriser_tests --benchmarks, runs the benchmarks after them, which are only reported
+#include <cstdio>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include "NullTest.h"
+
+int main(int argc, char* argv[]) {
+    const ArgumentList args(argc, argv);
+
+    const auto results = pa::nulltest::runAll();
+
+    for (const auto& r : results)
+        std::printf("%s\n", r.toString().toRawUTF8());
+
+    if (args.containsOption("--benchmarks")) {
+        for (const auto& b : pa::nulltest::runBenchmarks())
+            std::printf("%s\n", b.toString().toRawUTF8());
+    }
+
+    return pa::nulltest::allPassed(results) ? 0 : 1;
+}
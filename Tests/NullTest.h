@@ -0,0 +1,1801 @@
+#pragma once
+#include "Reference.h"
+#include "../Source/Components/RiserProcessor.h"
+#include "../Source/Components/RiserBank.h"
+#include "../Source/Components/ChunkedRender.h"
+#include "../Source/Components/ShadowSwap.h"
+#include "../Source/Components/CpuGovernor.h"
+#include "../Source/Components/StreamingRender.h"
+
+/*
+ * ~ Null tests ~
+ * Runs the processors and their frozen references (Reference.h) side by side over
+ * deterministic signals and parameter automation, and measures the difference.
+ *
+ * Each stage has a bound on the difference signal's peak level and on the largest
+ * ULP (units in the last place) distance between samples. ULPs are only counted
+ * where the reference is above ulpFloor — near zero a tiny, inaudible difference
+ * is a huge number of ULPs, and the level bound covers those samples instead.
+ *
+ * Timings can't pass or fail like this on a shared or loaded machine, so they're kept apart
+ * as benchmarks (runBenchmarks()), which are only ever reported.
+ *
+ * Run these after any SIMD, block or fast-maths rewrite of the processors or pa::math
+ * (they're the oneriser_tests target, run by CTest).
+*/
+
+namespace pa::nulltest {
+
+// Deterministic test signals
+enum class Signal {
+    impulses,
+    sweep,
+    noise
+};
+
+static constexpr array<Signal, 3> allSignals { Signal::impulses, Signal::sweep, Signal::noise };
+
+// Difference bounds for a stage
+struct Tolerance {
+    double maxDiffDb = -120.0;
+    int64 maxUlps = 0;
+};
+
+// One stage run over one signal
+struct Result {
+    String stage, signal;
+    double diffDb = 0.0;
+    int64 maxUlps = 0;
+    bool passed = false;
+
+    String toString() const {
+        return (passed ? "PASS  " : "FAIL  ") + stage.paddedRight(' ', 38) + signal.paddedRight(' ', 10)
+             + String(diffDb, 1) + " dB, " + String(maxUlps) + " ulps";
+    }
+};
+
+// A timing, in the units given — reported, never passed or failed
+struct Benchmark {
+    String name, signal;
+    double value = 0.0;
+    String unit;
+
+    String toString() const {
+        return "BENCH " + name.paddedRight(' ', 38) + signal.paddedRight(' ', 10) + String(value, 1) + " " + unit;
+    }
+};
+
+static constexpr float ulpFloor = 0.001f; // -60 dBFS
+static constexpr int automationBlockSize = 64;
+
+static const char* getSignalName(Signal signal) {
+    switch (signal) {
+        case Signal::impulses: return "impulses";
+        case Signal::sweep:    return "sweep";
+        case Signal::noise:    return "noise";
+    }
+
+    return "";
+}
+
+// Fill a buffer with a test signal (the same seed always gives the same noise)
+static void generate(Signal signal, float* dest, int numSamples, uint sampleRate, uint32 seed = 1) {
+    switch (signal) {
+        case Signal::impulses:
+            // one every quarter second, alternating in polarity
+            for (int i = 0; i < numSamples; i++)
+                dest[i] = (i % int(sampleRate / 4) == 0) ? ((i / int(sampleRate / 4)) % 2 == 0 ? 0.9f : -0.9f) : 0.0f;
+            break;
+        case Signal::sweep: {
+            // exponential sine sweep, 20 Hz - 20 kHz over the whole buffer
+            const double length = double(numSamples) / sampleRate, ratio = std::log(20000.0 / 20.0);
+            for (int i = 0; i < numSamples; i++) {
+                const double t = double(i) / sampleRate;
+                dest[i] = 0.5f * float(std::sin(2.0 * M_PI * 20.0 * length / ratio * (std::exp(t / length * ratio) - 1.0)));
+            }
+            break;
+        }
+        case Signal::noise:
+            // (a plain LCG, so it's the same on every platform)
+            for (int i = 0; i < numSamples; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                dest[i] = float(seed >> 8) / float(1 << 24) - 0.5f;
+            }
+            break;
+    }
+}
+
+// The amount automated for a block: ramps, holds, jumps and block-to-block flicker, all within 0 - 1
+static float automation(int blockIndex) {
+    const int i = blockIndex % 64;
+
+    if (i < 16) return float(i) / 15.0f;
+    if (i < 24) return 1.0f;
+    if (i < 40) return 0.2f;
+    if (i < 56) return 0.2f + 0.5f * float(i - 40) / 15.0f;
+
+    return (i % 2 == 0) ? 0.9f : 0.1f;
+}
+
+// Distance between two floats in representable steps (huge if either is NaN)
+static int64 ulpDistance(float a, float b) {
+    if (std::isnan(a) || std::isnan(b))
+        return std::numeric_limits<int32>::max();
+
+    // map the bit patterns onto a monotonic integer line
+    const auto toOrdered = [](float f) {
+        int32 i;
+        std::memcpy(&i, &f, sizeof(f));
+        return (i < 0) ? int64(std::numeric_limits<int32>::min()) - int64(i) : int64(i);
+    };
+
+    return std::abs(toOrdered(a) - toOrdered(b));
+}
+
+// Accumulates the difference between a reference and a test signal
+struct Metrics {
+    float peakDiff = 0.0f;
+    int64 maxUlps = 0;
+
+    void add(const float* reference, const float* test, int numSamples) {
+        for (int i = 0; i < numSamples; i++) {
+            const float diff = std::abs(reference[i] - test[i]);
+            peakDiff = std::isnan(diff) ? std::numeric_limits<float>::infinity() : jmax(peakDiff, diff);
+
+            if (std::abs(reference[i]) >= ulpFloor || std::isnan(test[i]))
+                maxUlps = jmax(maxUlps, ulpDistance(reference[i], test[i]));
+        }
+    }
+
+    Result getResult(const String& stage, const String& signal, const Tolerance& tolerance) const {
+        Result r { stage, signal, Decibels::gainToDecibels(double(peakDiff), -400.0), maxUlps, false };
+        r.passed = r.diffDb <= tolerance.maxDiffDb && r.maxUlps <= tolerance.maxUlps;
+        return r;
+    }
+};
+
+// Runs the reference (per sample) and the processor under test (however it likes) over
+// every signal, with both parameters updated every block
+template <typename ReferenceType, typename TestType, typename SetParameters, typename ProcessTest>
+static void compareMono(vector<Result>& results, const String& stage, const Tolerance& tolerance,
+                        uint sampleRate, int numSamples, SetParameters&& setParameters, ProcessTest&& processTest) {
+    vector<float> reference(static_cast<size_t>(numSamples)), test(reference.size());
+
+    for (auto signal : allSignals) {
+        ReferenceType ref;
+        TestType proc;
+
+        generate(signal, reference.data(), numSamples, sampleRate);
+        test = reference;
+
+        // (set before and after preparing, so delays start at their targets and filters have coefficients)
+        setParameters(ref, proc, automation(0));
+        ref.prepare(sampleRate);
+        proc.prepare(sampleRate);
+
+        Metrics metrics;
+
+        for (int start = 0, block = 0; start < numSamples; start += automationBlockSize, block++) {
+            const int n = jmin(automationBlockSize, numSamples - start);
+            setParameters(ref, proc, automation(block));
+
+            for (int i = start; i < start + n; i++)
+                reference[size_t(i)] = ref.process(reference[size_t(i)]);
+
+            processTest(proc, test.data() + start, n);
+            metrics.add(reference.data() + start, test.data() + start, n);
+        }
+
+        results.push_back(metrics.getResult(stage, getSignalName(signal), tolerance));
+    }
+}
+
+                // Stages
+static void testCombFilter(vector<Result>& results, uint sampleRate, int numSamples) {
+    // (the wide kernels' FMA rounding recirculates through the feedback, so this is looser)
+    constexpr Tolerance tolerance { -120.0, 2048 };
+
+    for (auto interp : { pa::dsp::noInterp, pa::dsp::linearInterp, pa::dsp::cubicInterp }) {
+        const String stage = String("CombFilter ") + (interp == pa::dsp::noInterp     ? "(none)"
+                                                    : interp == pa::dsp::linearInterp ? "(linear)" : "(cubic)");
+
+        compareMono<pa::reference::CombFilter, pa::dsp::CombFilter>(results, stage, tolerance, sampleRate, numSamples,
+            [interp](auto& ref, auto& proc, float amount) {
+                auto s = RiserProcessor::defaultSettings();
+                RiserProcessor::mapSettings(s, amount, 0.0f, 0.0f);
+                s.flanger.interpType = interp;
+
+                ref.setParameters(s.flanger, s.flangerOffset);
+                proc.setParameters(s.flanger, s.flangerOffset);
+            },
+            [](auto& proc, float* data, int n) { proc.process(data, n); });
+    }
+}
+
+// The flanger's modulated delay reads (see RiserProcessor::processFlanger()) — the delay time
+// is scaled sample by sample by a sine whose rate sweeps from 0.05 to 10 Hz, swinging the reads
+// between half and one and a half times the delay (and so below a block, onto the per-sample path)
+static void testCombFilterModulation(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr Tolerance tolerance { -120.0, 2048 }; // (as in testCombFilter())
+    vector<float> modulation(static_cast<size_t>(numSamples));
+    double phase = 0.0;
+
+    for (size_t i = 0; i < modulation.size(); i++) {
+        phase += 0.05 * std::pow(200.0, double(i) / double(numSamples)) / double(sampleRate);
+        modulation[i] = float(1.0 + 0.5 * std::sin(2.0 * M_PI * phase));
+    }
+
+    vector<float> reference(modulation.size()), test(modulation.size());
+
+    for (auto interp : { pa::dsp::noInterp, pa::dsp::linearInterp, pa::dsp::cubicInterp }) {
+        const String stage = String("CombFilter modulated ") + (interp == pa::dsp::noInterp     ? "(none)"
+                                                              : interp == pa::dsp::linearInterp ? "(linear)" : "(cubic)");
+
+        for (auto signal : allSignals) {
+            pa::reference::CombFilter ref;
+            pa::dsp::CombFilter proc;
+
+            generate(signal, reference.data(), numSamples, sampleRate);
+            test = reference;
+
+            const auto setParameters = [&](float amount) {
+                auto s = RiserProcessor::defaultSettings();
+                RiserProcessor::mapSettings(s, amount, 0.0f, 0.0f);
+                s.flanger.interpType = interp;
+
+                ref.setParameters(s.flanger, s.flangerOffset);
+                proc.setParameters(s.flanger, s.flangerOffset);
+            };
+
+            setParameters(automation(0));
+            ref.prepare(sampleRate);
+            proc.prepare(sampleRate);
+
+            Metrics metrics;
+
+            for (int start = 0, block = 0; start < numSamples; start += automationBlockSize, block++) {
+                const int n = jmin(automationBlockSize, numSamples - start);
+                setParameters(automation(block));
+
+                for (size_t i = size_t(start); i < size_t(start + n); i++)
+                    reference[i] = ref.process(reference[i], modulation[i]);
+
+                proc.process(test.data() + start, n, modulation.data() + start);
+                metrics.add(reference.data() + start, test.data() + start, n);
+            }
+
+            results.push_back(metrics.getResult(stage, getSignalName(signal), tolerance));
+        }
+    }
+}
+
+// The LFO against std::sin() — its wavetable's interpolation error is bounded at 1.9e-5 (see
+// LFO.h), over blocks of every length, at slow to fast rates, with phase offsets outside 0 - 1
+// and with setPhase() jumps outside it too (which wrap)
+static void testLfo(vector<Result>& results, uint sampleRate) {
+    constexpr int maxBlockSize = 256, numBlocks = 4096;
+    const Tolerance tolerance { Decibels::gainToDecibels(1.9e-5), std::numeric_limits<int64>::max() };
+
+    Metrics metrics;
+
+    for (double frequency : { 0.05, 1.3, 9.7, 400.0 }) {
+        for (float phaseOffset : { 0.0f, 0.25f, 0.5f, 1.75f, -0.3f }) {
+            pa::dsp::LFO lfo;
+            lfo.prepare(sampleRate);
+            lfo.setFrequency(frequency);
+
+            const double increment = frequency / double(sampleRate);
+            const double offset = double(phaseOffset) - std::floor(double(phaseOffset));
+            double phase = 0.0;
+
+            array<float, maxBlockSize> left {}, right {}, expectedL {}, expectedR {};
+
+            for (int block = 0; block < numBlocks; block++) {
+                // (jumps now and then, landing either side of 0 - 1)
+                if (block % 512 == 511) {
+                    const double jump = (block / 512) % 2 == 0 ? 2.3 + phase : -0.4 - phase;
+                    lfo.setPhase(jump);
+                    phase = jump;
+                }
+
+                const int n = 1 + (block * 37) % maxBlockSize;
+                lfo.process(left.data(), right.data(), n, phaseOffset);
+
+                for (int i = 0; i < n; i++) {
+                    const double p = phase + increment * double(i);
+                    expectedL[size_t(i)] = float(std::sin(2.0 * M_PI * p));
+                    expectedR[size_t(i)] = float(std::sin(2.0 * M_PI * (p + offset)));
+                }
+
+                metrics.add(expectedL.data(), left.data(), n);
+                metrics.add(expectedR.data(), right.data(), n);
+                phase += increment * double(n);
+            }
+        }
+    }
+
+    results.push_back(metrics.getResult("LFO", "sine", tolerance));
+}
+
+static void testFilter(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr Tolerance tolerance { -120.0, 16 };
+
+    for (bool lowpass : { true, false }) {
+        compareMono<pa::reference::Filter, pa::dsp::Filter>(results, lowpass ? "Filter (lowpass)" : "Filter (highpass)",
+                                                            tolerance, sampleRate, numSamples,
+            [lowpass](auto& ref, auto& proc, float amount) {
+                auto s = RiserProcessor::defaultSettings();
+                RiserProcessor::mapSettings(s, 0.0f, amount, 0.0f);
+
+                ref.setParameters(lowpass ? s.lowpass : s.highpass);
+                proc.setParameters(lowpass ? s.lowpass : s.highpass);
+            },
+            [](auto& proc, float* data, int n) { proc.process(data, n); });
+    }
+}
+
+static void testReverb(vector<Result>& results, uint sampleRate, int numSamples) {
+    // (the wide comb kernels' FMA rounding recirculates through the feedback, as in testCombFilter())
+    constexpr Tolerance tolerance { -110.0, 2048 };
+    vector<float> refL(static_cast<size_t>(numSamples)), refR(refL.size());
+
+    for (auto signal : allSignals) {
+        pa::reference::Reverb ref;
+        pa::dsp::Reverb proc;
+
+        ref.setCombTimes(RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+        proc.setCombTimes(RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+
+        // (the right channel gets a different noise seed)
+        generate(signal, refL.data(), numSamples, sampleRate, 1);
+        generate(signal, refR.data(), numSamples, sampleRate, 2);
+        auto testL = refL, testR = refR;
+
+        const auto setParameters = [&](float amount) {
+            auto s = RiserProcessor::defaultSettings();
+            RiserProcessor::mapSettings(s, 0.0f, 0.0f, amount);
+
+            ref.setParameters(s.reverb);
+            proc.setParameters(s.reverb);
+        };
+
+        setParameters(automation(0));
+        ref.prepare(sampleRate);
+        proc.prepare(sampleRate);
+
+        Metrics metrics;
+
+        for (int start = 0, block = 0; start < numSamples; start += automationBlockSize, block++) {
+            const int end = jmin(start + automationBlockSize, numSamples);
+            setParameters(automation(block));
+
+            for (size_t i = size_t(start); i < size_t(end); i++)
+                ref.process(&refL[i], &refR[i]);
+
+            // (a block at a time, so the combs run through the block kernels)
+            proc.process(testL.data() + start, testR.data() + start, end - start);
+
+            metrics.add(refL.data() + start, testL.data() + start, end - start);
+            metrics.add(refR.data() + start, testR.data() + start, end - start);
+        }
+
+        results.push_back(metrics.getResult("Reverb", getSignalName(signal), tolerance));
+    }
+}
+
+// The decimated reverb (see Reverb::setMultirate()) against the full-rate one, at 96 and 192 kHz —
+// a second of band-limited noise and then its tail, compared as the level of each 0.1 s of the tail
+// until it's 80 dB down, which should hardly differ
+// - band-limited well below the internal rate's band: decimation drops everything above it (white
+//   noise's tail comes out 3 dB down at 96 kHz, and 6 dB at 192 kHz), and the combs' one-pole damping
+//   works per sample, so the higher a frequency the more it's damped at the lower rate (as it would
+//   be at 44.1/48 kHz, which is the point) — by 1 dB of tail at 2 kHz, and a few at 8 kHz
+// - the result is the largest difference between the two levels, in dB
+static void testReverbMultirate(vector<Result>& results) {
+    constexpr double maxDiffDb = 0.5, noiseSeconds = 1.0, tailSeconds = 4.0, windowSeconds = 0.1;
+
+    for (uint rate : { 96000u, 192000u }) {
+        const int numNoise = int(noiseSeconds * rate), numSamples = numNoise + int(tailSeconds * rate);
+        vector<float> inputL(size_t(numSamples), 0.0f), inputR(inputL.size(), 0.0f);
+
+        generate(Signal::noise, inputL.data(), numNoise, rate, 1);
+        generate(Signal::noise, inputR.data(), numNoise, rate, 2);
+
+        // (two 12 dB/oct lowpasses at 500 Hz)
+        for (auto* channel : { &inputL, &inputR }) {
+            for (int pass = 0; pass < 2; pass++) {
+                pa::dsp::Filter lowpass;
+                lowpass.prepare(rate);
+                lowpass.setParameters({ pa::dsp::Filter::lowpass, 500.0, M_SQRT1_2, true });
+                lowpass.process(channel->data(), numNoise);
+            }
+        }
+
+        // the level of each window of the tail
+        const auto tailLevels = [&](bool multirate) {
+            pa::dsp::Reverb reverb;
+            reverb.setCombTimes(RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+            reverb.setMultirate(multirate);
+
+            auto s = RiserProcessor::defaultSettings();
+            RiserProcessor::mapSettings(s, 0.0f, 0.0f, 1.0f);
+            reverb.setParameters(s.reverb);
+            reverb.prepare(rate);
+
+            auto left = inputL, right = inputR;
+
+            for (int start = 0; start < numSamples; start += 512)
+                reverb.process(left.data() + start, right.data() + start, jmin(512, numSamples - start));
+
+            const int windowSize = int(windowSeconds * rate);
+            vector<double> levels;
+
+            for (int start = numNoise; start + windowSize <= numSamples; start += windowSize) {
+                double energy = 0.0;
+
+                for (int i = start; i < start + windowSize; i++)
+                    energy += double(left[size_t(i)]) * left[size_t(i)] + double(right[size_t(i)]) * right[size_t(i)];
+
+                levels.push_back(10.0 * std::log10(jmax(energy, 1.0e-30)));
+            }
+
+            return levels;
+        };
+
+        const auto fullRate = tailLevels(false), decimated = tailLevels(true);
+        double maxDiff = 0.0;
+
+        for (size_t i = 0; i < fullRate.size() && fullRate[i] > fullRate[0] - 80.0; i++)
+            maxDiff = jmax(maxDiff, std::abs(decimated[i] - fullRate[i]));
+
+        Result r { "Reverb multirate tail (" + String(int(rate / 1000)) + " kHz)", "noise", maxDiff, 0, maxDiff <= maxDiffDb };
+        results.push_back(r);
+    }
+}
+
+// The file sample conversions, through the selected kernels — to integers exactly as rounding
+// the scaled sample (clipped) to nearest would, and back to within half a step of the clipped sample
+static void testConversion(vector<Result>& results, uint sampleRate, int numSamples) {
+    const auto& kernels = pa::dsp::kernels::get();
+
+    // (loud enough to clip now and then, with both ends of the range exactly)
+    vector<float> input(static_cast<size_t>(numSamples));
+    generate(Signal::noise, input.data(), numSamples, sampleRate);
+
+    for (auto& x : input)
+        x *= 1.5f;
+
+    input[0] = 1.0f;
+    input[1] = -1.0f;
+
+    for (int bitDepth : { 16, 24 }) {
+        const double scale = double(1 << (bitDepth - 1));
+        vector<int> converted(input.size());
+        vector<float> clipped(input.size()), roundTrip(input.size());
+
+        kernels.floatToInt(input.data(), converted.data(), bitDepth, numSamples);
+        kernels.intToFloat(converted.data(), roundTrip.data(), numSamples);
+
+        int64 mismatches = 0;
+
+        for (size_t i = 0; i < input.size(); i++) {
+            const double x = jlimit(-scale, scale - 1.0, double(input[i] * float(scale)));
+            const auto expected = int64(x < 0.0 ? std::ceil(x - 0.5) : std::floor(x + 0.5)) * (int64(1) << (32 - bitDepth));
+
+            mismatches += (int64(converted[i]) != expected) ? 1 : 0;
+            clipped[i] = jlimit(-1.0f, 1.0f, input[i]);
+        }
+
+        Metrics metrics;
+        metrics.add(clipped.data(), roundTrip.data(), numSamples);
+
+        // (a step below full scale is as high as the integers go, so that's the furthest from a clipped sample)
+        auto result = metrics.getResult("Sample conversion (" + String(bitDepth) + " bit)", getSignalName(Signal::noise),
+                                        { Decibels::gainToDecibels(1.0 / scale), std::numeric_limits<int64>::max() });
+        result.passed = result.passed && mismatches == 0;
+        results.push_back(result);
+    }
+}
+
+static void testMaths(vector<Result>& results) {
+    constexpr Tolerance tolerance { -140.0, 2 };
+    constexpr int numPoints = 1 << 16;
+
+    // compares fn(x) over x in [min, max] against its reference
+    const auto compare = [&](const String& name, float min, float max, auto&& referenceFn, auto&& testFn) {
+        Metrics metrics;
+
+        for (int i = 0; i < numPoints; i++) {
+            const float x = min + (max - min) * float(i) / float(numPoints - 1);
+            const float r = referenceFn(x), t = testFn(x);
+            metrics.add(&r, &t, 1);
+        }
+
+        results.push_back(metrics.getResult(name, "range", tolerance));
+    };
+
+    const float range = 4.0f * float(M_PI);
+    compare("math::fastSin", -range, range, [](float x) { return pa::reference::math::fastSin(x); },
+                                            [](float x) { return pa::math::fastSin(x); });
+    compare("math::fastCos", -range, range, [](float x) { return pa::reference::math::fastCos(x); },
+                                            [](float x) { return pa::math::fastCos(x); });
+    // (kept away from the asymptotes at +/- pi/2)
+    compare("math::fastTan", -1.5f, 1.5f, [](float x) { return pa::reference::math::fastTan(x); },
+                                          [](float x) { return pa::math::fastTan(x); });
+
+    for (float curve : { -0.6f, -0.3f, 0.3f, 0.8f })
+        compare("math::expRounder " + String(curve, 1), -1.0f, 1.0f,
+                [curve](float x) { return pa::reference::math::expRounder(x, curve); },
+                [curve](float x) { return pa::math::expRounder(x, curve); });
+}
+
+// A processor restored from a snapshot against the one the snapshot was taken from, over
+// the rest of the signal — they should be identical
+// - the amounts change every block, much faster than the smoothers ramp, so the
+//   snapshot catches them all mid-ramp
+// - the multirate run uses another effect order, which the snapshot has to restore too
+static void testSnapshots(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr Tolerance tolerance { -400.0, 0 };
+    const int snapshotAt = (numSamples / 2 / automationBlockSize) * automationBlockSize;
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size());
+    generate(Signal::noise, inL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numSamples, sampleRate, 2);
+
+    // (at twice the rate the reverb is decimated, so its resampling state is covered too)
+    for (bool multirate : { false, true }) {
+        const uint rate = multirate ? sampleRate * 2 : sampleRate;
+        RiserProcessor original, restored;
+
+        RiserProcessor::Modulation m;
+        m.depth = 0.5f;
+
+        for (auto* p : { &original, &restored }) {
+            p->setReverbMultirate(multirate);
+            p->setModulation(m);
+            p->prepare(rate);
+        }
+
+        if (multirate)
+            original.setOrder(RiserProcessor::Order::filteredWash);
+
+        const auto processBlock = [&](RiserProcessor& p, float* l, float* r, int block, int n) {
+            const float amount = automation(block);
+            p.setParameters(amount, 1.0f - amount, amount, 0.5f + 0.5f * amount);
+            p.process(l, r, n);
+        };
+
+        auto originalL = inL, originalR = inR;
+        auto restoredL = inL, restoredR = inR;
+        bool readBack = false;
+
+        // (the restored processor runs over different audio, with different amounts, until the snapshot)
+        std::fill_n(restoredL.begin(), snapshotAt, 0.25f);
+        std::fill_n(restoredR.begin(), snapshotAt, -0.25f);
+        restored.setParameters(1.0f, 1.0f, 1.0f, 1.0f);
+        restored.process(restoredL.data(), restoredR.data(), snapshotAt);
+
+        for (int start = 0, block = 0; start < numSamples; start += automationBlockSize, block++) {
+            const int n = jmin(automationBlockSize, numSamples - start);
+
+            if (start == snapshotAt) {
+                MemoryBlock snapshot;
+
+                {
+                    MemoryOutputStream stream(snapshot, false);
+                    original.writeSnapshot(stream);
+                }
+
+                MemoryInputStream stream(snapshot, false);
+                readBack = restored.readSnapshot(stream);
+            }
+
+            processBlock(original, originalL.data() + start, originalR.data() + start, block, n);
+
+            if (start >= snapshotAt)
+                processBlock(restored, restoredL.data() + start, restoredR.data() + start, block, n);
+        }
+
+        Metrics metrics;
+        metrics.add(originalL.data() + snapshotAt, restoredL.data() + snapshotAt, numSamples - snapshotAt);
+        metrics.add(originalR.data() + snapshotAt, restoredR.data() + snapshotAt, numSamples - snapshotAt);
+
+        auto result = metrics.getResult(multirate ? "Snapshot restore (multirate)" : "Snapshot restore",
+                                        getSignalName(Signal::noise), tolerance);
+        result.passed = result.passed && readBack;
+        results.push_back(result);
+    }
+}
+
+// The mapping tables against the exact mappings they're sampled from, over a much finer sweep
+// - each value's error is relative to its range, the filter coefficients' is absolute
+static void testMappingTables(vector<Result>& results, uint sampleRate) {
+    constexpr double maxErrorDb = -80.0;
+    constexpr int numPoints = 1 << 14;
+
+    const RiserProcessor::MappingTables tables(sampleRate);
+
+    const auto values = [](const RiserProcessor::Settings& s) {
+        return array<double, 12> { s.flanger.wet, s.flanger.freq, s.flanger.feedback, s.flangerOffset,
+                                   s.lowpass.cutoff, s.lowpass.q, s.highpass.cutoff, s.highpass.q,
+                                   s.reverb.mix, s.reverb.size, s.reverb.width, s.reverb.spread };
+    };
+
+    const auto exact = [](float x) {
+        auto s = RiserProcessor::defaultSettings();
+        RiserProcessor::mapSettings(s, x, x, x);
+        return s;
+    };
+
+    // (every mapping is monotonic, so the ends give the range)
+    const auto first = values(exact(0.0f)), last = values(exact(1.0f));
+    double maxValueError = 0.0, maxCoefficientError = 0.0;
+
+    for (int i = 0; i < numPoints; i++) {
+        const float x = float(i) / float(numPoints - 1);
+        const auto s = exact(x);
+
+        auto looked = RiserProcessor::defaultSettings();
+        RiserProcessor::lookupSettings(looked, tables, x, x, x);
+
+        const auto e = values(s), t = values(looked);
+
+        for (size_t v = 0; v < e.size(); v++)
+            maxValueError = jmax(maxValueError, std::abs(e[v] - t[v]) / jmax(1.0e-9, std::abs(last[v] - first[v])));
+
+        const auto lp = pa::dsp::Filter::calculateCoefficients(s.lowpass, sampleRate),
+                   hp = pa::dsp::Filter::calculateCoefficients(s.highpass, sampleRate);
+        const array<double, 10> c { lp.a0, lp.a1, lp.a2, lp.b1, lp.b2, hp.a0, hp.a1, hp.a2, hp.b1, hp.b2 };
+        const auto ct = tables.filterCoefficients.lookup(double(x));
+
+        for (size_t j = 0; j < c.size(); j++)
+            maxCoefficientError = jmax(maxCoefficientError, std::abs(c[j] - ct[j]));
+    }
+
+    const auto addResult = [&](const String& stage, double error) {
+        Result r;
+        r.stage = stage;
+        r.signal = "sweep";
+        r.diffDb = 20.0 * std::log10(jmax(error, 1.0e-20));
+        r.passed = r.diffDb <= maxErrorDb;
+        results.push_back(r);
+    };
+
+    addResult("RiserProcessor mapping tables", maxValueError);
+    addResult("RiserProcessor filter tables", maxCoefficientError);
+}
+
+// A processor that's been running (long enough for every delay line to wrap) and is then
+// reset, against a fresh one — the reset doesn't zero the delay lines (see RingBuffer), so
+// this checks that nothing left in them is ever read back
+// - it's reset twice, the second time before the delay lines are written all the way round
+static void testReset(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr Tolerance tolerance { -400.0, 0 };
+
+    vector<float> freshL(static_cast<size_t>(numSamples)), freshR(freshL.size());
+    generate(Signal::noise, freshL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, freshR.data(), numSamples, sampleRate, 2);
+
+    for (bool multirate : { false, true }) {
+        const uint rate = multirate ? sampleRate * 2 : sampleRate;
+        RiserProcessor fresh, used;
+
+        for (auto* p : { &fresh, &used }) {
+            p->setReverbMultirate(multirate);
+            p->setParameters(0.8f, 0.7f, 1.0f, 1.0f);
+            p->prepare(rate);
+        }
+
+        vector<float> junkL(size_t(rate) * 3), junkR(junkL.size());
+        generate(Signal::noise, junkL.data(), int(junkL.size()), rate, 3);
+        generate(Signal::noise, junkR.data(), int(junkR.size()), rate, 4);
+
+        used.process(junkL.data(), junkR.data(), int(junkL.size()));
+        used.reset();
+        used.process(junkL.data(), junkR.data(), int(rate / 100));
+        used.reset();
+
+        auto usedL = freshL, usedR = freshR;
+        fresh.process(freshL.data(), freshR.data(), numSamples);
+        used.process(usedL.data(), usedR.data(), numSamples);
+
+        Metrics metrics;
+        metrics.add(freshL.data(), usedL.data(), numSamples);
+        metrics.add(freshR.data(), usedR.data(), numSamples);
+
+        results.push_back(metrics.getResult(multirate ? "RiserProcessor reset (multirate)" : "RiserProcessor reset",
+                                            getSignalName(Signal::noise), tolerance));
+
+        generate(Signal::noise, freshL.data(), numSamples, sampleRate, 1);
+        generate(Signal::noise, freshR.data(), numSamples, sampleRate, 2);
+    }
+}
+
+// Processors sharing a reverb bus (see ReverbBus.h)
+// - equivalence: a processor on the bus, with a silent one as the return, against the same
+//   processor with its own reverb — the return's output is then just the first one's wet
+//   signal, a block late, and the two add up to the own-reverb output (to within rounding)
+// - order: several processors with different amounts, run in a different order every block
+//   (as a host's threads might), against the same in a fixed order, which must be exact
+// - resync: a bus whose return stops for a few blocks (so the other slot's FIFO overruns), and
+//   later whose other slot does (so it underruns), against one that runs throughout — only
+//   silence is sent during each, so the impulses sent after each must come back the same, exactly
+static void testReverbBus(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr int blockSize = 256;
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size());
+    generate(Signal::noise, inL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numSamples, sampleRate, 2);
+
+    {
+        pa::dsp::ReverbBus bus;
+        RiserProcessor own, shared, returnOnly;
+
+        for (auto* p : { &own, &shared, &returnOnly }) {
+            p->setParameters(0.5f, 0.5f, 0.8f, 0.5f);
+            p->prepare(sampleRate, blockSize);
+        }
+
+        // (the silent one joins first, so it's the return)
+        returnOnly.setReverbBus(&bus);
+        shared.setReverbBus(&bus);
+
+        auto ownL = inL, ownR = inR, sharedL = inL, sharedR = inR;
+        vector<float> wetL(inL.size()), wetR(inL.size());
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+            own.process(ownL.data() + start, ownR.data() + start, n);
+            shared.process(sharedL.data() + start, sharedR.data() + start, n);
+            returnOnly.process(wetL.data() + start, wetR.data() + start, n);
+        }
+
+        // (the dry signal, plus the wet signal from a block later)
+        const int latency = bus.getLatencySamples();
+
+        for (int i = 0; i < numSamples - latency; i++) {
+            sharedL[size_t(i)] += wetL[size_t(i + latency)];
+            sharedR[size_t(i)] += wetR[size_t(i + latency)];
+        }
+
+        Metrics metrics;
+        metrics.add(ownL.data(), sharedL.data(), numSamples - latency);
+        metrics.add(ownR.data(), sharedR.data(), numSamples - latency);
+
+        // (the wet level moves from the output onto the send, so it rounds differently)
+        auto result = metrics.getResult("RiserProcessor reverb bus", getSignalName(Signal::noise), { -120.0, 1024 });
+        result.passed = result.passed && shared.isOnReverbBus() && returnOnly.isOnReverbBus() && latency == blockSize;
+        results.push_back(result);
+
+        shared.setReverbBus(nullptr);
+        returnOnly.setReverbBus(nullptr);
+    }
+
+    constexpr int numProcessors = 4;
+    array<vector<float>, numProcessors * 2> outputs[2];
+
+    for (int run = 0; run < 2; run++) {
+        pa::dsp::ReverbBus bus;
+        array<RiserProcessor, numProcessors> processors;
+
+        for (int k = 0; k < numProcessors; k++) {
+            auto& p = processors[size_t(k)];
+            const float amount = 0.3f + 0.2f * float(k);
+
+            p.setParameters(amount, 1.0f - amount, amount, 0.8f);
+            p.prepare(sampleRate, blockSize);
+            p.setReverbBus(&bus);
+
+            outputs[run][size_t(2 * k)] = inL;
+            outputs[run][size_t(2 * k + 1)] = inR;
+
+            // (each processor gets its own input, reversed or scaled)
+            if (k % 2 == 1)
+                std::reverse(outputs[run][size_t(2 * k)].begin(), outputs[run][size_t(2 * k)].end());
+
+            for (auto& x : outputs[run][size_t(2 * k + 1)])
+                x *= 1.0f / float(k + 1);
+        }
+
+        for (int start = 0, block = 0; start < numSamples; start += blockSize, block++) {
+            const int n = jmin(blockSize, numSamples - start);
+
+            for (int j = 0; j < numProcessors; j++) {
+                // (the first run goes in slot order, the second in a different order every block)
+                const int k = (run == 0) ? j : (j * 3 + block) % numProcessors;
+
+                processors[size_t(k)].process(outputs[run][size_t(2 * k)].data() + start,
+                                              outputs[run][size_t(2 * k + 1)].data() + start, n);
+            }
+        }
+
+        for (auto& p : processors)
+            p.setReverbBus(nullptr);
+    }
+
+    Metrics metrics;
+
+    for (size_t c = 0; c < outputs[0].size(); c++)
+        metrics.add(outputs[0][c].data(), outputs[1][c].data(), numSamples);
+
+    results.push_back(metrics.getResult("RiserProcessor reverb bus order", getSignalName(Signal::noise), { -400.0, 0 }));
+
+    constexpr int numBlocks = 96;
+    array<vector<float>, 2> resyncOutputs[2];
+
+    for (int run = 0; run < 2; run++) {
+        pa::dsp::ReverbBus bus;
+        auto s = RiserProcessor::defaultSettings();
+        RiserProcessor::mapSettings(s, 0.0f, 0.0f, 0.8f);
+
+        const int returnSlot = bus.join(sampleRate, blockSize, s.reverb, RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+        const int otherSlot = bus.join(sampleRate, blockSize, s.reverb, RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+
+        auto& out = resyncOutputs[run];
+        out[0].assign(size_t(numBlocks * blockSize), 0.0f);
+        out[1] = out[0];
+
+        vector<float> send(static_cast<size_t>(blockSize));
+        const bool disrupted = (run == 1);
+
+        for (int block = 0; block < numBlocks; block++) {
+            std::fill(send.begin(), send.end(), 0.0f);
+            send[7] = (block == 16 || block == 56) ? 1.0f : 0.0f;
+
+            // (the return goes first, then the other slot posts)
+            if (!disrupted || block < 4 || block >= 12)
+                bus.render(out[0].data() + block * blockSize, out[1].data() + block * blockSize, blockSize, s.reverb);
+
+            if (!disrupted || block < 40 || block >= 44)
+                bus.post(otherSlot, send.data(), blockSize);
+        }
+
+        bus.leave(otherSlot);
+        bus.leave(returnSlot);
+    }
+
+    Metrics resyncMetrics;
+
+    for (size_t c = 0; c < 2; c++)
+        resyncMetrics.add(resyncOutputs[0][c].data(), resyncOutputs[1][c].data(), numBlocks * blockSize);
+
+    results.push_back(resyncMetrics.getResult("Reverb bus resync", getSignalName(Signal::impulses), { -400.0, 0 }));
+}
+
+// A shadow swap (see ShadowSwap.h) from one set of amounts to another, against two plain
+// processors: the old amounts carrying on, and the new ones starting from the handover — the
+// output must be the first, then their equal-power crossfade, then the second, exactly
+static void testShadowSwap(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr int blockSize = 192;
+    const int swapAt = (numSamples / 3 / blockSize) * blockSize;
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size());
+    generate(Signal::noise, inL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numSamples, sampleRate, 2);
+
+    const auto setOld = [](RiserProcessor& p) { p.setParameters(0.2f, 0.9f, 0.3f, 1.0f); };
+    const auto setNew = [](RiserProcessor& p) { p.setParameters(0.8f, 0.1f, 0.9f, 0.7f); };
+
+    pa::dsp::ShadowSwap<RiserProcessor> swap;
+    RiserProcessor before, after;
+
+    setOld(swap.getLive());
+    swap.getLive().prepare(sampleRate, blockSize);
+    swap.prepare(sampleRate);
+
+    setOld(before);
+    before.prepare(sampleRate, blockSize);
+    setNew(after);
+    after.prepare(sampleRate, blockSize);
+
+    auto swappedL = inL, swappedR = inR, beforeL = inL, beforeR = inR, afterL = inL, afterR = inR;
+    bool committed = false;
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        const int n = jmin(blockSize, numSamples - start);
+
+        if (start == swapAt && swap.beginSwap()) {
+            setNew(swap.getShadow());
+            swap.getShadow().prepare(sampleRate, blockSize);
+            swap.commitSwap();
+            committed = true;
+        }
+
+        swap.process(swappedL.data() + start, swappedR.data() + start, n, [](RiserProcessor&) {});
+        before.process(beforeL.data() + start, beforeR.data() + start, n);
+
+        if (start >= swapAt)
+            after.process(afterL.data() + start, afterR.data() + start, n);
+    }
+
+    // the expected output, with the crossfade worked out the same way
+    const int fadeLength = int(pa::dsp::ShadowSwap<RiserProcessor>::fadeSeconds * sampleRate);
+    auto expectedL = beforeL, expectedR = beforeR;
+
+    for (int i = swapAt; i < numSamples; i++) {
+        const size_t s = size_t(i);
+
+        if (i < swapAt + fadeLength) {
+            const double angle = MathConstants<double>::halfPi * double(i - swapAt) / double(fadeLength);
+            const float out = float(std::cos(angle)), in = float(std::sin(angle));
+
+            expectedL[s] = out * beforeL[s] + in * afterL[s];
+            expectedR[s] = out * beforeR[s] + in * afterR[s];
+        }
+        else {
+            expectedL[s] = afterL[s];
+            expectedR[s] = afterR[s];
+        }
+    }
+
+    Metrics metrics;
+    metrics.add(expectedL.data(), swappedL.data(), numSamples);
+    metrics.add(expectedR.data(), swappedR.data(), numSamples);
+
+    auto result = metrics.getResult("RiserProcessor shadow swap", getSignalName(Signal::noise), { -400.0, 0 });
+    result.passed = result.passed && committed && swap.takeSwapped() && !swap.isSwapping();
+    results.push_back(result);
+
+    // the same swap, but released and prepared again partway through the crossfade (as the plugin
+    // does), which finishes it there — from then on the output must be a freshly prepared
+    // processor at the new amounts, exactly, and a swap that's dropped before it's committed
+    // must leave things as they were
+    pa::dsp::ShadowSwap<RiserProcessor> interrupted;
+    RiserProcessor fresh;
+    const int preparedAt = swapAt + 3 * blockSize;
+
+    setOld(interrupted.getLive());
+    interrupted.prepare(sampleRate);
+    interrupted.getLive().prepare(sampleRate, blockSize);
+
+    auto interruptedL = inL, interruptedR = inR, freshL = inL, freshR = inR;
+    bool finished = false, dropped = false;
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        const int n = jmin(blockSize, numSamples - start);
+
+        if (start == swapAt && interrupted.beginSwap()) {
+            setNew(interrupted.getShadow());
+            interrupted.getShadow().prepare(sampleRate, blockSize);
+            interrupted.commitSwap();
+        }
+
+        if (start == preparedAt) {
+            // (releaseResources(), then prepareToPlay())
+            interrupted.finishSwap();
+            interrupted.forEach([](RiserProcessor& p) { p.release(); });
+
+            interrupted.prepare(sampleRate);
+            interrupted.getLive().prepare(sampleRate, blockSize);
+            finished = interrupted.takeSwapped() && !interrupted.isSwapping();
+
+            setNew(fresh);
+            fresh.prepare(sampleRate, blockSize);
+        }
+
+        interrupted.process(interruptedL.data() + start, interruptedR.data() + start, n, [](RiserProcessor&) {});
+
+        if (start >= preparedAt)
+            fresh.process(freshL.data() + start, freshR.data() + start, n);
+    }
+
+    if (interrupted.beginSwap()) {
+        interrupted.prepare(sampleRate);
+        interrupted.commitSwap();
+        dropped = !interrupted.isSwapping() && !interrupted.takeSwapped();
+    }
+
+    Metrics interruptedMetrics;
+    interruptedMetrics.add(freshL.data() + preparedAt, interruptedL.data() + preparedAt, numSamples - preparedAt);
+    interruptedMetrics.add(freshR.data() + preparedAt, interruptedR.data() + preparedAt, numSamples - preparedAt);
+
+    auto interruptedResult = interruptedMetrics.getResult("RiserProcessor shadow swap (prepared)",
+                                                          getSignalName(Signal::noise), { -400.0, 0 });
+    interruptedResult.passed = interruptedResult.passed && finished && dropped;
+    results.push_back(interruptedResult);
+}
+
+// A shadow swap on a reverb bus, where the live processor and its shadow share the one slot
+// - sends: the pair isn't the return (a silent processor is), so its output is the dry
+//   crossfade, exactly as in testShadowSwap(), and the return's is the shared reverb over one
+//   send, the old processor's then the new one's, crossfaded with the same gains — rebuilt
+//   here on a second bus from the two sends, to within rounding
+// - return: the pair is the return, and a silent processor on the bus must stay silent
+//   through and after the swap (it'd only hear anything if the return had moved to it)
+// - either way, only the two slots are ever joined
+static void testShadowSwapBus(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr int blockSize = 192;
+    const int swapAt = (numSamples / 3 / blockSize) * blockSize;
+    const int fadeLength = int(pa::dsp::ShadowSwap<RiserProcessor>::fadeSeconds * sampleRate);
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size()), silence(inL.size());
+    generate(Signal::noise, inL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numSamples, sampleRate, 2);
+
+    // (the reverb goes first, so the sends are the input's)
+    const auto setOld = [](RiserProcessor& p) {
+        p.setParameters(0.2f, 0.9f, 0.3f, 1.0f);
+        p.setOrder(RiserProcessor::Order::flangedWash);
+    };
+
+    const auto setNew = [](RiserProcessor& p) {
+        p.setParameters(0.8f, 0.1f, 0.9f, 0.7f);
+        p.setOrder(RiserProcessor::Order::flangedWash);
+    };
+
+    const auto setReturn = [](RiserProcessor& p) { p.setParameters(0.0f, 0.0f, 0.6f, 1.0f); };
+
+    const auto runSwap = [&](pa::dsp::ReverbBus& bus, pa::dsp::ShadowSwap<RiserProcessor>& swap, RiserProcessor& other,
+                             bool pairFirst, vector<float>* outputs) {
+        setOld(swap.getLive());
+        swap.getLive().prepare(sampleRate, blockSize);
+        swap.prepare(sampleRate);
+        setReturn(other);
+        other.prepare(sampleRate, blockSize);
+
+        // (whichever joins first is the return)
+        const array<RiserProcessor*, 2> joinOrder { pairFirst ? &swap.getLive() : &other, pairFirst ? &other : &swap.getLive() };
+
+        for (auto* p : joinOrder)
+            p->setReverbBus(&bus);
+
+        bool valid = swap.getLive().isOnReverbBus() && other.isOnReverbBus();
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+
+            // (as the plugin sets the shadow up, see OneRiserProcessor::setUpShadow())
+            if (start == swapAt && swap.beginSwap()) {
+                setNew(swap.getShadow());
+                swap.getShadow().setReverbBus(&bus, false);
+                swap.getShadow().prepare(sampleRate, blockSize);
+                swap.commitSwap();
+            }
+
+            swap.process(outputs[0].data() + start, outputs[1].data() + start, n, [](RiserProcessor&) {});
+            other.process(outputs[2].data() + start, outputs[3].data() + start, n);
+
+            valid = valid && bus.getNumJoined() == 2;
+        }
+
+        valid = valid && swap.takeSwapped() && !swap.isSwapping()
+                      && swap.getLive().isOnReverbBus() && !swap.getShadow().isOnReverbBus();
+
+        swap.forEach([](RiserProcessor& p) { p.setReverbBus(nullptr); });
+        other.setReverbBus(nullptr);
+
+        return valid;
+    };
+
+    {
+        pa::dsp::ReverbBus bus;
+        pa::dsp::ShadowSwap<RiserProcessor> swap;
+        RiserProcessor returnOnly;
+        vector<float> outputs[4] { inL, inR, silence, silence };
+
+        const bool valid = runSwap(bus, swap, returnOnly, false, outputs);
+
+        // the dry signal, from two plain processors that aren't the return on a bus of their own
+        pa::dsp::ReverbBus dryBus;
+        RiserProcessor before, after;
+        auto s = RiserProcessor::defaultSettings();
+        const int drySlot = dryBus.join(sampleRate, blockSize, s.reverb, RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+
+        setOld(before);
+        setNew(after);
+
+        for (auto* p : { &before, &after }) {
+            p->prepare(sampleRate, blockSize);
+            p->setReverbBus(&dryBus);
+        }
+
+        auto beforeL = inL, beforeR = inR, afterL = inL, afterR = inR;
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+            before.process(beforeL.data() + start, beforeR.data() + start, n);
+
+            if (start >= swapAt)
+                after.process(afterL.data() + start, afterR.data() + start, n);
+        }
+
+        before.setReverbBus(nullptr);
+        after.setReverbBus(nullptr);
+        dryBus.leave(drySlot);
+
+        // the two sends, and the shared reverb over them (with the return's parameters)
+        const auto tables = RiserProcessor::getMappingTables(sampleRate);
+
+        const auto reverbSettings = [&](float flangerAmt, float filterAmt, float reverbAmt, float masterAmt) {
+            auto settings = RiserProcessor::defaultSettings();
+            RiserProcessor::lookupSettings(settings, *tables, flangerAmt * masterAmt, filterAmt * masterAmt, reverbAmt * masterAmt);
+            return settings.reverb;
+        };
+
+        const auto oldReverb = reverbSettings(0.2f, 0.9f, 0.3f, 1.0f), newReverb = reverbSettings(0.8f, 0.1f, 0.9f, 0.7f),
+                   returnReverb = reverbSettings(0.0f, 0.0f, 0.6f, 1.0f);
+
+        vector<float> oldSend(inL.size()), newSend(inL.size());
+
+        for (auto [parameters, dest] : { std::pair { &oldReverb, &oldSend }, std::pair { &newReverb, &newSend } }) {
+            pa::dsp::Reverb reverb;
+            reverb.setCombTimes(RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+            reverb.setParameters(*parameters);
+            reverb.prepare(sampleRate);
+
+            auto l = inL, r = inR;
+            reverb.processSend(l.data(), r.data(), dest->data(), numSamples);
+        }
+
+        pa::dsp::ReverbBus expectedBus;
+        const int returnSlot = expectedBus.join(sampleRate, blockSize, returnReverb, RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+        const int pairSlot = expectedBus.join(sampleRate, blockSize, returnReverb, RiserProcessor::earlyCombTimes, RiserProcessor::lateCombTimes);
+
+        auto expectedL = beforeL, expectedR = beforeR;
+        vector<float> wetL(inL.size()), wetR(inL.size()), send(static_cast<size_t>(blockSize));
+
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int n = jmin(blockSize, numSamples - start);
+
+            for (int i = start; i < start + n; i++) {
+                const size_t k = size_t(i);
+                float& x = send[size_t(i - start)];
+
+                if (i < swapAt) {
+                    x = oldSend[k];
+                }
+                else if (i < swapAt + fadeLength) {
+                    const double angle = MathConstants<double>::halfPi * double(i - swapAt) / double(fadeLength);
+                    const float out = float(std::cos(angle)), in = float(std::sin(angle));
+
+                    x = in * newSend[k] + out * oldSend[k];
+                    expectedL[k] = out * beforeL[k] + in * afterL[k];
+                    expectedR[k] = out * beforeR[k] + in * afterR[k];
+                }
+                else {
+                    x = newSend[k];
+                    expectedL[k] = afterL[k];
+                    expectedR[k] = afterR[k];
+                }
+            }
+
+            expectedBus.post(returnSlot, silence.data(), n);
+            expectedBus.post(pairSlot, send.data(), n);
+            expectedBus.render(wetL.data() + start, wetR.data() + start, n, returnReverb);
+        }
+
+        expectedBus.leave(pairSlot);
+        expectedBus.leave(returnSlot);
+
+        // (the return's chain ends with the hard-clip)
+        for (auto* wet : { &wetL, &wetR })
+            for (auto& x : *wet)
+                x = jlimit(-RiserProcessor::clipCeiling, RiserProcessor::clipCeiling, x);
+
+        Metrics dryMetrics, wetMetrics;
+        dryMetrics.add(expectedL.data(), outputs[0].data(), numSamples);
+        dryMetrics.add(expectedR.data(), outputs[1].data(), numSamples);
+        wetMetrics.add(wetL.data(), outputs[2].data(), numSamples);
+        wetMetrics.add(wetR.data(), outputs[3].data(), numSamples);
+
+        auto dryResult = dryMetrics.getResult("RiserProcessor shadow swap (bus)", getSignalName(Signal::noise), { -400.0, 0 });
+        dryResult.passed = dryResult.passed && valid;
+        results.push_back(dryResult);
+
+        // (the table lookups and the wide comb kernels round a little differently, as in testReverb())
+        results.push_back(wetMetrics.getResult("RiserProcessor shadow swap (bus sends)", getSignalName(Signal::noise), { -110.0, 4096 }));
+    }
+
+    {
+        pa::dsp::ReverbBus bus;
+        pa::dsp::ShadowSwap<RiserProcessor> swap;
+        RiserProcessor bystander;
+        vector<float> outputs[4] { inL, inR, silence, silence };
+
+        const bool valid = runSwap(bus, swap, bystander, true, outputs);
+
+        Metrics metrics;
+        metrics.add(silence.data(), outputs[2].data(), numSamples);
+        metrics.add(silence.data(), outputs[3].data(), numSamples);
+
+        auto result = metrics.getResult("RiserProcessor shadow swap (bus return)", getSignalName(Signal::noise), { -400.0, 0 });
+        result.passed = result.passed && valid;
+        results.push_back(result);
+    }
+}
+
+// The pipelined reverb against the usual one, delayed by the pipeline's block
+// - the host blocks vary in size and don't line up with the pipeline's, and the amounts
+//   are held (the pipelined reverb only takes new parameters once per block)
+static void testPipeline(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr Tolerance tolerance { -400.0, 0 };
+    constexpr int pipelineBlockSize = 192;
+
+    vector<float> directL(static_cast<size_t>(numSamples)), directR(directL.size());
+    generate(Signal::noise, directL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, directR.data(), numSamples, sampleRate, 2);
+    auto pipelinedL = directL, pipelinedR = directR;
+
+    RiserProcessor direct, pipelined;
+    pipelined.setReverbPipelined(true);
+
+    for (auto* p : { &direct, &pipelined }) {
+        p->setParameters(0.7f, 0.6f, 1.0f, 1.0f);
+        p->prepare(sampleRate, pipelineBlockSize);
+    }
+
+    direct.process(directL.data(), directR.data(), numSamples);
+
+    for (int start = 0, block = 0; start < numSamples; block++) {
+        const int n = jmin(1 + (block * 37) % 300, numSamples - start);
+        pipelined.process(pipelinedL.data() + start, pipelinedR.data() + start, n);
+        start += n;
+    }
+
+    const int latency = pipelined.getLatencySamples();
+
+    Metrics metrics;
+    metrics.add(directL.data(), pipelinedL.data() + latency, numSamples - latency);
+    metrics.add(directR.data(), pipelinedR.data() + latency, numSamples - latency);
+
+    auto result = metrics.getResult("RiserProcessor pipelined reverb", getSignalName(Signal::noise), tolerance);
+    result.passed = result.passed && latency == pipelineBlockSize;
+    results.push_back(result);
+}
+
+// The CPU governor, fed made-up block times — a lone slow block mustn't step it down, a sustained
+// overload steps it all the way down, and it only steps back up after a long stretch of headroom
+// (what each level saves is a benchmark, see benchmarkQualityLevels())
+static void testGovernor(vector<Result>& results, uint sampleRate) {
+    constexpr int blockSize = 512;
+    const double deadline = double(blockSize) / sampleRate;
+
+    pa::CpuGovernor governor;
+    governor.prepare(sampleRate);
+    governor.setEnabled(true);
+
+    // run at a share of the deadline for a while, returns the level after
+    const auto run = [&](double load, double seconds) {
+        for (int block = 0; block < int(seconds / deadline); block++)
+            governor.update(load * deadline, blockSize);
+
+        return governor.getLevel();
+    };
+
+    using Governor = pa::CpuGovernor;
+    bool passed = run(0.5, 1.0) == 0;
+
+    governor.update(10.0 * deadline, blockSize);
+    passed = passed && run(0.5, 1.0) == 0;
+    passed = passed && run(0.9, Governor::downSeconds / 2) == 0;
+    passed = passed && run(0.9, 4 * Governor::downSeconds) == Governor::maxLevel;
+    passed = passed && run(0.5, 2 * Governor::upSeconds) == Governor::maxLevel; // (between the two)
+    passed = passed && run(0.1, Governor::upSeconds / 2) == Governor::maxLevel;
+    passed = passed && run(0.1, 4 * Governor::upSeconds) == 0;
+
+    // (turning it off goes back to full quality, and says so)
+    passed = passed && run(0.9, 4 * Governor::downSeconds) == Governor::maxLevel;
+    passed = passed && governor.setEnabled(false) && governor.getLevel() == 0;
+    passed = passed && run(2.0, 4 * Governor::downSeconds) == 0;
+    passed = passed && !governor.setEnabled(false);
+
+    Result r { "CPU governor", "steps", -400.0, 0, passed };
+    results.push_back(r);
+}
+
+// Each step between the quality levels mid-playback, against a twin that stays at the old level —
+// the step fades in, so just after it the two have hardly parted yet (whereas switching, e.g. the
+// late combs in or out of the reverb's series chain, parts them at once)
+// - the result is the largest difference in the first samples after a step, against the peak
+static void testQualitySteps(vector<Result>& results, uint sampleRate) {
+    constexpr int blockSize = 512, numBlocks = 32, stepBlock = numBlocks / 2, numAfter = 8;
+    constexpr int numSamples = blockSize * numBlocks, stepAt = blockSize * stepBlock;
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size());
+    generate(Signal::noise, inL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numSamples, sampleRate, 2);
+
+    RiserProcessor::Modulation modulation;
+    modulation.depth = 0.5f;
+
+    double worst = 0.0;
+
+    for (int from = 0; from <= RiserProcessor::maxQualityLevel; from++) {
+        for (int to : { from - 1, from + 1 }) {
+            if (!isPositiveAndNotGreaterThan(to, RiserProcessor::maxQualityLevel)) continue;
+
+            RiserProcessor stepped, steady;
+            auto steppedL = inL, steppedR = inR, steadyL = inL, steadyR = inR;
+
+            for (auto* p : { &stepped, &steady }) {
+                p->setParameters(0.8f, 0.1f, 0.9f, 0.7f);
+                p->setModulation(modulation);
+                p->setQualityLevel(from);
+                p->prepare(sampleRate, blockSize);
+            }
+
+            for (int block = 0; block < numBlocks; block++) {
+                const size_t start = size_t(block * blockSize);
+
+                if (block == stepBlock)
+                    stepped.setQualityLevel(to);
+
+                stepped.process(steppedL.data() + start, steppedR.data() + start, blockSize);
+                steady.process(steadyL.data() + start, steadyR.data() + start, blockSize);
+            }
+
+            float peak = 0.0f, jump = 0.0f;
+
+            for (size_t i = 0; i < size_t(numSamples); i++)
+                peak = jmax(peak, jmax(std::abs(steadyL[i]), std::abs(steadyR[i])));
+
+            for (size_t i = size_t(stepAt); i < size_t(stepAt + numAfter); i++)
+                jump = jmax(jump, jmax(std::abs(steppedL[i] - steadyL[i]), std::abs(steppedR[i] - steadyR[i])));
+
+            worst = jmax(worst, double(jump) / jmax(double(peak), 1e-9));
+        }
+    }
+
+    const double jumpDb = Decibels::gainToDecibels(worst, -400.0);
+
+    Result r { "RiserProcessor quality steps", getSignalName(Signal::noise), jumpDb, 0, jumpDb < -40.0 };
+    results.push_back(r);
+}
+
+// The amounts and modulation for a voice of testRiserBank() and benchmarkRiserBank()
+static void setUpVoice(size_t voice, int block, array<float, 4>& amounts, RiserProcessor::Modulation& m) {
+    const int offset = 11 * int(voice);
+
+    amounts = { automation(block + offset), automation(block + offset + 24), automation(block + offset + 40), 1.0f };
+
+    // (every third voice is left unmodulated)
+    m.rate = 0.3f + 0.4f * float(voice);
+    m.depth = voice % 3 == 2 ? 0.0f : 0.3f + 0.1f * float(voice % 5);
+    m.stereoPhase = 0.25f * float(voice % 4);
+}
+
+// RiserBank against a RiserProcessor per voice, for a few more voices than fill a register (so
+// a group is only partly used), each with its own amounts automated every block and its own
+// modulation
+// - its kernels and the order of some sums differ, so this is only within rounding, not exact
+static void testRiserBank(vector<Result>& results, uint sampleRate, int numSamples) {
+    constexpr Tolerance tolerance { -110.0, std::numeric_limits<int64>::max() };
+    constexpr size_t numVoices = RiserBank::lanes + 2;
+
+    for (auto signal : allSignals) {
+        vector<vector<float>> refL(numVoices), refR(numVoices);
+
+        for (size_t v = 0; v < numVoices; v++) {
+            refL[v].resize(size_t(numSamples));
+            refR[v].resize(size_t(numSamples));
+            generate(signal, refL[v].data(), numSamples, sampleRate, uint32(2 * v + 1));
+            generate(signal, refR[v].data(), numSamples, sampleRate, uint32(2 * v + 2));
+        }
+
+        auto testL = refL, testR = refR;
+
+        vector<RiserProcessor> processors(numVoices);
+        RiserBank bank;
+        bank.prepare(sampleRate, numVoices);
+
+        const auto setParameters = [&](int block) {
+            for (size_t v = 0; v < numVoices; v++) {
+                array<float, 4> a;
+                RiserProcessor::Modulation m;
+                setUpVoice(v, block, a, m);
+
+                processors[v].setParameters(a[0], a[1], a[2], a[3]);
+                processors[v].setModulation(m);
+                bank.setParameters(v, a[0], a[1], a[2], a[3]);
+                bank.setModulation(v, m);
+            }
+        };
+
+        // (set before and after preparing, so both start at their targets)
+        setParameters(0);
+
+        for (auto& p : processors)
+            p.prepare(sampleRate);
+
+        bank.prepare(sampleRate, numVoices);
+
+        Metrics metrics;
+        array<float*, numVoices> left {}, right {};
+
+        for (int start = 0, block = 0; start < numSamples; start += automationBlockSize, block++) {
+            const int n = jmin(automationBlockSize, numSamples - start);
+            setParameters(block);
+
+            for (size_t v = 0; v < numVoices; v++) {
+                processors[v].process(refL[v].data() + start, refR[v].data() + start, n);
+                left[v] = testL[v].data() + start;
+                right[v] = testR[v].data() + start;
+            }
+
+            bank.process(left.data(), right.data(), n);
+
+            for (size_t v = 0; v < numVoices; v++) {
+                metrics.add(refL[v].data() + start, left[v], n);
+                metrics.add(refR[v].data() + start, right[v], n);
+            }
+        }
+
+        results.push_back(metrics.getResult("RiserBank (" + String(int(numVoices)) + " voices)", getSignalName(signal), tolerance));
+    }
+}
+
+// A chunked render against a sequential one, over four of the shortest chunks
+// - the stitched output has to be within the renderer's own bound, and the renderer has
+//   to agree that it is
+static void testChunkedRender(vector<Result>& results, uint sampleRate) {
+    ChunkedRenderer::Options options;
+    options.sampleRate = sampleRate;
+    options.modulation.depth = 0.5f;
+    options.numThreads = 4;
+    options.chunkSeconds = 0.0; // (as short as the pre-roll allows)
+
+    const Tolerance tolerance { options.maxSeamErrorDb, std::numeric_limits<int64>::max() };
+    const auto numSamples = int(4 * 4 * ChunkedRenderer::getPrerollSamples(options));
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size());
+    generate(Signal::noise, inL.data(), numSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numSamples, sampleRate, 2);
+
+    vector<float> sequentialL(inL.size()), sequentialR(inL.size()), chunkedL(inL.size()), chunkedR(inL.size());
+    ChunkedRenderer::renderSequential(inL.data(), inR.data(), sequentialL.data(), sequentialR.data(), numSamples, options);
+    const auto report = ChunkedRenderer::render(inL.data(), inR.data(), chunkedL.data(), chunkedR.data(),
+                                                numSamples, options);
+
+    Metrics metrics;
+    metrics.add(sequentialL.data(), chunkedL.data(), numSamples);
+    metrics.add(sequentialR.data(), chunkedR.data(), numSamples);
+
+    auto result = metrics.getResult("Chunked render", getSignalName(Signal::noise), tolerance);
+    result.passed = result.passed && report.withinBound && report.numChunks > 1;
+    results.push_back(result);
+}
+
+// A streaming render against a sequential one, with a few small buffers and a reader that
+// stalls now and then — the output has to be the same, exactly
+static void testStreamingRender(vector<Result>& results, uint sampleRate, int numSamples) {
+    ChunkedRenderer::Options options;
+    options.sampleRate = sampleRate;
+    options.modulation.depth = 0.5f;
+
+    // (a tail's worth of silence after the input)
+    const int numInputSamples = numSamples - numSamples / 4;
+
+    vector<float> inL(static_cast<size_t>(numSamples)), inR(inL.size());
+    generate(Signal::noise, inL.data(), numInputSamples, sampleRate, 1);
+    generate(Signal::noise, inR.data(), numInputSamples, sampleRate, 2);
+
+    vector<float> sequentialL(inL.size()), sequentialR(inL.size()), streamedL, streamedR;
+    ChunkedRenderer::renderSequential(inL.data(), inR.data(), sequentialL.data(), sequentialR.data(), numSamples, options);
+
+    RiserProcessor p;
+    ChunkedRenderer::prepareProcessor(p, options, 0);
+
+    StreamingRenderer::Options streamOptions;
+    streamOptions.bufferSize = 3000; // (not a whole number of blocks, so it's rounded up)
+    streamOptions.numBuffers = 3;
+
+    int numReads = 0;
+
+    const auto report = StreamingRenderer::render(p, numInputSamples, numSamples,
+        [&](float* left, float* right, int64 position, int n) {
+            if (++numReads % 4 == 0)
+                Thread::sleep(2);
+
+            std::copy_n(inL.begin() + position, n, left);
+            std::copy_n(inR.begin() + position, n, right);
+            return true;
+        },
+        [&](const float* left, const float* right, int n) {
+            streamedL.insert(streamedL.end(), left, left + n);
+            streamedR.insert(streamedR.end(), right, right + n);
+            return true;
+        },
+        streamOptions);
+
+    Metrics metrics;
+    const bool complete = report.succeeded && streamedL.size() == inL.size() && report.numSamples == numSamples;
+
+    if (complete) {
+        metrics.add(sequentialL.data(), streamedL.data(), numSamples);
+        metrics.add(sequentialR.data(), streamedR.data(), numSamples);
+    }
+
+    auto result = metrics.getResult("Streaming render", getSignalName(Signal::noise), { -400.0, 0 });
+    result.passed = result.passed && complete;
+    results.push_back(result);
+}
+
+// A tail left to decay all the way down, with the FPU's denormal flushing off (as it is outside
+// ScopedNoDenormals) — fails if any output sample, or anything fed back (the flanger lines, the
+// filters' state, the reverb's combs and their damping), is ever denormal
+// - each order, as it changes what feeds what (the filters close over the reverb's tail in the
+//   washes, and the flanger sweeps it in flangedWash)
+// - the state is checked every few blocks, sooner than the shortest line (a comb's 0.1 s) wraps
+//   around, so every sample fed back is seen — the biquads' state is always just flushed then
+//   (every Filter::flushInterval samples), but the output covers everything in between
+static void testTailDenormals(vector<Result>& results, uint sampleRate) {
+    constexpr double tailSeconds = 36.0, noiseSeconds = 4.0;
+    constexpr int blockSize = 512, stateInterval = 8;
+
+    const int numBlocks = int((noiseSeconds + tailSeconds) * sampleRate) / blockSize,
+              noiseBlocks = int(noiseSeconds * sampleRate) / blockSize;
+
+    vector<float> noiseL(size_t(noiseBlocks * blockSize)), noiseR(noiseL.size());
+    generate(Signal::noise, noiseL.data(), int(noiseL.size()), sampleRate, 1);
+    generate(Signal::noise, noiseR.data(), int(noiseR.size()), sampleRate, 2);
+
+    const auto previousFpState = FloatVectorOperations::getFpStatusRegister();
+    FloatVectorOperations::disableDenormalisedNumberSupport(false);
+
+    using Order = RiserProcessor::Order;
+
+    for (auto [order, name] : { std::pair { Order::standard, "standard" },
+                                std::pair { Order::filteredWash, "filtered wash" },
+                                std::pair { Order::flangedWash, "flanged wash" } }) {
+        RiserProcessor p;
+        p.setParameters(1.0f, 1.0f, 1.0f, 1.0f);
+        p.setOrder(order);
+        p.prepare(sampleRate, blockSize);
+
+        int64 numDenormal = 0;
+        const auto check = [&numDenormal](auto value) {
+            if (std::fpclassify(value) == FP_SUBNORMAL) numDenormal++;
+        };
+
+        array<float, blockSize> left {}, right {};
+
+        for (int block = 0; block < numBlocks; block++) {
+            if (block < noiseBlocks) {
+                std::copy_n(noiseL.begin() + block * blockSize, blockSize, left.begin());
+                std::copy_n(noiseR.begin() + block * blockSize, blockSize, right.begin());
+            }
+            else {
+                left.fill(0.0f);
+                right.fill(0.0f);
+            }
+
+            p.process(left.data(), right.data(), blockSize);
+
+            for (int i = 0; i < blockSize; i++) {
+                check(left[size_t(i)]);
+                check(right[size_t(i)]);
+            }
+
+            if (block % stateInterval == stateInterval - 1)
+                p.visitState(check);
+        }
+
+        Result r { String("RiserProcessor tail denormals (") + name + ")", getSignalName(Signal::noise),
+                   -400.0, 0, numDenormal == 0 };
+        results.push_back(r);
+    }
+
+    FloatVectorOperations::setFpStatusRegister(previousFpState);
+}
+
+                // Benchmarks
+// The median time a processor takes over blocks of noise, after a second's warm up
+// - setUp is given the processor before it's prepared
+template <typename SetUp>
+static double medianBlockSeconds(uint sampleRate, int blockSize, double seconds, SetUp&& setUp) {
+    RiserProcessor p;
+    setUp(p);
+    p.prepare(sampleRate, blockSize);
+
+    const int warmUpBlocks = int(sampleRate) / blockSize, numBlocks = int(seconds * sampleRate) / blockSize;
+    vector<float> left(static_cast<size_t>(blockSize)), right(left.size());
+    vector<double> blockTimes;
+
+    for (int block = 0; block < warmUpBlocks + numBlocks; block++) {
+        generate(Signal::noise, left.data(), blockSize, sampleRate, uint32(2 * block + 1));
+        generate(Signal::noise, right.data(), blockSize, sampleRate, uint32(2 * block + 2));
+
+        const auto start = Time::getHighResolutionTicks();
+        p.process(left.data(), right.data(), blockSize);
+
+        if (block >= warmUpBlocks)
+            blockTimes.push_back(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+    }
+
+    std::nth_element(blockTimes.begin(), blockTimes.begin() + std::ptrdiff_t(blockTimes.size() / 2), blockTimes.end());
+    return blockTimes[blockTimes.size() / 2];
+}
+
+// The cost of processing a tail all the way down, with the FPU's denormal flushing off (as
+// it is outside ScopedNoDenormals) — the processors flush their own feedback, so the end of
+// the tail, where the state would otherwise be denormal, should cost no more than the start
+// - the ratio of the last few seconds' median block time to the first few seconds' (while the
+//   input is still loud), in dB — denormals would cost 10 - 100 times as much
+// - testTailDenormals() is the pass or fail check on the same tail
+static void benchmarkTailCost(vector<Benchmark>& benchmarks, uint sampleRate) {
+    constexpr double tailSeconds = 40.0, windowSeconds = 4.0;
+    constexpr int blockSize = 512;
+
+    const auto previousFpState = FloatVectorOperations::getFpStatusRegister();
+    FloatVectorOperations::disableDenormalisedNumberSupport(false);
+
+    RiserProcessor p;
+    p.setParameters(1.0f, 1.0f, 1.0f, 1.0f);
+    p.prepare(sampleRate, blockSize);
+
+    const int numBlocks = int(tailSeconds * sampleRate) / blockSize,
+              windowBlocks = int(windowSeconds * sampleRate) / blockSize;
+
+    vector<float> noiseL(size_t(windowBlocks * blockSize)), noiseR(noiseL.size());
+    generate(Signal::noise, noiseL.data(), int(noiseL.size()), sampleRate, 1);
+    generate(Signal::noise, noiseR.data(), int(noiseR.size()), sampleRate, 2);
+
+    array<float, blockSize> left {}, right {};
+    vector<double> blockTimes;
+
+    for (int block = 0; block < numBlocks; block++) {
+        // noise for the first window, then silence for the tail
+        if (block < windowBlocks) {
+            std::copy_n(noiseL.begin() + block * blockSize, blockSize, left.begin());
+            std::copy_n(noiseR.begin() + block * blockSize, blockSize, right.begin());
+        }
+        else {
+            left.fill(0.0f);
+            right.fill(0.0f);
+        }
+
+        const auto start = Time::getHighResolutionTicks();
+        p.process(left.data(), right.data(), blockSize);
+        blockTimes.push_back(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+    }
+
+    FloatVectorOperations::setFpStatusRegister(previousFpState);
+
+    const auto median = [](vector<double> times) {
+        std::nth_element(times.begin(), times.begin() + std::ptrdiff_t(times.size() / 2), times.end());
+        return times[times.size() / 2];
+    };
+
+    const double early = median({ blockTimes.begin(), blockTimes.begin() + windowBlocks }),
+                 late = median({ blockTimes.end() - windowBlocks, blockTimes.end() });
+
+    benchmarks.push_back({ "RiserProcessor tail cost", getSignalName(Signal::noise),
+                           20.0 * std::log10(jmax(late, 1.0e-12) / jmax(early, 1.0e-12)), "dB (tail against loud)" });
+}
+
+// What each of the CPU governor's quality levels saves (see RiserProcessor::setQualityLevel()),
+// as its median block time against full quality's, in dB
+static void benchmarkQualityLevels(vector<Benchmark>& benchmarks, uint sampleRate) {
+    constexpr int blockSize = 512;
+
+    const auto atLevel = [&](int level) {
+        return medianBlockSeconds(sampleRate, blockSize, 2.0, [level](RiserProcessor& p) {
+            p.setParameters(1.0f, 1.0f, 1.0f, 1.0f);
+            p.setQualityLevel(level);
+        });
+    };
+
+    const double full = atLevel(0);
+
+    for (int level = 1; level <= RiserProcessor::maxQualityLevel; level++)
+        benchmarks.push_back({ "Quality level " + String(level), getSignalName(Signal::noise),
+                               20.0 * std::log10(jmax(atLevel(level), 1.0e-12) / jmax(full, 1.0e-12)), "dB (against full)" });
+}
+
+// RiserBank's throughput, against a RiserProcessor per voice over the same blocks, as a speedup
+// (with the voices modulated and the amounts moving, as in testRiserBank())
+static void benchmarkRiserBank(vector<Benchmark>& benchmarks, uint sampleRate) {
+    constexpr int blockSize = 512;
+    constexpr size_t numVoices = 4 * RiserBank::lanes;
+    const int numBlocks = int(4 * sampleRate) / blockSize;
+
+    vector<RiserProcessor> processors(numVoices);
+    RiserBank bank;
+    bank.prepare(sampleRate, numVoices);
+
+    for (size_t v = 0; v < numVoices; v++) {
+        array<float, 4> a;
+        RiserProcessor::Modulation m;
+        setUpVoice(v, 0, a, m);
+
+        processors[v].setParameters(a[0], a[1], a[2], a[3]);
+        processors[v].setModulation(m);
+        processors[v].prepare(sampleRate, blockSize);
+        bank.setParameters(v, a[0], a[1], a[2], a[3]);
+        bank.setModulation(v, m);
+    }
+
+    vector<vector<float>> left(numVoices, vector<float>(size_t(blockSize))), right = left;
+    array<float*, numVoices> leftPointers {}, rightPointers {};
+    double processorSeconds = 0.0, bankSeconds = 0.0;
+
+    for (int block = 0; block < numBlocks; block++) {
+        const auto fill = [&] {
+            for (size_t v = 0; v < numVoices; v++) {
+                generate(Signal::noise, left[v].data(), blockSize, sampleRate, uint32(block * 64 + int(v) + 1));
+                generate(Signal::noise, right[v].data(), blockSize, sampleRate, uint32(block * 64 + int(v) + 33));
+                leftPointers[v] = left[v].data();
+                rightPointers[v] = right[v].data();
+            }
+        };
+
+        fill();
+        auto start = Time::getHighResolutionTicks();
+
+        for (size_t v = 0; v < numVoices; v++)
+            processors[v].process(left[v].data(), right[v].data(), blockSize);
+
+        processorSeconds += Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        fill();
+        start = Time::getHighResolutionTicks();
+        bank.process(leftPointers.data(), rightPointers.data(), blockSize);
+        bankSeconds += Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    benchmarks.push_back({ "RiserBank (" + String(int(numVoices)) + " voices)", getSignalName(Signal::noise),
+                           processorSeconds / jmax(bankSeconds, 1.0e-12), "x (the processors' speed)" });
+}
+
+// Run every stage, a few seconds of audio each at the default length
+// - the processors are run once per instruction set this CPU supports (see Kernels.h)
+static vector<Result> runAll(uint sampleRate = 48000, int numSamples = 1 << 17) {
+    namespace kernels = pa::dsp::kernels;
+    vector<Result> results;
+
+    testMaths(results);
+    testLfo(results, sampleRate);
+    testMappingTables(results, sampleRate);
+    testSnapshots(results, sampleRate, numSamples);
+    testChunkedRender(results, sampleRate);
+    testStreamingRender(results, sampleRate, numSamples);
+    testPipeline(results, sampleRate, numSamples);
+    testReset(results, sampleRate, numSamples);
+    testReverbBus(results, sampleRate, numSamples);
+    testShadowSwap(results, sampleRate, numSamples);
+    testShadowSwapBus(results, sampleRate, numSamples);
+    testGovernor(results, sampleRate);
+    testQualitySteps(results, sampleRate);
+    testRiserBank(results, sampleRate, numSamples);
+
+    const auto previousIsa = kernels::get().isa;
+
+    for (auto isa : { kernels::Isa::baseline, kernels::Isa::avx2, kernels::Isa::avx512 }) {
+        if (!kernels::isSupported(isa)) continue;
+
+        kernels::select(isa);
+        const size_t first = results.size();
+
+        testCombFilter(results, sampleRate, numSamples);
+        testCombFilterModulation(results, sampleRate, numSamples);
+        testFilter(results, sampleRate, numSamples);
+        testReverb(results, sampleRate, numSamples);
+        testReverbMultirate(results);
+        testConversion(results, sampleRate, numSamples);
+        testTailDenormals(results, sampleRate);
+
+        for (size_t i = first; i < results.size(); i++)
+            results[i].stage = results[i].stage + " [" + kernels::getName(isa) + "]";
+    }
+
+    kernels::select(previousIsa);
+
+    return results;
+}
+
+static bool allPassed(const vector<Result>& results) {
+    return std::all_of(results.begin(), results.end(), [](const Result& r) { return r.passed; });
+}
+
+// Run every benchmark (these take a minute or so, with the tail)
+static vector<Benchmark> runBenchmarks(uint sampleRate = 48000) {
+    vector<Benchmark> benchmarks;
+
+    benchmarkTailCost(benchmarks, sampleRate);
+    benchmarkQualityLevels(benchmarks, sampleRate);
+    benchmarkRiserBank(benchmarks, sampleRate);
+
+    return benchmarks;
+}
+
+} // end namespace pa::nulltest
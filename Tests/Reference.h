@@ -0,0 +1,396 @@
+#pragma once
+#include "../Source/Components/pa.h"
+#include "../Source/Components/CombFilter.h"
+#include "../Source/Components/Filter.h"
+#include "../Source/Components/Reverb.h"
+
+/*
+ * ~ Reference processors ~
+ * Frozen, scalar per-sample copies of the processors and maths that get optimised
+ * elsewhere, used by the null tests (NullTest.h) to check that any rewrite still
+ * sounds the same.
+ *
+ * These should never change — if a processor's behaviour is changed on purpose,
+ * update its reference in the same commit and say so.
+ * They share the processors' parameter objects, but nothing else.
+*/
+
+namespace pa::reference {
+
+                // Maths
+namespace math {
+template <typename NumType>
+static inline NumType clamp(const NumType& val, const NumType& min, const NumType& max) {
+    return (val < min) ? min : (val > max) ? max : val;
+}
+
+template <typename NumType>
+static inline NumType map(const NumType& val, const NumType& inMin, const NumType& inMax,
+                          const NumType& outMin = 0, const NumType& outMax = 1) {
+    return ((val - inMin) / (inMax - inMin)) * (outMax - outMin) + outMin;
+}
+
+template <typename FloatType>
+static inline FloatType mod1(const FloatType& input) {
+    return input - FloatType(int(input));
+}
+
+template <typename FloatType>
+static inline void wrapPi(FloatType& input, bool useHalfPi = false) noexcept {
+    static constexpr auto pi = static_cast<FloatType>(M_PI);
+
+    if (useHalfPi)
+        input = static_cast<FloatType>(std::fmod(input - pi * 0.5, pi) - pi * 0.5);
+    else
+        input = static_cast<FloatType>(std::fmod(input - pi, 2 * pi) - pi);
+}
+
+template <typename FloatType>
+static FloatType fastSin(FloatType x) noexcept {
+    wrapPi<FloatType>(x);
+    const double x2 = x * x;
+    const double num = -x * (-11511339840 + x2 * (1640635920 + x2 * (-52785432 + x2 * 479249)));
+    const double den = 11511339840 + x2 * (277920720 + x2 * (3177720 + x2 * 18361));
+    return static_cast<FloatType>(num / den);
+}
+
+template <typename FloatType>
+static FloatType fastCos(FloatType x) noexcept {
+    wrapPi<FloatType>(x);
+    const double x2 = x * x;
+    const double num = -(-39251520 + x2 * (18471600 + x2 * (-1075032 + 14615 * x2)));
+    const double den = 39251520 + x2 * (1154160 + x2 * (16632 + x2 * 127));
+    return static_cast<FloatType>(num / den);
+}
+
+template <typename FloatType>
+static FloatType fastTan(FloatType x) noexcept {
+    wrapPi<FloatType>(x, true);
+    const double x2 = x * x;
+    const double num = x * (-135135 + x2 * (17325 + x2 * (-378 + x2)));
+    const double den = -135135 + x2 * (62370 + x2 * (-3150 + 28 * x2));
+    return static_cast<FloatType>(num / den);
+}
+
+template <typename FloatType>
+static FloatType linearInterp(const FloatType& a, const FloatType& b, FloatType t) {
+    if (t <= 0) return a;
+    if (t >= 1) return b;
+
+    return a + t * (b - a);
+}
+
+template <typename FloatType>
+static FloatType cubicInterp(const FloatType& a, const FloatType& b, const FloatType& c,
+                             const FloatType& d, FloatType t) {
+    if (t <= 0) return b;
+    if (t >= 1) return c;
+
+    // catmull-rom
+    const FloatType t2 = t * t;
+    const auto a0 = static_cast<FloatType>(-0.5 * a + 1.5 * b - 1.5 * c + 0.5 * d);
+    const auto a1 = static_cast<FloatType>(a - 2.5 * b + 2 * c - 0.5 * d);
+    const auto a2 = static_cast<FloatType>(-0.5 * a + 0.5 * c);
+
+    return a0 * t * t2 + a1 * t2 + a2 * t + b;
+}
+
+template <typename FloatType>
+static FloatType expRounder(const FloatType &input, const FloatType& curveValue) {
+    FloatType x = clamp<FloatType>(input, -1.0, 1.0),
+              c = clamp<FloatType>(curveValue, -1.0, 1.0);
+
+    if (c >= 0)
+        c = map<FloatType>(c, 0.0, 1.0, 0.0, 20.0);
+    else
+        c = map<FloatType>(c, -1.0, 0.0, -0.95, 0.0);
+
+    if (0 < x && x <= 1)
+        return (x * (1 + c)) / (c * x + 1);
+    else if (-1 <= x && x <= 0)
+        return (-x * (1 + c)) / (c * x - 1);
+
+    return 0;
+}
+} // end namespace math
+
+                // Delay line
+// Per-sample ring buffer — reads wrap around the buffer's ends
+template <typename FloatType>
+class RingBuffer {
+ public:
+    void prepare(uint newBufferSizeSamples, const uint& newSampleRate) {
+        newBufferSizeSamples = math::clamp<uint>(newBufferSizeSamples, 0, newSampleRate * 600);
+
+        buffer.assign(newBufferSizeSamples, FloatType(0));
+        size = newBufferSizeSamples;
+        writeIndex = 0;
+        sampleRate = jmax(1u, newSampleRate);
+
+        delayTime.reset(sampleRate, delaySmoothTime);
+        delayTime.setCurrentAndTargetValue(clampDelayTime(requestedDelayTime));
+    }
+
+    void prepare(FloatType newBufferSizeSeconds, const uint& newSampleRate) {
+        prepare(static_cast<uint>(newBufferSizeSeconds * FloatType(newSampleRate)), newSampleRate);
+    }
+
+    void setDelayTime(FloatType newDelayTime, FloatType smoothTime = 0.1f) {
+        if (smoothTime != delaySmoothTime) {
+            delaySmoothTime = jmax(FloatType(0), smoothTime);
+            delayTime.reset(sampleRate, delaySmoothTime);
+        }
+
+        requestedDelayTime = std::abs(newDelayTime);
+        delayTime.setTargetValue(clampDelayTime(requestedDelayTime));
+    }
+
+    // - modulation scales the delay time (in samples) for this read
+    FloatType getFromBuffer(const pa::dsp::InterpolationType interp = pa::dsp::noInterp, FloatType modulation = 1) {
+        const FloatType readOffset = FloatType(sampleRate) * delayTime.getNextValue() * modulation;
+
+        switch (interp) {
+            case pa::dsp::linearInterp:
+                return math::linearInterp(at(readOffset, 0), at(readOffset, 1), math::mod1(readOffset));
+            case pa::dsp::cubicInterp: {
+                const FloatType offset = jmax(FloatType(2), readOffset);
+                return math::cubicInterp(at(offset, -1), at(offset, 0), at(offset, 1), at(offset, 2),
+                                         math::mod1(offset));
+            }
+            default:
+                return at(readOffset, 0);
+        }
+    }
+
+    void pushToBuffer(const FloatType* input) {
+        buffer[writeIndex] = *input;
+
+        if (++writeIndex >= size)
+            writeIndex = 0;
+    }
+
+ private:
+    vector<FloatType> buffer;
+    uint size = 0, writeIndex = 0, sampleRate = 44100;
+    FloatType delaySmoothTime = 0.0, requestedDelayTime = 0.0;
+    juce::SmoothedValue<FloatType> delayTime = 0.0;
+
+    FloatType clampDelayTime(FloatType newDelayTime) const {
+        return math::clamp(newDelayTime, FloatType(0), FloatType(size) / FloatType(sampleRate));
+    }
+
+    // the sample (whole) readOffset + older samples back from the write position
+    FloatType at(FloatType readOffset, int older) const {
+        const auto back = int64(uint(readOffset)) + older;
+        return buffer[size_t(((int64(writeIndex) - back) % int64(size) + int64(size)) % int64(size))];
+    }
+};
+
+                // Processors
+// Comb filter (see CombFilter.h)
+class CombFilter {
+ public:
+    using Parameters = pa::dsp::CombFilter::Parameters;
+
+    void prepare(uint sampleRate) {
+        delay.prepare(sampleRate, sampleRate);
+    }
+
+    void setParameters(const Parameters& newParams, const float& freqOffset) {
+        parameters = newParams;
+        parameters.feedback = math::clamp(parameters.feedback, 0.0f, 1.0f);
+
+        delay.setDelayTime(1.0f / (parameters.freq + freqOffset), 0.03f);
+    }
+
+    // - modulation scales the delay time, though cubic interpolation ignores it (as the processor does)
+    float process(float input, float modulation = 1.0f) {
+        const float delayed = delay.getFromBuffer(parameters.interpType,
+                                                  parameters.interpType == pa::dsp::cubicInterp ? 1.0f : modulation);
+
+        const float feedbackLine = input + delayed * parameters.feedback;
+        delay.pushToBuffer(&feedbackLine);
+
+        return input + delayed * parameters.wet;
+    }
+
+ private:
+    RingBuffer<float> delay;
+    Parameters parameters;
+};
+
+// Biquad filter (see Filter.h)
+class Filter {
+ public:
+    using Parameters = pa::dsp::Filter::Parameters;
+
+    void prepare(uint newSampleRate) {
+        sampleRate = newSampleRate;
+    }
+
+    void setParameters(const Parameters& newParameters) {
+        p = newParameters;
+
+        if (!p.enabled || sampleRate == 0) return;
+
+        const double k = math::fastTan(M_PI * (p.cutoff / sampleRate));
+        const double k2 = k * k;
+        const double n = 1 / (1 + k / p.q + k2);
+
+        a0 = (p.type == pa::dsp::Filter::lowpass) ? k2 * n : n;
+        a1 = (p.type == pa::dsp::Filter::lowpass) ? 2 * a0 : -2 * a0;
+        a2 = a0;
+        b1 = 2 * (k2 - 1) * n;
+        b2 = (1 - k / p.q + k2) * n;
+    }
+
+    float process(float input) {
+        if (!p.enabled) return input;
+
+        const double out = input * a0 + dly1;
+        dly1 = input * a1 + dly2 - b1 * out;
+        dly2 = input * a2 - b2 * out;
+        return static_cast<float>(out);
+    }
+
+ private:
+    Parameters p;
+    uint sampleRate = 0;
+    double a0 = 1.0, a1 = 0.0, a2 = 0.0, b1 = 0.0, b2 = 0.0, dly1 = 0.0, dly2 = 0.0;
+};
+
+// Stereo comb reverb (see Reverb.h)
+class Reverb {
+ public:
+    using Parameters = pa::dsp::Reverb::Parameters;
+
+    Reverb() {
+        setCombs();
+    }
+
+    void prepare(uint newSampleRate) {
+        if (newSampleRate != 0)
+            sampleRate = newSampleRate;
+
+        for (uint ch = 0; ch < 2; ch++) {
+            for (auto& cmb : earlyCombs[ch]) cmb.prepare(sampleRate);
+            for (auto& cmb : lateCombs[ch]) cmb.prepare(sampleRate);
+        }
+
+        for (auto* s : { &dampingSmooth, &feedbackSmooth, &drySmooth, &wet1, &wet2 })
+            s->reset(sampleRate, 0.05);
+    }
+
+    void setCombTimes(const array<float, 8>& newEarlyTimes, const array<float, 4>& newLateTimes) {
+        earlyCombTimes = newEarlyTimes;
+        lateCombTimes = newLateTimes;
+
+        setCombs();
+    }
+
+    void setParameters(const Parameters& newParameters) {
+        const Parameters old = parameters;
+        parameters = newParameters;
+
+        if (parameters.mix != old.mix) {
+            const auto mixAmount = math::clamp(parameters.mix, 0.0f, 1.0f);
+            dry = 1.0f - mixAmount;
+            wet = math::expRounder(mixAmount, 0.8f) * 1.55f;
+        }
+
+        preGain = 0.1f / float(parameters.numEarlyCombs + parameters.numLateCombs);
+        drySmooth.setTargetValue(dry);
+        wet1.setTargetValue(1.2f * wet * (1 + parameters.width));
+        wet2.setTargetValue(1.2f * wet * (1 - parameters.width));
+
+        if (parameters.spread != old.spread)
+            setCombs();
+
+        if (parameters.damping != old.damping || parameters.size != old.size) {
+            dampingSmooth.setTargetValue(parameters.damping * 0.9f);
+            feedbackSmooth.setTargetValue(parameters.size * 0.78f + 0.2f);
+        }
+    }
+
+    void process(float* left, float* right) {
+        const float input = (*left + *right) * preGain;
+        const float damp = dampingSmooth.getNextValue(),
+                    feed = feedbackSmooth.getNextValue();
+        float outL = 0.0f, outR = 0.0f;
+
+        for (uint j = 0; j < parameters.numEarlyCombs; j++) {
+            outL += earlyCombs[0][j].processEarly(input, damp, feed);
+            outR += earlyCombs[1][j].processEarly(input, damp, feed);
+        }
+        for (uint j = 0; j < parameters.numLateCombs; j++) {
+            outL = lateCombs[0][j].processLate(outL);
+            outR = lateCombs[1][j].processLate(outR);
+        }
+
+        const float d = drySmooth.getNextValue();
+        const float w1 = wet1.getNextValue(),
+                    w2 = wet2.getNextValue();
+
+        *left  = d * (*left)  + w1 * outL + w2 * outR;
+        *right = d * (*right) + w1 * outR + w2 * outL;
+    }
+
+ private:
+    class Comb {
+     public:
+        void prepare(uint sampleRate) {
+            buffer.prepare(0.1f, sampleRate);
+            previousValue = 0.0f;
+        }
+
+        void setTime(float delayTimeInSeconds) {
+            buffer.setDelayTime(math::clamp(delayTimeInSeconds, 0.001f, 1.0f));
+        }
+
+        float processEarly(float input, float damp, float feed) {
+            const float delayLine = buffer.getFromBuffer();
+            previousValue = delayLine + damp * (previousValue - delayLine);
+
+            const float temp = input + previousValue * feed;
+            buffer.pushToBuffer(&temp);
+
+            return delayLine;
+        }
+
+        float processLate(float input) {
+            const float delayLine = buffer.getFromBuffer();
+
+            const float temp = input + delayLine * 0.5f;
+            buffer.pushToBuffer(&temp);
+
+            return delayLine - input;
+        }
+
+     private:
+        RingBuffer<float> buffer;
+        float previousValue = 0.0f;
+    };
+
+    uint sampleRate = 44100;
+    float preGain = 0.0f, wet = 0.0f, dry = 0.0f;
+    juce::SmoothedValue<float> dampingSmooth, feedbackSmooth, wet1, wet2, drySmooth;
+    Parameters parameters;
+
+    array<array<Comb, 8>, 2> earlyCombs;
+    array<array<Comb, 4>, 2> lateCombs;
+    array<float, 8> earlyCombTimes { 0.06f, 0.04f, 0.02f, 0.01f, 0.052f, 0.036f, 0.042f, 0.024f };
+    array<float, 4> lateCombTimes { 0.011f, 0.054f, 0.033f, 0.023f };
+
+    void setCombs() {
+        const auto spreadAmount = math::clamp(parameters.spread, 0.0f, 0.01f) / 2;
+
+        for (uint ch = 0; ch < 2; ch++) {
+            const float spread = (ch == 0) ? spreadAmount : -spreadAmount;
+
+            for (uint i = 0; i < 8; i++) earlyCombs[ch][i].setTime(earlyCombTimes[i] + spread);
+            for (uint i = 0; i < 4; i++) lateCombs[ch][i].setTime(lateCombTimes[i] + spread);
+        }
+    }
+};
+
+} // end namespace pa::reference